@@ -1,6 +1,8 @@
 #version 450 core
 
-layout(std140) uniform cb_matrix
+// binding points: eConstantBlockBinding in demo/opengl/constant_blocks.h
+
+layout(std140, binding = 8) uniform cb_matrix
 {
     mat4 m_W;
     mat4 m_V;
@@ -13,31 +15,31 @@ layout(std140) uniform cb_matrix
     
     mat4 m_iP;
     mat4 m_iVP;    
-}
+};
 
-layout(std140) uniform cb_sunlight
+layout(std140, binding = 9) uniform cb_sunlight
 {
     vec4 sun_position;
     vec4 sun_direction;
     vec4 sun_color;
     float sun_intensity;
-}
+};
 
-layout(std140) uniform cb_camera
+layout(std140, binding = 10) uniform cb_camera
 {
     vec4 cam_position;
     vec4 cam_target;
     vec4 cam_direction;
     vec4 cam_up;
     vec4 cam_near_far_fov;
-}
+};
 
-layout(std140) uniform cb_lowFreq
+layout(std140, binding = 11) uniform cb_lowFreq
 {
     vec4 g_lowFreq[32];
-}
+};
 
-layout(std140) uniform cb_highFreq
+layout(std140, binding = 12) uniform cb_highFreq
 {
     vec4 g_highFreq[32];
-}
+};
@@ -0,0 +1,8 @@
+// per draw data of IndirectDrawList, needs #version 430
+// va_drawId: the draw's index, fed through baseInstance (ARENA_DRAW_ID_LOC)
+layout(location = 4) in uint va_drawId;
+
+layout(std430, binding = 0) readonly buffer cb_drawData
+{
+    mat4 g_drawWorld[];
+};
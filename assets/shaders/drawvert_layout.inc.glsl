@@ -2,3 +2,17 @@ layout(location = 0) in vec4 va_position;
 layout(location = 1) in vec4 va_qtangent;
 layout(location = 2) in vec2 va_st;
 layout(location = 3) in vec4 va_color;
+
+// va_qtangent: tangent frame quaternion, sign(w) carries the bitangent sign
+vec3 qtangent_rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void qtangent_decode(vec4 q, out vec3 normal, out vec3 tangent, out vec3 bitangent)
+{
+	vec4 qn = normalize(q);
+	normal = qtangent_rotate(qn, vec3(0.0, 0.0, 1.0));
+	tangent = qtangent_rotate(qn, vec3(1.0, 0.0, 0.0));
+	bitangent = cross(normal, tangent) * (q.w < 0.0 ? -1.0 : 1.0);
+}
@@ -8,5 +8,5 @@ void main()
 {   
     vec4 c = texture(samp0, vso_TexCoords);
     float dp = fract( dot( gl_FragCoord.xy, vec2(0.5, 0.5) ) );
-    FS_OUT = mix(c, vec4(0.05, 0.01, 0.01, 1.0), dp < 0.5);
+    FS_OUT = mix(c, vec4(0.05, 0.01, 0.01, 1.0), float(dp < 0.5));
 }
\ No newline at end of file
@@ -26,7 +26,7 @@ void main()
 	float H = 20.0 + 18.0 * cos(float(pc.x + angle)/256.0);
 
 	vec4 pixel = vec4( mix( black, white,
-		abs(y - pc.y) < H || abs(x - pc.x) < H), 1.0 );
+		float(abs(y - pc.y) < H || abs(x - pc.x) < H)), 1.0 );
 
 	imageStore(img_output, pc, pixel);
 }
\ No newline at end of file
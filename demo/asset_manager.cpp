@@ -0,0 +1,656 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <SOIL2.h>
+#include "logger.h"
+#include "filesystem.h"
+#include "gpu_utils.h"
+#include "texture_file.h"
+#include "asset_manager.h"
+
+AssetManager g_assetManager;
+
+static const GLenum s_copiedParams[] = {
+	GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER,
+	GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R
+};
+
+// mesh_cook output next to the source: model.mesh for mesh 0 primitive 0, model.<mesh>.<primitive>.mesh otherwise
+static std::string cookedMeshName(const std::string& fromFile, int meshIdx, int primitiveIdx)
+{
+	std::filesystem::path p(fromFile);
+
+	if (meshIdx == 0 && primitiveIdx == 0)
+	{
+		return p.replace_extension(".mesh").string();
+	}
+
+	return p.replace_extension("." + std::to_string(meshIdx) + "." + std::to_string(primitiveIdx) + ".mesh").string();
+}
+
+// texture_cook output next to the source: image.dds, or <dir>.dds for the faces of a cube map in dir
+static std::string cookedTextureName(const std::vector<std::string>& files)
+{
+	std::filesystem::path p(files[0]);
+
+	if (files.size() == 1)
+	{
+		return p.replace_extension(".dds").string();
+	}
+
+	return p.parent_path().string() + ".dds";
+}
+
+// a cooked file older than any of its sources is stale, the sources are used instead
+static bool isCookedFileValid(const std::string& cooked, const std::vector<std::string>& sources)
+{
+	std::error_code ec;
+
+	if (!std::filesystem::exists(cooked, ec))
+	{
+		return false;
+	}
+
+	const auto cookedTime = std::filesystem::last_write_time(cooked, ec);
+	if (ec)
+	{
+		return false;
+	}
+
+	for (const std::string& source : sources)
+	{
+		const auto sourceTime = std::filesystem::last_write_time(source, ec);
+		if (!ec && sourceTime > cookedTime)
+		{
+			Warning("AssetManager: %s is older than %s, using the source", cooked.c_str(), source.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+AssetManager::AssetManager() :
+	m_Budget(),
+	m_UploadedLastFrame(),
+	m_bInitialized(false),
+	m_Pending(0)
+{
+}
+
+AssetManager::~AssetManager()
+{
+	shutdown();
+}
+
+bool AssetManager::init(uint32_t uploadBudget, int numFrames)
+{
+	if (m_bInitialized)
+	{
+		return false;
+	}
+
+	m_Staging.reset(new GpuRingBuffer(eGpuBufferTarget::PIXEL_UNPACK));
+	if (!m_Staging->create(uploadBudget, numFrames))
+	{
+		m_Staging.reset();
+		return false;
+	}
+
+	m_Budget = uploadBudget;
+	m_bInitialized = true;
+
+	return true;
+}
+
+void AssetManager::shutdown()
+{
+	if (!m_bInitialized)
+	{
+		return;
+	}
+
+	// decode jobs hold pointers into the requests
+	g_jobSystem.wait(m_Jobs);
+
+	for (TextureRequestPtr& req : m_ReadyTextures)
+	{
+		releaseImages(*req);
+	}
+	for (TextureRequestPtr& req : m_Uploads)
+	{
+		releaseImages(*req);
+		if (req->texture) GL_CHECK(glDeleteTextures(1, &req->texture));
+	}
+
+	m_ReadyTextures.clear();
+	m_ReadyMeshes.clear();
+	m_Uploads.clear();
+	m_Pending = 0;
+
+	for (auto& it : m_Watches)
+	{
+		g_fileSystem.unwatch(it.second);
+	}
+	m_Watches.clear();
+
+	m_Staging.reset();
+	m_bInitialized = false;
+}
+
+bool AssetManager::loadTexture(GpuTexture2D::Ptr tex, const std::string& fromFile, bool srgb, bool autoMipmap)
+{
+	if (!queueTexture(tex, { fromFile }, srgb, autoMipmap))
+	{
+		return false;
+	}
+
+	watchTexture(tex, { fromFile }, srgb, autoMipmap);
+
+	return true;
+}
+
+bool AssetManager::loadCubeMap(GpuTextureCubeMap::Ptr tex, const std::vector<std::string>& fromFile, bool srgb, bool autoMipmap)
+{
+	if (fromFile.size() != 6)
+	{
+		Error("AssetManager: cube map needs 6 faces, got %d", int(fromFile.size()));
+		return false;
+	}
+
+	if (!queueTexture(tex, fromFile, srgb, autoMipmap))
+	{
+		return false;
+	}
+
+	watchTexture(tex, fromFile, srgb, autoMipmap);
+
+	return true;
+}
+
+// an edited file is simply queued again, the current image stays until the new one is uploaded
+void AssetManager::watchTexture(std::shared_ptr<GpuTexture> tex, const std::vector<std::string>& files, bool srgb, bool autoMipmap)
+{
+	const GpuTexture* key = tex.get();
+	std::weak_ptr<GpuTexture> weak = tex;
+
+	auto it = m_Watches.find(key);
+	if (it != m_Watches.end())
+	{
+		g_fileSystem.unwatch(it->second);
+	}
+
+	m_Watches[key] = g_fileSystem.watch_files(files, [this, key, weak, files, srgb, autoMipmap]()
+	{
+		std::shared_ptr<GpuTexture> tex = weak.lock();
+		if (!tex)
+		{
+			g_fileSystem.unwatch(m_Watches[key]);
+			m_Watches.erase(key);
+			return;
+		}
+
+		Info("AssetManager: reloading %s", files[0].c_str());
+		queueTexture(tex, files, srgb, autoMipmap);
+	});
+}
+
+bool AssetManager::loadMesh(Mesh3D::Ptr mesh, const std::string& fromFile, int meshIdx, int primitiveIdx, unsigned int importFlags, std::function<void(Mesh3D&)> onReady)
+{
+	if (!m_bInitialized || !mesh)
+	{
+		return false;
+	}
+
+	MeshRequestPtr req = std::make_shared<meshRequest_t>();
+	req->mesh = mesh;
+	req->onReady = std::move(onReady);
+
+	++m_Pending;
+
+	g_jobSystem.run([this, req, fromFile, meshIdx, primitiveIdx, importFlags]
+	{
+		const std::string cooked = cookedMeshName(fromFile, meshIdx, primitiveIdx);
+
+		req->ok = isCookedFileValid(cooked, { fromFile }) && req->mesh->loadFromCooked(cooked.c_str());
+		if (!req->ok)
+		{
+			req->ok = req->mesh->loadFromGLTF(fromFile.c_str(), meshIdx, primitiveIdx, importFlags);
+		}
+
+		std::lock_guard<std::mutex> lk(m_Lock);
+		m_ReadyMeshes.push_back(req);
+	}, &m_Jobs);
+
+	return true;
+}
+
+bool AssetManager::queueTexture(std::shared_ptr<GpuTexture> tex, const std::vector<std::string>& files, bool srgb, bool autoMipmap)
+{
+	if (!m_bInitialized || !tex)
+	{
+		return false;
+	}
+
+	if (tex->mTexture == INVALID_TEXTURE)
+	{
+		createPlaceholder(*tex, srgb, autoMipmap);
+	}
+
+	TextureRequestPtr req = std::make_shared<textureRequest_t>();
+	req->target = tex;
+	req->files = files;
+	req->srgb = srgb;
+	req->autoMipmap = autoMipmap;
+
+	++m_Pending;
+
+	g_jobSystem.run([this, req]
+	{
+		if (!loadCooked(*req))
+		{
+			decodeImages(req);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lk(m_Lock);
+		m_ReadyTextures.push_back(req);
+	}, &m_Jobs);
+
+	return true;
+}
+
+bool AssetManager::loadCooked(textureRequest_t& req)
+{
+	const std::string cooked = cookedTextureName(req.files);
+
+	if (!isCookedFileValid(cooked, req.files))
+	{
+		return false;
+	}
+
+	MappedFile::Ptr file = g_fileSystem.map_binary_file(cooked);
+	if (!file || !DDS_Parse(file->data(), file->size(), cooked, req.layout))
+	{
+		return false;
+	}
+
+	if (req.layout.numFaces != req.files.size() || (req.layout.numFaces == 6 && req.layout.width != req.layout.height))
+	{
+		Warning("AssetManager: %s is not a %s, using the source", cooked.c_str(), req.files.size() == 6 ? "cube map" : "2D texture");
+		return false;
+	}
+
+	req.cooked = file;
+
+	return true;
+}
+
+void AssetManager::decodeImages(const TextureRequestPtr& req)
+{
+	const std::vector<std::string>& files = req->files;
+
+	req->images.resize(files.size());
+	req->decoding = int(files.size());
+
+	// every face decodes on its own worker
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		g_jobSystem.run([this, req, i]
+		{
+			image_t& img = req->images[i];
+			int channels;
+
+			img.pixels = SOIL_load_image(req->files[i].c_str(), &img.width, &img.height, &channels, SOIL_LOAD_RGBA);
+			if (!img.pixels)
+			{
+				Error("AssetManager: cannot load %s", req->files[i].c_str());
+				req->failed = true;
+			}
+
+			if (req->decoding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				std::lock_guard<std::mutex> lk(m_Lock);
+				m_ReadyTextures.push_back(req);
+			}
+		}, &m_Jobs);
+	}
+}
+
+void AssetManager::createPlaceholder(GpuTexture& tex, bool srgb, bool autoMipmap)
+{
+	const GLenum target = tex.getApiTarget();
+	const uint8_t texel[4] = { 128, 128, 128, 255 };
+
+	GLuint id;
+	GL_CHECK(glCreateTextures(target, 1, &id));
+	GL_CHECK(glTextureStorage2D(id, 1, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, 1, 1));
+
+	if (target == GL_TEXTURE_CUBE_MAP)
+	{
+		for (int face = 0; face < 6; ++face)
+		{
+			GL_CHECK(glTextureSubImage3D(id, 0, 0, 0, face, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel));
+		}
+		GL_CHECK(glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+		GL_CHECK(glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+		GL_CHECK(glTextureParameteri(id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+	}
+	else
+	{
+		GL_CHECK(glTextureSubImage2D(id, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel));
+	}
+
+	GL_CHECK(glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, autoMipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+	GL_CHECK(glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+
+	tex.mTexture = id;
+	tex.m_width = 1;
+	tex.m_height = 1;
+	tex.m_depth = 1;
+}
+
+bool AssetManager::beginUpload(textureRequest_t& req)
+{
+	if (req.cooked)
+	{
+		const cookedTexture_t& layout = req.layout;
+
+		if (DDS_LevelSize(layout.width, 4, layout.blockBytes) > m_Budget)
+		{
+			Error("AssetManager: %s, a block row does not fit the %u byte upload budget", req.files[0].c_str(), m_Budget);
+			return false;
+		}
+
+		GL_CHECK(glCreateTextures(req.target->getApiTarget(), 1, &req.texture));
+		GL_CHECK(glTextureStorage2D(req.texture, GLsizei(layout.numLevels), layout.format, GLsizei(layout.width), GLsizei(layout.height)));
+
+		req.face = 0;
+		req.level = 0;
+		req.row = 0;
+		req.offset = layout.dataOffset;
+
+		return true;
+	}
+
+	const int w = req.images[0].width;
+	const int h = req.images[0].height;
+
+	for (const image_t& img : req.images)
+	{
+		if (img.width != w || img.height != h)
+		{
+			Error("AssetManager: %s, faces differ in size", req.files[0].c_str());
+			return false;
+		}
+	}
+
+	if (uint32_t(w) * 4 > m_Budget)
+	{
+		Error("AssetManager: %s, a row does not fit the %u byte upload budget", req.files[0].c_str(), m_Budget);
+		return false;
+	}
+
+	const GLsizei levels = req.autoMipmap ? 1 + GLsizei(std::floor(std::log2(float(std::max(w, h))))) : 1;
+
+	GL_CHECK(glCreateTextures(req.target->getApiTarget(), 1, &req.texture));
+	GL_CHECK(glTextureStorage2D(req.texture, levels, req.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, w, h));
+
+	req.face = 0;
+	req.row = 0;
+
+	return true;
+}
+
+uint32_t AssetManager::getStagingSpace() const
+{
+	// rounded the way alloc() advances the ring, a band sized from this always fits
+	const uint32_t align = m_Staging->getAlignment();
+	const uint32_t used = (m_Staging->getFrameUsed() + align - 1) / align * align;
+
+	return m_Budget - std::min(m_Budget, used);
+}
+
+bool AssetManager::uploadBands(textureRequest_t& req)
+{
+	if (req.cooked)
+	{
+		return uploadCookedBands(req);
+	}
+
+	const bool cube = req.target->getApiTarget() == GL_TEXTURE_CUBE_MAP;
+
+	while (req.face < int(req.images.size()))
+	{
+		image_t& img = req.images[req.face];
+		const uint32_t rowBytes = uint32_t(img.width) * 4;
+		const uint32_t space = getStagingSpace();
+		const int rows = std::min(int(space / rowBytes), img.height - req.row);
+
+		if (rows <= 0)
+		{
+			return false;
+		}
+
+		uint32_t offset;
+		uint8_t* dst = m_Staging->alloc(uint32_t(rows) * rowBytes, offset);
+		if (!dst)
+		{
+			return false;
+		}
+
+		std::memcpy(dst, img.pixels + size_t(req.row) * rowBytes, size_t(rows) * rowBytes);
+
+		const void* src = reinterpret_cast<const void*>(uintptr_t(offset));
+		if (cube)
+		{
+			GL_CHECK(glTextureSubImage3D(req.texture, 0, 0, req.row, req.face, img.width, rows, 1, GL_RGBA, GL_UNSIGNED_BYTE, src));
+		}
+		else
+		{
+			GL_CHECK(glTextureSubImage2D(req.texture, 0, 0, req.row, img.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, src));
+		}
+
+		req.row += rows;
+		if (req.row == img.height)
+		{
+			SOIL_free_image_data(img.pixels);
+			img.pixels = nullptr;
+			++req.face;
+			req.row = 0;
+		}
+	}
+
+	return true;
+}
+
+// the file order: every level of face 0, then face 1 ..., each level in rows of 4x4 blocks
+bool AssetManager::uploadCookedBands(textureRequest_t& req)
+{
+	const cookedTexture_t& layout = req.layout;
+	const bool cube = layout.numFaces == 6;
+
+	while (req.face < int(layout.numFaces))
+	{
+		const uint32_t w = std::max(layout.width >> req.level, 1u);
+		const uint32_t h = std::max(layout.height >> req.level, 1u);
+		const uint32_t rowBytes = DDS_LevelSize(w, 4, layout.blockBytes);
+		const int blockRows = int((h + 3) / 4);
+		const uint32_t space = getStagingSpace();
+		const int rows = std::min(int(space / rowBytes), blockRows - req.row);
+
+		if (rows <= 0)
+		{
+			return false;
+		}
+
+		const uint32_t size = uint32_t(rows) * rowBytes;
+		uint32_t offset;
+		uint8_t* dst = m_Staging->alloc(size, offset);
+		if (!dst)
+		{
+			return false;
+		}
+
+		std::memcpy(dst, req.cooked->data() + req.offset, size);
+
+		// only the last band of a level may end inside a block row
+		const int y = req.row * 4;
+		const int height = std::min(rows * 4, int(h) - y);
+		const void* src = reinterpret_cast<const void*>(uintptr_t(offset));
+		if (cube)
+		{
+			GL_CHECK(glCompressedTextureSubImage3D(req.texture, req.level, 0, y, req.face, GLsizei(w), height, 1, layout.format, GLsizei(size), src));
+		}
+		else
+		{
+			GL_CHECK(glCompressedTextureSubImage2D(req.texture, req.level, 0, y, GLsizei(w), height, layout.format, GLsizei(size), src));
+		}
+
+		req.offset += size;
+		req.row += rows;
+		if (req.row == blockRows)
+		{
+			req.row = 0;
+			if (++req.level == int(layout.numLevels))
+			{
+				req.level = 0;
+				++req.face;
+			}
+		}
+	}
+
+	return true;
+}
+
+void AssetManager::finishUpload(textureRequest_t& req)
+{
+	GpuTexture& tex = *req.target;
+
+	if (req.autoMipmap && !req.cooked)
+	{
+		GL_CHECK(glGenerateTextureMipmap(req.texture));
+	}
+
+	// sampling state set on the placeholder survives the swap
+	if (tex.mTexture != INVALID_TEXTURE)
+	{
+		for (GLenum pname : s_copiedParams)
+		{
+			GLint value;
+			GL_CHECK(glGetTextureParameteriv(tex.mTexture, pname, &value));
+			GL_CHECK(glTextureParameteri(req.texture, pname, value));
+		}
+		GL_CHECK(glDeleteTextures(1, &tex.mTexture));
+	}
+
+	tex.mTexture = req.texture;
+	tex.m_width = req.cooked ? req.layout.width : unsigned(req.images[0].width);
+	tex.m_height = req.cooked ? req.layout.height : unsigned(req.images[0].height);
+	tex.m_depth = 1;
+
+	req.texture = 0;
+	req.cooked.reset();
+}
+
+void AssetManager::releaseImages(textureRequest_t& req)
+{
+	for (image_t& img : req.images)
+	{
+		if (img.pixels)
+		{
+			SOIL_free_image_data(img.pixels);
+			img.pixels = nullptr;
+		}
+	}
+
+	req.cooked.reset();
+}
+
+void AssetManager::flush()
+{
+	if (!m_bInitialized)
+	{
+		return;
+	}
+
+	g_jobSystem.wait(m_Jobs);
+
+	while (m_Pending.load(std::memory_order_acquire) > 0)
+	{
+		update();
+		// update() reuses the staging region of the current frame
+		GL_CHECK(glFinish());
+	}
+}
+
+void AssetManager::update()
+{
+	if (!m_bInitialized)
+	{
+		return;
+	}
+
+	MeshRequestPtr mesh;
+	{
+		std::lock_guard<std::mutex> lk(m_Lock);
+		for (TextureRequestPtr& req : m_ReadyTextures)
+		{
+			m_Uploads.push_back(std::move(req));
+		}
+		m_ReadyTextures.clear();
+
+		if (!m_ReadyMeshes.empty())
+		{
+			mesh = std::move(m_ReadyMeshes.front());
+			m_ReadyMeshes.pop_front();
+		}
+	}
+
+	// one mesh per frame, onReady creates its buffers
+	if (mesh)
+	{
+		if (mesh->ok && mesh->onReady)
+		{
+			mesh->onReady(*mesh->mesh);
+		}
+		--m_Pending;
+	}
+
+	if (m_Uploads.empty())
+	{
+		m_UploadedLastFrame = 0;
+		return;
+	}
+
+	m_Staging->beginFrame();
+	m_Staging->getBuffer().bind();
+
+	while (!m_Uploads.empty())
+	{
+		textureRequest_t& req = *m_Uploads.front();
+
+		// a failed request keeps its placeholder
+		if (req.failed || (!req.texture && !beginUpload(req)))
+		{
+			releaseImages(req);
+			m_Uploads.pop_front();
+			--m_Pending;
+			continue;
+		}
+
+		if (!uploadBands(req))
+		{
+			break;
+		}
+
+		finishUpload(req);
+		m_Uploads.pop_front();
+		--m_Pending;
+	}
+
+	m_Staging->getBuffer().unBind();
+	m_UploadedLastFrame = m_Staging->getFrameUsed();
+	m_Staging->endFrame();
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cinttypes>
+
+#include "job_system.h"
+#include "filesystem.h"
+#include "gpu_ring_buffer.h"
+#include "gpu_texture.h"
+#include "mesh.h"
+
+/*
+Streams textures and meshes in the background.
+
+File I/O and decoding run on g_jobSystem into CPU staging memory, the GL
+side happens in update() on the main thread: decoded images are copied
+into a fenced PBO ring and uploaded in row bands, never more than the
+per-frame budget. A texture keeps its placeholder (a 1x1 texel, or the
+image it already had) until every band and face landed, then the new GL
+name is swapped in, filter and wrap parameters carried over. The
+GpuTexture object itself stays the same, handles never dangle.
+
+Meshes are imported on a worker, onReady runs on the main thread once
+per frame at most so GPU buffers can be created there. A mesh_cook file
+next to the source (model.mesh, or model.<mesh>.<primitive>.mesh) is
+mapped instead of parsing the glTF unless it is older than the source;
+importFlags only apply to the glTF path.
+
+Textures work the same way with texture_cook output: image.dds next to
+a 2D source, <dir>.dds next to the directory holding the six faces of a
+cube map (the faces in skybox/ -> skybox.dds). The file is mapped on a worker
+and its blocks go up in bands like decoded rows, with the mips and the
+sRGB choice of the file: srgb and autoMipmap only apply to the sources.
+
+Texture files are watched through FileSystem: an edited file is decoded
+and uploaded again the same way, a file that fails to load leaves the
+current image in place.
+*/
+class AssetManager
+{
+public:
+	AssetManager();
+	AssetManager(const AssetManager&) = delete;
+	AssetManager& operator=(const AssetManager&) = delete;
+	~AssetManager();
+
+	// needs a current GL context, uploadBudget is in bytes per frame,
+	// numFrames 0 gives the staging ring one region per g_frameScheduler slot
+	bool init(uint32_t uploadBudget = 4 * 1024 * 1024, int numFrames = 0);
+	void shutdown();
+
+	bool loadTexture(GpuTexture2D::Ptr tex, const std::string& fromFile, bool srgb = false, bool autoMipmap = true);
+	// faces in +X, -X, +Y, -Y, +Z, -Z order
+	bool loadCubeMap(GpuTextureCubeMap::Ptr tex, const std::vector<std::string>& fromFile, bool srgb = false, bool autoMipmap = false);
+	bool loadMesh(Mesh3D::Ptr mesh, const std::string& fromFile, int meshIdx, int primitiveIdx, unsigned int importFlags, std::function<void(Mesh3D&)> onReady);
+
+	/*
+	Main thread, once per frame before rendering: uploads what fits in the
+	budget and publishes finished assets. Swapped textures delete their
+	placeholder name, call it before Pipeline::beginFrame() so the bind
+	cache does not see a recycled name.
+	*/
+	void update();
+
+	// blocks until every queued request is decoded and uploaded, runs the
+	// decode jobs on the calling thread; for loading screens and benchmarks
+	void flush();
+
+	// requests not yet visible to the renderer
+	int getPending() const { return m_Pending.load(std::memory_order_acquire); }
+	uint32_t getUploadedLastFrame() const { return m_UploadedLastFrame; }
+private:
+	struct image_t
+	{
+		unsigned char* pixels = nullptr;
+		int width = 0;
+		int height = 0;
+	};
+
+	struct textureRequest_t
+	{
+		std::shared_ptr<GpuTexture> target;
+		std::vector<std::string> files;
+		std::vector<image_t> images;		// one per file, filled by the decode jobs
+		std::atomic<int> decoding{ 0 };
+		std::atomic<bool> failed{ false };
+		bool srgb = false;
+		bool autoMipmap = false;
+
+		// texture_cook output used instead of the images
+		MappedFile::Ptr cooked;
+		cookedTexture_t layout{};
+
+		// upload progress, main thread only
+		GLuint texture = 0;
+		int face = 0;
+		int level = 0;
+		int row = 0;				// block rows for cooked files
+		size_t offset = 0;			// into cooked
+	};
+
+	struct meshRequest_t
+	{
+		Mesh3D::Ptr mesh;
+		std::function<void(Mesh3D&)> onReady;
+		bool ok = false;
+	};
+
+	using TextureRequestPtr = std::shared_ptr<textureRequest_t>;
+	using MeshRequestPtr = std::shared_ptr<meshRequest_t>;
+
+	bool queueTexture(std::shared_ptr<GpuTexture> tex, const std::vector<std::string>& files, bool srgb, bool autoMipmap);
+	void watchTexture(std::shared_ptr<GpuTexture> tex, const std::vector<std::string>& files, bool srgb, bool autoMipmap);
+	// worker side: maps a cooked file when there is a current one, or decodes the sources
+	bool loadCooked(textureRequest_t& req);
+	void decodeImages(const TextureRequestPtr& req);
+	void createPlaceholder(GpuTexture& tex, bool srgb, bool autoMipmap);
+	bool beginUpload(textureRequest_t& req);
+	// staging bytes left in the frame's budget
+	uint32_t getStagingSpace() const;
+	// false while bands are left over for the next frame
+	bool uploadBands(textureRequest_t& req);
+	bool uploadCookedBands(textureRequest_t& req);
+	void finishUpload(textureRequest_t& req);
+	void releaseImages(textureRequest_t& req);
+
+	std::unique_ptr<GpuRingBuffer> m_Staging;	// PBO ring, m_Budget bytes per frame
+	uint32_t m_Budget;
+	uint32_t m_UploadedLastFrame;
+	bool m_bInitialized;
+
+	JobCounter m_Jobs;
+	std::atomic<int> m_Pending;
+
+	// filled by workers, drained by update()
+	std::mutex m_Lock;
+	std::deque<TextureRequestPtr> m_ReadyTextures;
+	std::deque<MeshRequestPtr> m_ReadyMeshes;
+
+	// decoded textures waiting for upload bandwidth, front one in progress
+	std::deque<TextureRequestPtr> m_Uploads;
+
+	// FileSystem watch ids of the loaded textures
+	std::unordered_map<const GpuTexture*, int> m_Watches;
+};
+
+extern AssetManager g_assetManager;
@@ -6,24 +6,29 @@
 #include "demo.h"
 #include "logger.h"
 #include "filesystem.h"
-#include "effect_pointcube.h"
-#include "effect_compute_test.h"
+#include "job_system.h"
+#include "asset_manager.h"
+#include "effect_registry.h"
+#include "demo_config.h"
 #include "gpu_types.h"
 #include "gpu_utils.h"
+#include "gpu_program.h"
+#include "program_cache.h"
+#include "gpu_profiler.h"
+#include "frame_scheduler.h"
+#include "fixed_timestep.h"
+#include "profiler.h"
 #include "mesh.h"
+#include "pipeline.h"
 
-#define SCREEN_WIDTH 1440
-#define SCREEN_HEIGHT 900
-#define FULLSCREEN false
+#define SIM_MAX_STEPS 5
 
 VideoConfig videoConf;
 
-bool V_Init(int w, int h, int multisample, bool fullscreen);
+bool V_Init(int w, int h, int multisample, bool fullscreen, int swapInterval);
 void V_Shutdown();
 
-const char* BASE_DIR = "d:/src/3d-demo-git/";
-
-static bool V_Init(int w, int h, int multisample, bool fullscreen)
+static bool V_Init(int w, int h, int multisample, bool fullscreen, int swapInterval)
 {
     int err;
 
@@ -97,7 +102,12 @@ static bool V_Init(int w, int h, int multisample, bool fullscreen)
 
     Info("glewInit done");
 
-    SDL_GL_SetSwapInterval(1);
+    // adaptive vsync (-1) is an extension, plain vsync is the fallback
+    if (SDL_GL_SetSwapInterval(swapInterval) < 0 && swapInterval == -1)
+    {
+        Warning("Adaptive vsync is not supported, using vsync");
+        SDL_GL_SetSwapInterval(1);
+    }
 
     std::string renderer = (char *)glGetString(GL_RENDERER);
     std::string version  = (char *)glGetString(GL_VERSION);
@@ -126,6 +136,8 @@ static bool V_Init(int w, int h, int multisample, bool fullscreen)
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
+    GpuProgramBatch::init();
+
 #ifdef _DEBUG
     if (GLEW_ARB_debug_output)
     {
@@ -167,79 +179,113 @@ static void V_Shutdown()
     }
 }
 
-void App_EventLoop()
+void App_EventLoop(const demoConfig_t& cfg)
 {
     SDL_Event e;
     bool running = true;
-    float prev = float(SDL_GetTicks());
+    FixedTimestep sim(1000.0 / cfg.simRate, SIM_MAX_STEPS);
+    Pipeline pipeline;
 
-    std::unique_ptr<Effect> activeEffect = std::make_unique<ComputeTestEffect>();
+    std::unique_ptr<Effect> activeEffect = Effect_Create(cfg.effect);
 
-    if (!activeEffect->Init())
+    if (!activeEffect || !activeEffect->Init())
         return;
 
-    int sampleCount = 0;
-    Uint32 ticks = 0;
-    GLsync sync{};
+    // loading time is not simulation time
+    sim.reset();
 
     while (running)
     {
-        float now = SDL_GetTicks();
-        float time = now - prev;
-        prev = now;
+        g_profiler.beginFrame();
+        // waits for the frame that last used this slot, not the previous one
+        g_frameScheduler.beginFrame();
+        g_gpuProfiler.beginFrame();
 
-        running = activeEffect->Update(time);
-
-        while (SDL_PollEvent(&e) != SDL_FALSE && running)
         {
-            running = activeEffect->HandleEvent(&e);
+            PROFILE_SCOPE("Events");
 
-            if (e.type == SDL_QUIT)
-            {
-                running = false;
-            }
-            else if(e.type == SDL_KEYDOWN)
+            while (SDL_PollEvent(&e) != SDL_FALSE && running)
             {
-                if (e.key.keysym.sym == SDLK_ESCAPE)
+                running = activeEffect->HandleEvent(&e);
+
+                if (e.type == SDL_QUIT)
                 {
                     running = false;
                 }
+                else if(e.type == SDL_KEYDOWN)
+                {
+                    if (e.key.keysym.sym == SDLK_ESCAPE)
+                    {
+                        running = false;
+                    }
+                    else if (e.key.keysym.sym == SDLK_F12 && !g_profiler.isCapturing())
+                    {
+                        g_profiler.startCapture(g_fileSystem.resolve("profile.json"), 60);
+                    }
+                }
             }
         }
 
+        {
+            PROFILE_SCOPE("Update");
 
-        Uint32 tick1 = SDL_GetTicks();
+            const int steps = sim.advance();
+            for (int i = 0; i < steps && running; ++i)
+            {
+                running = activeEffect->Update(sim.getStepMs());
+            }
+        }
 
         GL_FLUSH_ERRORS
 
-        if (sync) GL_CHECK(glDeleteSync(sync));
-
-        activeEffect->Render();
+        {
+            PROFILE_SCOPE("Render");
+            GPU_PROFILE_SCOPE("Frame");
 
-        GL_CHECK(sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+            g_fileSystem.poll_watches();
+            g_assetManager.update();
 
-        //glFinish();
+            // after the reloads and uploads above, they bind behind the shadow state
+            pipeline.beginFrame();
+            activeEffect->Render(pipeline, sim.getAlpha());
+        }
 
-        GL_CHECK(glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, ~GLuint64(0)));
+        g_frameScheduler.endFrame();
 
-        Uint32 tick2 = SDL_GetTicks();
-        ticks += tick2 - tick1;
-        if (++sampleCount > 200)
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+        if (g_profiler.getFrameIndex() % 200 == 0)
         {
-            //SDL_Log("ftime: %f", (ticks / 200.0f));
-            sampleCount = 0;
-            ticks = 0;
+            Debug("frame %.2f ms, cpu %.2f ms, gpu %.2f ms, latency %.2f ms, wait %.2f ms, dropped sim steps %d",
+                g_profiler.getAverageFrameMs(), g_frameScheduler.getCpuMs(), g_frameScheduler.getGpuMs(),
+                g_frameScheduler.getLatencyMs(), g_frameScheduler.getWaitMs(), int(sim.getDroppedSteps()));
+
+            const glCallStats_t& calls = pipeline.getCallStats();
+            Debug("gl binds issued/skipped: program %u/%u, texture %u/%u, vao %u/%u, framebuffer %u/%u, buffer %u/%u, state %u/%u",
+                calls.programIssued, calls.programSkipped, calls.textureIssued, calls.textureSkipped,
+                calls.vaoIssued, calls.vaoSkipped, calls.frameBufferIssued, calls.frameBufferSkipped,
+                calls.bufferIssued, calls.bufferSkipped, calls.stateIssued, calls.stateSkipped);
         }
+#endif
 
-
-        SDL_GL_SwapWindow(videoConf.hWindow);
-
+        {
+            PROFILE_SCOPE("Swap");
+            SDL_GL_SwapWindow(videoConf.hWindow);
+        }
     }
 }
 
 int main(int argc, char** argv)
 {
-    g_fileSystem.set_working_dir(BASE_DIR);
+    demoConfig_t cfg;
+
+    if (!Config_Init(argc, argv, cfg))
+    {
+        return 1;
+    }
+
+    g_fileSystem.set_working_dir(cfg.root);
+    g_profiler.setThreadName("Main");
+    g_jobSystem.init();
 
 //    Mesh3D mesh;
 //    mesh.loadFromGLTF(g_fileSystem.resolve("assets/cube.gltf").c_str(), 0, 0);
@@ -247,14 +293,23 @@ int main(int argc, char** argv)
 
     Info("V_Init Start");
 
-    if (V_Init(SCREEN_WIDTH, SCREEN_HEIGHT, 0, FULLSCREEN))
+    if (V_Init(cfg.width, cfg.height, cfg.msaa, cfg.fullscreen, cfg.swapInterval))
     {
         Info("V_Init Done");
-        App_EventLoop();
+        g_frameScheduler.init(cfg.framesInFlight);
+        g_assetManager.init();
+        g_programCache.init(g_fileSystem.resolve("cache/programs"));
+        g_gpuProfiler.init();
+        App_EventLoop(cfg);
     }
 
     Info("V_Shutdown...");
+    // nothing may be deleted while the GPU still uses it
+    g_frameScheduler.shutdown();
+    g_gpuProfiler.shutdown();
+    g_assetManager.shutdown();
     V_Shutdown();
+    g_jobSystem.shutdown();
 
 	Info("Program terminated");
 	return 0;
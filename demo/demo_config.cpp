@@ -0,0 +1,238 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include "logger.h"
+#include "effect_registry.h"
+#include "demo_config.h"
+
+static bool Config_ParseInt(const std::string& value, int minValue, int maxValue, int& result)
+{
+	char* end = nullptr;
+	const long v = strtol(value.c_str(), &end, 10);
+
+	if (value.empty() || *end != '\0' || v < minValue || v > maxValue)
+	{
+		return false;
+	}
+
+	result = int(v);
+	return true;
+}
+
+static bool Config_ParseBool(const std::string& value, bool& result)
+{
+	if (value == "1" || value == "true" || value == "yes" || value == "on")
+	{
+		result = true;
+		return true;
+	}
+	if (value == "0" || value == "false" || value == "no" || value == "off")
+	{
+		result = false;
+		return true;
+	}
+
+	return false;
+}
+
+static std::string Config_Trim(const std::string& s)
+{
+	const size_t begin = s.find_first_not_of(" \t\r\n");
+	if (begin == std::string::npos)
+	{
+		return std::string();
+	}
+
+	const size_t end = s.find_last_not_of(" \t\r\n");
+	return s.substr(begin, end - begin + 1);
+}
+
+bool Config_Set(demoConfig_t& cfg, const std::string& key, const std::string& value)
+{
+	bool ok = false;
+
+	if (key == "effect")
+	{
+		for (const effectInfo_t& info : Effect_List())
+		{
+			if (value == info.name)
+			{
+				cfg.effect = value;
+				ok = true;
+			}
+		}
+	}
+	else if (key == "width")
+	{
+		ok = Config_ParseInt(value, -1, 16384, cfg.width);
+	}
+	else if (key == "height")
+	{
+		ok = Config_ParseInt(value, -1, 16384, cfg.height);
+	}
+	else if (key == "size")
+	{
+		int w = 0, h = 0;
+		char x = 0;
+		if (sscanf(value.c_str(), "%d%c%d", &w, &x, &h) == 3 && x == 'x' && w > 0 && h > 0)
+		{
+			cfg.width = w;
+			cfg.height = h;
+			ok = true;
+		}
+	}
+	else if (key == "fullscreen")
+	{
+		ok = Config_ParseBool(value, cfg.fullscreen);
+	}
+	else if (key == "vsync")
+	{
+		ok = Config_ParseInt(value, -1, 1, cfg.swapInterval);
+	}
+	else if (key == "msaa")
+	{
+		ok = Config_ParseInt(value, 0, 32, cfg.msaa);
+	}
+	else if (key == "frames_in_flight")
+	{
+		ok = Config_ParseInt(value, 1, 3, cfg.framesInFlight);
+	}
+	else if (key == "sim_rate")
+	{
+		ok = Config_ParseInt(value, 1, 1000, cfg.simRate);
+	}
+	else if (key == "root")
+	{
+		if (!value.empty())
+		{
+			cfg.root = value;
+			ok = true;
+		}
+	}
+	else
+	{
+		Warning("Config: unknown key '%s'", key.c_str());
+		return false;
+	}
+
+	if (!ok)
+	{
+		Warning("Config: bad value '%s' for %s", value.c_str(), key.c_str());
+	}
+
+	return ok;
+}
+
+bool Config_Load(const std::string& fileName, demoConfig_t& cfg)
+{
+	std::ifstream file(fileName);
+	if (!file.good())
+	{
+		return false;
+	}
+
+	std::string line;
+	int lineNum = 0;
+
+	while (std::getline(file, line))
+	{
+		++lineNum;
+		line = Config_Trim(line);
+
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		const size_t eq = line.find('=');
+		if (eq == std::string::npos)
+		{
+			Warning("Config: %s:%d, expected key = value", fileName.c_str(), lineNum);
+			continue;
+		}
+
+		Config_Set(cfg, Config_Trim(line.substr(0, eq)), Config_Trim(line.substr(eq + 1)));
+	}
+
+	Info("Config: loaded %s", fileName.c_str());
+
+	return true;
+}
+
+static void Config_PrintUsage(const char* program)
+{
+	printf("usage: %s [-config file] [-effect name] [-size WxH] [-width N] [-height N] [-fullscreen 0|1]\n"
+		"          [-vsync -1|0|1] [-msaa N] [-frames_in_flight 1-3] [-sim_rate N] [-root dir] [-list]\n", program);
+}
+
+bool Config_Init(int argc, char** argv, demoConfig_t& cfg)
+{
+	std::string configFile;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-help") || !strcmp(argv[i], "--help"))
+		{
+			Config_PrintUsage(argv[0]);
+			return false;
+		}
+		if (!strcmp(argv[i], "-list"))
+		{
+			for (const effectInfo_t& info : Effect_List())
+			{
+				printf("%-12s %s\n", info.name, info.description);
+			}
+			return false;
+		}
+		if (!strcmp(argv[i], "-config") && i + 1 < argc)
+		{
+			configFile = argv[++i];
+		}
+	}
+
+	if (!configFile.empty())
+	{
+		if (!Config_Load(configFile, cfg))
+		{
+			Error("Config: cannot read %s", configFile.c_str());
+			return false;
+		}
+	}
+	else
+	{
+		// optional, the defaults stand without it
+		Config_Load("demo.cfg", cfg);
+	}
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-config"))
+		{
+			++i;
+			continue;
+		}
+
+		if (argv[i][0] != '-' || i + 1 >= argc)
+		{
+			Error("Config: bad option %s", argv[i]);
+			Config_PrintUsage(argv[0]);
+			return false;
+		}
+
+		if (!Config_Set(cfg, argv[i] + 1, argv[i + 1]))
+		{
+			return false;
+		}
+		++i;
+	}
+
+	if (!cfg.fullscreen && (cfg.width <= 0 || cfg.height <= 0))
+	{
+		Error("Config: a window needs a positive size, got %dx%d", cfg.width, cfg.height);
+		Config_PrintUsage(argv[0]);
+		return false;
+	}
+
+	return true;
+}
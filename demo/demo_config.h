@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+/*
+Start-up settings. Defaults below, then a key = value file (demo.cfg in
+the current directory unless -config names another), then the command
+line, where every key is also an option: -width 1920 -effect pointcube.
+
+keys:
+  effect            name from the effect registry (-list prints them)
+  width, height     window size, -1 -1 with fullscreen uses the desktop,
+                    must be positive for a window
+  size              WxH, both at once
+  fullscreen        0 / 1
+  vsync             swap interval: 0 off, 1 vsync, -1 adaptive
+  msaa              samples of the window's framebuffer, 0 off
+  frames_in_flight  1..3, see FrameScheduler
+  sim_rate          simulation steps per second
+  root              asset root, paths in effects are relative to it,
+                    the current directory by default
+
+Lines starting with # are comments. Unknown keys and bad values are
+reported and skipped, the rest still applies.
+*/
+struct demoConfig_t
+{
+	std::string effect = "compute";
+	int width = 1440;
+	int height = 900;
+	bool fullscreen = false;
+	int swapInterval = 1;
+	int msaa = 0;
+	int framesInFlight = 2;
+	int simRate = 60;
+	std::string root = ".";
+};
+
+// false for an unknown key or a bad value, cfg is unchanged then
+bool Config_Set(demoConfig_t& cfg, const std::string& key, const std::string& value);
+
+// false when the file cannot be read, bad lines only warn
+bool Config_Load(const std::string& fileName, demoConfig_t& cfg);
+
+/*
+Loads the config file and applies the options on top. false means
+main should exit: a bad option, -help or -list (both print to stdout).
+*/
+bool Config_Init(int argc, char** argv, demoConfig_t& cfg);
@@ -1,10 +1,22 @@
 #pragma once
 
+class Pipeline;
+
+/*
+Update() runs at a fixed rate, time is the step in milliseconds and it
+may run several times or not at all between two frames. Render() gets
+alpha, the fraction of a step the frame is past the last update; effects
+keep the previous simulation state and draw mix(previous, current, alpha).
+Render() binds programs, textures, VAOs and framebuffers through p; the
+main loop calls p.beginFrame() right before it. Shaders reading the
+constant blocks need p.g_cam and the world transform set and p.update()
+called before the draw.
+*/
 struct Effect
 {
 	virtual bool Init() = 0;
 	virtual bool Update(float time) = 0;
 	virtual bool HandleEvent(const SDL_Event* ev) = 0;
-	virtual void Render() = 0;
+	virtual void Render(Pipeline& p, float alpha) = 0;
 	virtual ~Effect() {}
 };
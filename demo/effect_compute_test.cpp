@@ -5,12 +5,21 @@
 #include "unit_rect.h"
 #include "gpu_utils.h"
 #include "logger.h"
+#include "gpu_profiler.h"
+#include "gpu_framebuffer.h"
+#include "pipeline.h"
 
 bool ComputeTestEffect::Init()
 {
 
     while (glGetError() != GL_NO_ERROR) {}
 
+    GpuProgramBatch programs;
+    programs.addCompute(prg_compute, g_fileSystem.resolve("assets/shaders/test_compute.cs.glsl"));
+    programs.add(prg_view,
+        g_fileSystem.resolve("assets/shaders/test_compute.vs.glsl"),
+        g_fileSystem.resolve("assets/shaders/test_compute.fs.glsl"));
+
     tex0_.selectUnit(0);
     //tex0_.create(tex_w, tex_h, 0, eTextureFormat::RGBA, ePixelFormat::RGBA, eDataType::UNSIGNED_BYTE, nullptr);
     tex0_.createRGB8(tex_w, tex_h, 0);
@@ -24,9 +33,7 @@ bool ComputeTestEffect::Init()
         .with(1, 2, eDataType::FLOAT, false, 8, sizeof(vertexLayout_t), &vbo_rect)
         .end();
 
-    layout.bind();
-
-    if (!prg_compute.loadComputeShader(g_fileSystem.resolve("assets/shaders/test_compute.cs.glsl")))
+    if (!programs.wait())
     {
         return false;
     }
@@ -37,27 +44,21 @@ bool ComputeTestEffect::Init()
 
     //u_angle = prg_compute.getLocation("angle");
     prg_compute.bindUniformBlock("cb_vars", 0);
-    cbo.create(128, eGpuBufferUsage::DYNAMIC, BA_MAP_WRITE | BA_MAP_PERSISTENT | BA_MAP_COHERENT, nullptr);
-    cbo.bindIndexed(0);
-    cb_vars = reinterpret_cast<cbvars_t*>(cbo.mapPeristentWrite());
-
-    angle = 0.0f;
-    cb_vars->angle = 0.0f;
-
-    if (!prg_view.loadShader(
-        g_fileSystem.resolve("assets/shaders/test_compute.vs.glsl"),
-        g_fileSystem.resolve("assets/shaders/test_compute.fs.glsl")))
+    if (!cbo.create(1024))
     {
         return false;
     }
 
+    angle = 0.0f;
+    prevAngle = 0.0f;
+
     return true;
 }
 
 bool ComputeTestEffect::Update(float time)
 {
+    prevAngle = angle;
     angle += 0.1f * time;
-    cb_vars->angle = angle;
 
     return true;
 }
@@ -67,24 +68,40 @@ bool ComputeTestEffect::HandleEvent(const SDL_Event* ev)
     return true;
 }
 
-void ComputeTestEffect::Render()
+void ComputeTestEffect::Render(Pipeline& p, float alpha)
 {
-    if (syncObj) GL_CHECK( glDeleteSync(syncObj) );
+    // this frame's copy of the constants, the GPU may still read the previous ones
+    cbo.beginFrame();
+    uint32_t offset = 0;
+    cbvars_t* cb_vars = cbo.alloc<cbvars_t>(offset);
+    cb_vars->angle = glm::mix(prevAngle, angle, alpha);
+    cbo.bindIndexed(0, offset, sizeof(cbvars_t));
+
+    {
+        GPU_PROFILE_SCOPE("Compute");
+
+        p.bindProgram(&prg_compute);
+        //GL_CHECK(glUniform1f(u_angle, angle ));
 
-    prg_compute.use();
-    //GL_CHECK(glUniform1f(u_angle, angle ));
+        GL_CHECK(glDispatchCompute(tex_w, tex_h, 1));
+        // orders the image writes before the view pass samples them, no fence needed
+        GL_CHECK(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT));
+    }
+
+    {
+        GPU_PROFILE_SCOPE("View");
 
-    GL_CHECK(glDispatchCompute(tex_w, tex_h, 1));
-    GL_CHECK(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
-    GL_CHECK(syncObj = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
-    GL_CHECK(glWaitSync(syncObj, 0, GL_TIMEOUT_IGNORED));
+        p.bindFrameBuffer(nullptr);
+        p.bindProgram(&prg_view);
+        p.bindTexture(0, &tex0_);
+        p.bindVertexArray(&layout);
+        p.drawArrays(eDrawMode::TRIANGLES, 0, 6);
+    }
 
-    prg_view.use();
-    GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+    cbo.endFrame();
 
 }
 
 ComputeTestEffect::~ComputeTestEffect() noexcept
 {
-    cbo.unMap();
 }
@@ -6,6 +6,7 @@
 #include "effect.h"
 #include "gpu_types.h"
 #include "gpu_buffer.h"
+#include "gpu_ring_buffer.h"
 #include "gpu_program.h"
 #include "gpu_texture.h"
 #include "gpu_vertex_layout.h"
@@ -16,13 +17,14 @@ struct ComputeTestEffect : public Effect
 	virtual bool Init() override;
 	virtual bool Update(float time) override;
 	virtual bool HandleEvent(const SDL_Event* ev) override;
-	virtual void Render() override;
+	virtual void Render(Pipeline& p, float alpha) override;
 
 	struct cbvars_t {
 		float angle;
-	} *cb_vars;
+		float pad[3];
+	};
 
-	GpuBuffer cbo;
+	GpuRingBuffer cbo;
 	GpuBuffer vbo_rect;
 	GpuProgram prg_compute;
 	GpuProgram prg_view;
@@ -31,8 +33,8 @@ struct ComputeTestEffect : public Effect
 	GpuTexture2D tex0_;
 	VertexLayout layout;
 	float angle;
+	float prevAngle;
 	GLint u_angle;
-	GLsync syncObj;
 
 	struct vertexLayout_t
 	{
@@ -46,11 +48,10 @@ struct ComputeTestEffect : public Effect
 		prg_compute(),
 		prg_view(),
 		angle(0.0f),
+		prevAngle(0.0f),
 		u_angle(-1),
-		syncObj(),
 		tex0_(),
-		layout(),
-		cb_vars()
+		layout()
 	{}
 
 	~ComputeTestEffect() noexcept;
@@ -6,16 +6,21 @@
 #include <cmath>
 #include <vector>
 #include <memory>
+#include <random>
 
 #include "effect_pointcube.h"
 #include "demo.h"
 #include "logger.h"
 #include "filesystem.h"
+#include "job_system.h"
+#include "asset_manager.h"
 #include "gpu_buffer.h"
 #include "stb_image.h"
 #include "gpu_types.h"
 #include "gpu_utils.h"
 #include "gpu_texture.h"
+#include "gpu_profiler.h"
+#include "pipeline.h"
 #include "unit_rect.h"
 #include "unit_box.h"
 
@@ -27,13 +32,7 @@ GLsizei FB_X, FB_Y;
 PointCubeEffect::~PointCubeEffect()
 {
 	GL_FLUSH_ERRORS
-	GL_CHECK(glUseProgram(0));
 	GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
-	GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
-
-	if (vao_points != 0xffff)	GL_CHECK(glDeleteVertexArrays(1, &vao_points));
-	if (vao_pp != 0xffff)		GL_CHECK(glDeleteVertexArrays(1, &vao_pp));
-	if (vao_skybox != 0xffff)	GL_CHECK(glDeleteVertexArrays(1, &vao_skybox));
 }
 
 bool PointCubeEffect::Init()
@@ -63,13 +62,15 @@ bool PointCubeEffect::Init()
 
 	assert(textures_faces.size() == 6);
 
-	if (!skyTex_.createFromImage(textures_faces, true, false, true))
+	// streamed in the background, a grey placeholder is bound until then
+	skyTex_ = std::make_shared<GpuTextureCubeMap>();
+	if (!g_assetManager.loadCubeMap(skyTex_, textures_faces, true, false))
 	{
 		Error("load cubemap error");
 		return false;
 	}
 
-	skyTex_.withDefaultLinearClampEdge().updateParameters();
+	skyTex_->withDefaultLinearClampEdge().updateParameters();
 
 
 	depthTex = GpuTexture2D::createShared();
@@ -89,18 +90,18 @@ bool PointCubeEffect::Init()
 		return false;
 	}
 
-	GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
-
-	GL_CHECK(glCreateVertexArrays(1, &vao_points));
-	GL_CHECK(glCreateVertexArrays(1, &vao_pp));
-	GL_CHECK(glCreateVertexArrays(1, &vao_skybox));
-	
+	// the driver compiles these while the point cloud is generated
+	GpuProgramBatch programs;
+	programs.add(prgPoints, g_fileSystem.resolve("assets/shaders/draw_point.vs.glsl"), g_fileSystem.resolve("assets/shaders/draw_point.fs.glsl"));
+	programs.add(prgPP, g_fileSystem.resolve("assets/shaders/kernel.vs.glsl"), g_fileSystem.resolve("assets/shaders/kernel.fs.glsl"));
+	programs.add(prgSkybox, g_fileSystem.resolve("assets/shaders/skybox.vs.glsl"), g_fileSystem.resolve("assets/shaders/skybox.fs.glsl"));
+	programs.add(prgTextureRect, g_fileSystem.resolve("assets/shaders/view_depthbuf.vs.glsl"), g_fileSystem.resolve("assets/shaders/view_depthbuf.fs.glsl"));
 
-	const GLsizeiptr bufSize = sizeof(VertexLayout) * NUMPOINTS;
+	const GLsizeiptr bufSize = sizeof(PointLayout) * NUMPOINTS;
 	vbo_points.create(bufSize, eGpuBufferUsage::STATIC, 0);
 
 	uint8_t *ptr = vbo_points.map(BA_MAP_WRITE);
-	VertexLayout* buffer = reinterpret_cast<VertexLayout*>(ptr);
+	PointLayout* buffer = reinterpret_cast<PointLayout*>(ptr);
 
 	Info("VertexBuffer: allocated %d bytes, mapped at %p", (int)bufSize, buffer);
 
@@ -108,19 +109,26 @@ bool PointCubeEffect::Init()
 
 	const int n = 1000, n2 = n / 2; // particles spread in the cube
 
-	for (unsigned i = 0; i < NUMPOINTS; ++i)
+	// rand() is not thread safe, every chunk seeds its own generator
+	g_jobSystem.parallelFor(NUMPOINTS, 16384, [buffer, n, n2](uint32_t begin, uint32_t end)
 	{
-		const float x = static_cast<float>(rand() % n - n2);
-		const float y = static_cast<float>(rand() % n - n2);
-		const float z = static_cast<float>(rand() % n - n2);
-		buffer[i].x = x;
-		buffer[i].y = y;
-		buffer[i].z = z;
-		buffer[i].r = static_cast<GLubyte>( 255 * ((x / n) + 0.5f) );
-		buffer[i].g = static_cast<GLubyte>( 255 * ((y / n) + 0.5f) );
-		buffer[i].b = static_cast<GLubyte>( 255 * ((z / n) + 0.5f) );
-		buffer[i].a = 255;
-	}
+		std::minstd_rand rng(begin + 1);
+		std::uniform_int_distribution<int> dist(0, n - 1);
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const float x = static_cast<float>(dist(rng) - n2);
+			const float y = static_cast<float>(dist(rng) - n2);
+			const float z = static_cast<float>(dist(rng) - n2);
+			buffer[i].x = x;
+			buffer[i].y = y;
+			buffer[i].z = z;
+			buffer[i].r = static_cast<GLubyte>( 255 * ((x / n) + 0.5f) );
+			buffer[i].g = static_cast<GLubyte>( 255 * ((y / n) + 0.5f) );
+			buffer[i].b = static_cast<GLubyte>( 255 * ((z / n) + 0.5f) );
+			buffer[i].a = 255;
+		}
+	});
 	vbo_points.unMap();
 
 
@@ -128,63 +136,23 @@ bool PointCubeEffect::Init()
 
 	vbo_skybox.create(sizeof(UNIT_BOX_POSITIONS), eGpuBufferUsage::STATIC, 0, UNIT_BOX_POSITIONS);
 
-	if (!prgPoints.loadShader(g_fileSystem.resolve("assets/shaders/draw_point.vs.glsl"), g_fileSystem.resolve("assets/shaders/draw_point.fs.glsl")))
+	if (!programs.wait())
 	{
-		Error("Cannot load shader 'draw_point'");
+		Error("Cannot load shaders");
 		return false;
 	}
 
-	prgPoints.mapLocationToIndex("m_WVP", 0);
-
-	if (!prgPP.loadShader(g_fileSystem.resolve("assets/shaders/kernel.vs.glsl"), g_fileSystem.resolve("assets/shaders/kernel.fs.glsl")))
-	{
-		Error("Cannot load shader 'kernel'");
-		return false;
-	}
-
-
 	prgPP.mapLocationToIndex("samp0", 0);
 	prgPP.mapLocationToIndex("g_kernel", 1);
 	prgPP.mapLocationToIndex("g_offset", 2);
 
-	prgPP.use();
+	// set() writes through glProgramUniform*, nothing is bound outside Render
 	prgPP.set(2, pp_offset);
 	prgPP.set(1, 9, kernels[KERNEL_BLUR]);
-	GL_CHECK(glUseProgram(0));
 
-	if (!prgSkybox.loadShader(g_fileSystem.resolve("assets/shaders/skybox.vs.glsl"), g_fileSystem.resolve("assets/shaders/skybox.fs.glsl")))
-	{
-		Error("Cannot load shader 'skybox'");
-		return false;
-	}
-
-	prgSkybox.use();
-	prgSkybox.mapLocationToIndex("m_V", 0);
-	prgSkybox.mapLocationToIndex("m_P", 1);
-	prgSkybox.mapLocationToIndex("samp0", 2);
-
-	prgSkybox.set(2, 0);
-
-	glm::vec3 viewPos{ 0, 0, eyeZ };
+	prgSkybox.mapLocationToIndex("samp0", 0);
+	prgSkybox.set(0, 0);
 
-	glm::mat4 V = glm::lookAt(viewPos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-	P = glm::perspective(45.0f, (float)videoConf.width / videoConf.height, 1.0f, 1700.0f);
-
-	VP = P * V;
-
-	glm::mat4 sky_view = glm::mat4(glm::mat3(V));
-	prgSkybox.set(0, false, sky_view);
-	prgSkybox.set(1, false, P);
-
-	GL_CHECK(glUseProgram(0));
-
-	if (!prgTextureRect.loadShader(g_fileSystem.resolve("assets/shaders/view_depthbuf.vs.glsl"), g_fileSystem.resolve("assets/shaders/view_depthbuf.fs.glsl")))
-	{
-		Error("Cannot load shader 'texture_rect'");
-		return false;
-	}
-
-	prgTextureRect.use();
 	prgTextureRect.mapLocationToIndex("samp0", 0);
 	prgTextureRect.mapLocationToIndex("m_W", 1);
 	prgTextureRect.set(0, 0);
@@ -195,8 +163,6 @@ bool PointCubeEffect::Init()
 	rectTrans = glm::scale(rectTrans, glm::vec3(.25f, .25f, 1.0f));
 	prgTextureRect.set(1, false, rectTrans);
 
-	GL_CHECK(glUseProgram(0));
-
 	//glPointSize(2.5f);
 	GL_CHECK(glEnable(GL_PROGRAM_POINT_SIZE));
 	GL_CHECK(glEnable(GL_DEPTH_TEST));
@@ -213,32 +179,19 @@ bool PointCubeEffect::Init()
 	GL_CHECK(glClearColor(lum, lum*2, lum*3, 1.0f ));
 
 
-	GL_CHECK(glBindVertexArray(vao_points));
-	vbo_points.bind();
-	GL_CHECK(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexLayout), (void *)0));
-	GL_CHECK(glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexLayout), (void*)12));
-	GL_CHECK(glEnableVertexAttribArray(0));
-	GL_CHECK(glEnableVertexAttribArray(1));
-	GL_CHECK(glBindVertexArray(0));
-	GL_CHECK(glDisableVertexAttribArray(0));
-	GL_CHECK(glDisableVertexAttribArray(1));
-
-	GL_CHECK(glBindVertexArray(vao_pp));
-	vbo_pp.bind();
-	GL_CHECK(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(PPLayout), (void *)0));
-	GL_CHECK(glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(PPLayout), (void *)8));
-	GL_CHECK(glEnableVertexAttribArray(0));
-	GL_CHECK(glEnableVertexAttribArray(1));
-	GL_CHECK(glBindVertexArray(0));
-	GL_CHECK(glDisableVertexAttribArray(0));
-	GL_CHECK(glDisableVertexAttribArray(1));
-
-	GL_CHECK(glBindVertexArray(vao_skybox));
-	vbo_skybox.bind();
-	GL_CHECK(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0));
-	GL_CHECK(glEnableVertexAttribArray(0));
-	GL_CHECK(glBindVertexArray(0));
-	GL_CHECK(glDisableVertexAttribArray(0));
+	layout_points.begin()
+		.with(0, 3, eDataType::FLOAT, false, 0, sizeof(PointLayout), &vbo_points)
+		.with(1, 4, eDataType::UNSIGNED_BYTE, true, 12, sizeof(PointLayout), &vbo_points)
+		.end();
+
+	layout_pp.begin()
+		.with(0, 2, eDataType::FLOAT, false, 0, sizeof(PPLayout), &vbo_pp)
+		.with(1, 2, eDataType::FLOAT, false, 8, sizeof(PPLayout), &vbo_pp)
+		.end();
+
+	layout_skybox.begin()
+		.with(0, 3, eDataType::FLOAT, false, 0, sizeof(float) * 3, &vbo_skybox)
+		.end();
 
 	return true;
 
@@ -246,25 +199,45 @@ bool PointCubeEffect::Init()
 
 bool PointCubeEffect::Update(float time)
 {
+	prevRotX = rotX;
+	prevRotY = rotY;
+
 	rotX += time * 0.015f;
 	rotY += time * 0.01f;
 	//rotX = 15.0f;
-	rotX = std::fmodf(rotX, 360.0f);
-	rotY = std::fmodf(rotY, 360.0f);
+
+	// wrap both states together so the interpolation never runs backwards across 360
+	if (rotX >= 360.0f)
+	{
+		rotX -= 360.0f;
+		prevRotX -= 360.0f;
+	}
+	if (rotY >= 360.0f)
+	{
+		rotY -= 360.0f;
+		prevRotY -= 360.0f;
+	}
 
 	return true;
 }
 
-void PointCubeEffect::Render()
+void PointCubeEffect::Render(Pipeline& p, float alpha)
 {
-	glm::mat4 W(1.0f);
-	W = glm::rotate(W, glm::radians(rotX), glm::vec3(1, 0, 0));
-	W = glm::rotate(W, glm::radians(rotY), glm::vec3(0, 1, 0));
-	
-	const glm::mat4 WVP = VP * W;
+	const float rx = glm::mix(prevRotX, rotX, alpha);
+	const float ry = glm::mix(prevRotY, rotY, alpha);
 
+	// the points and the sky read the matrices and the camera from the constant blocks
+	p.g_cam.v_position = glm::vec4(0, 0, eyeZ, 1);
+	p.g_cam.v_direction = glm::vec4(0, 0, -1, 0);
+	p.g_cam.v_up = glm::vec4(0, 1, 0, 0);
+	p.g_cam.v_near_far_fov = glm::vec4(1.0f, 1700.0f, 45.0f, 0.0f);
+	p.setScreenRect(FB_X, FB_Y);
+	p.setWorldQuaternionRotation(glm::angleAxis(glm::radians(rx), glm::vec3(1, 0, 0)) * glm::angleAxis(glm::radians(ry), glm::vec3(0, 1, 0)));
+	p.update(float(SDL_GetTicks64()));
 
-	m_fb.bind();
+	PROFILE_SCOPE("PointCube");
+
+	p.bindFrameBuffer(&m_fb);
 	
 	GL_CHECK(glDisable(GL_BLEND));
 
@@ -274,42 +247,46 @@ void PointCubeEffect::Render()
 
 	GL_CHECK(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
-	GL_CHECK(glBindTexture(GL_TEXTURE_2D, 0));
-
+	// fbTex is the render target now
+	p.bindTexture(0, nullptr);
 
-	GL_CHECK(glBindVertexArray(vao_points));
 
-	prgPoints.use();
-	prgPoints.set(0, false, WVP);
+	{
+		GPU_PROFILE_SCOPE("Points");
 
-	GL_CHECK(glDrawArrays(GL_POINTS, 0, NUMPOINTS));
+		p.bindVertexArray(&layout_points);
+		p.bindProgram(&prgPoints);
 
-	GL_CHECK(glDepthMask(GL_FALSE));
-	skyTex_.bind();
+		p.drawArrays(eDrawMode::POINTS, 0, NUMPOINTS);
+	}
 
-	GL_CHECK(glBindVertexArray(vao_skybox));
-	prgSkybox.use();
+	{
+		GPU_PROFILE_SCOPE("Skybox");
 
-	const glm::mat4 sky_view = glm::mat4(glm::mat3(W));
-	prgSkybox.set(0, false, sky_view);
+		GL_CHECK(glDepthMask(GL_FALSE));
+		p.bindTexture(0, skyTex_.get());
+		p.bindVertexArray(&layout_skybox);
+		p.bindProgram(&prgSkybox);
 
-	GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 36));
+		p.drawArrays(eDrawMode::TRIANGLES, 0, 36);
 
-	GL_CHECK(glDepthMask(GL_TRUE));
+		GL_CHECK(glDepthMask(GL_TRUE));
+	}
 	GL_CHECK(glViewport(0, 0, videoConf.width, videoConf.height));
 
-	GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	p.bindFrameBuffer(nullptr);
 
-	GL_CHECK(glBindVertexArray(vao_pp));
+	GPU_PROFILE_SCOPE("PostProcess");
 
-	prgPP.use();
+	p.bindVertexArray(&layout_pp);
+	p.bindProgram(&prgPP);
 	prgPP.set(2, pp_offset);
 
-	fbTex->bind();
+	p.bindTexture(0, fbTex.get());
 	GL_CHECK(glDisable(GL_DEPTH_TEST));
 	GL_CHECK(glEnable(GL_FRAMEBUFFER_SRGB));
 
-	GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+	p.drawArrays(eDrawMode::TRIANGLES, 0, 6);
 
 	GL_CHECK(glDisable(GL_FRAMEBUFFER_SRGB));
 
@@ -317,27 +294,23 @@ void PointCubeEffect::Render()
 
 	//glViewport(0, 0, 400, 250);
 
-	prgTextureRect.use();
-	depthTex->bind();
-	GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6));
+	p.bindProgram(&prgTextureRect);
+	p.bindTexture(0, depthTex.get());
+	p.drawArrays(eDrawMode::TRIANGLES, 0, 6);
 
 }
 
 bool PointCubeEffect::HandleEvent(const SDL_Event* ev)
 {
-	bool mustUpdate = false;
-
 	if (ev->type == SDL_KEYDOWN)
 	{
 		switch (ev->key.keysym.sym)
 		{
 		case SDLK_w:
 			eyeZ -= 5.0f;
-			mustUpdate = true;
 			break;
 		case SDLK_s:
 			eyeZ += 5.0f;
-			mustUpdate = true;
 			break;
 		case SDLK_x:
 			if (pp_offset >= 0.0005) pp_offset -= 0.001;
@@ -350,15 +323,6 @@ bool PointCubeEffect::HandleEvent(const SDL_Event* ev)
 		}
 	}
 
-	if (mustUpdate)
-	{
-		glm::vec3 viewPos{ 0, 0, eyeZ };
-
-		glm::mat4 V = glm::lookAt(viewPos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-
-		VP = P * V;
-	}
-
 	//SDL_Log("ev.type: %d, mouseX: %d, mouseY: %d", ev->type, ev->motion.x, ev->motion.y);
 
 	return true;
@@ -10,6 +10,7 @@
 #include "gpu_program.h"
 #include "gpu_texture.h"
 #include "gpu_framebuffer.h"
+#include "gpu_vertex_layout.h"
 
 #define KERNEL_BLUR 0
 #define KERNEL_BOTTOM_SOBEL 1
@@ -76,13 +77,10 @@ struct PointCubeEffect : public Effect
 	PointCubeEffect() :
 		eyeZ(1200.0f),
 		offset_loc(-1),
-		VP(),
-		P(),
 		rotX(),
 		rotY(),
-		vao_points(0xffff),
-		vao_pp(0xffff),
-		vao_skybox(0xffff),
+		prevRotX(),
+		prevRotY(),
 		pp_offset(1.0f/1000.0f),
 		fbTex(),
 		skyTex_(),
@@ -95,7 +93,7 @@ struct PointCubeEffect : public Effect
 
 	bool Init() override;
 	bool Update(float time) override;
-	void Render() override;
+	void Render(Pipeline& p, float alpha) override;
 	bool HandleEvent(const SDL_Event* ev) override;
 
 	//GLuint vbo, vbo_pp;
@@ -103,14 +101,14 @@ struct PointCubeEffect : public Effect
 	GpuBuffer vbo_pp;
 	GpuBuffer vbo_skybox;
 
-	GLuint vao_points;
-	GLuint vao_pp;
-	GLuint vao_skybox;
+	VertexLayout layout_points;
+	VertexLayout layout_pp;
+	VertexLayout layout_skybox;
 
 	GpuFrameBuffer m_fb;
 	GpuTexture2D::Ptr fbTex;
 	GpuTexture2D::Ptr depthTex;
-	GpuTextureCubeMap skyTex_;
+	GpuTextureCubeMap::Ptr skyTex_;
 
 	GLint rectWMtx;
 
@@ -119,7 +117,7 @@ struct PointCubeEffect : public Effect
 
 	const int NUMPOINTS = 500000;
 
-	struct VertexLayout
+	struct PointLayout
 	{
 		GLfloat x, y, z;
 		GLubyte r, g, b, a;
@@ -132,8 +130,7 @@ struct PointCubeEffect : public Effect
 	};
 
 	float rotX, rotY, eyeZ;
-	glm::mat4 P;
-	glm::mat4 VP;
+	float prevRotX, prevRotY;	// state of the step before, Render() interpolates
 
 	GpuProgram prgPoints;
 	GpuProgram prgPP;
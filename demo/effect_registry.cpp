@@ -0,0 +1,36 @@
+#include <SDL.h>
+#include "logger.h"
+#include "effect_pointcube.h"
+#include "effect_compute_test.h"
+#include "effect_registry.h"
+
+template<class T>
+static Effect* Effect_New()
+{
+	return new T();
+}
+
+const std::vector<effectInfo_t>& Effect_List()
+{
+	static const std::vector<effectInfo_t> effects = {
+		{ "pointcube", "rotating point cloud with skybox and post process", &Effect_New<PointCubeEffect> },
+		{ "compute", "compute shader writing a texture", &Effect_New<ComputeTestEffect> }
+	};
+
+	return effects;
+}
+
+std::unique_ptr<Effect> Effect_Create(const std::string& name)
+{
+	for (const effectInfo_t& info : Effect_List())
+	{
+		if (name == info.name)
+		{
+			return std::unique_ptr<Effect>(info.create());
+		}
+	}
+
+	Error("Unknown effect '%s'", name.c_str());
+
+	return nullptr;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+#include "effect.h"
+
+/*
+Effects by name, so the demo and demo_bench can pick one at run time.
+A new effect adds one line to the table in effect_registry.cpp.
+*/
+struct effectInfo_t
+{
+	const char* name;
+	const char* description;
+	Effect* (*create)();
+};
+
+// nullptr for an unknown name
+std::unique_ptr<Effect> Effect_Create(const std::string& name);
+const std::vector<effectInfo_t>& Effect_List();
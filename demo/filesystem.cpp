@@ -3,6 +3,19 @@
 #include <sstream>
 #include <string>
 #include <regex>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 #include "filesystem.h"
 #include "logger.h"
 
@@ -75,6 +88,131 @@ std::vector<uint8_t> FileSystem::read_binary_file(const std::string& filename)
 	return result;
 }
 
+bool FileSystem::write_binary_file(const std::string& filename, const void* data, size_t size)
+{
+	std::ofstream output{ filename, std::ios::binary | std::ios::trunc };
+
+	if (!output.good())
+	{
+		Error("Cannot open file %s for writing", filename.c_str());
+		return false;
+	}
+
+	output.write(reinterpret_cast<const char*>(data), size);
+	output.close();
+
+	return !output.fail();
+}
+
+MappedFile::Ptr FileSystem::map_binary_file(const std::string& filename)
+{
+	auto result = std::make_shared<MappedFile>();
+
+	if (!result->open(filename))
+	{
+		return nullptr;
+	}
+
+	return result;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		Error("Cannot open file %s", filename.c_str());
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+	{
+		Error("Cannot map file %s", filename.c_str());
+		CloseHandle(file);
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data)
+	{
+		Error("Cannot map file %s", filename.c_str());
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_size = size_t(size.QuadPart);
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		Error("Cannot open file %s", filename.c_str());
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* ptr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	if (ptr == MAP_FAILED)
+	{
+		Error("Cannot map file %s", filename.c_str());
+		::close(fd);
+		return false;
+	}
+
+	madvise(ptr, size_t(st.st_size), MADV_WILLNEED);
+
+	m_fd = fd;
+	m_data = static_cast<const uint8_t*>(ptr);
+	m_size = size_t(st.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (!m_data) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(m_data), m_size);
+	::close(m_fd);
+	m_fd = -1;
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
+
 std::vector<std::string> FileSystem::get_directory_entries(const std::string& dirname, const char* filter)
 {
 	std::vector<std::string> result;
@@ -135,4 +273,140 @@ bool FileSystem::load_image_base(const std::string& filename, int& w, int& h, in
 void FileSystem::free_image(void* data)
 {
 	stbi_image_free(data);
-}
\ No newline at end of file
+}
+
+static fs::file_time_type WriteTime(const std::string& filename)
+{
+	std::error_code ec;
+	const fs::file_time_type t = fs::last_write_time(filename, ec);
+
+	return ec ? fs::file_time_type::min() : t;
+}
+
+int FileSystem::watch_files(const std::vector<std::string>& files, std::function<void()> fn)
+{
+	watch_t w;
+	w.id = m_next_watch_id++;
+	w.fn = std::move(fn);
+
+	for (const std::string& f : files)
+	{
+		w.files.push_back(fs::path(f).lexically_normal().generic_string());
+		w.times.push_back(WriteTime(w.files.back()));
+	}
+
+#ifdef __linux__
+	if (m_inotify_fd < 0)
+	{
+		m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_inotify_fd < 0)
+		{
+			Warning("inotify_init1 failed, file watching falls back to polling");
+		}
+	}
+
+	if (m_inotify_fd >= 0)
+	{
+		// editors often save by renaming a temporary over the file, the
+		// directory is watched so the new inode is still seen
+		for (const std::string& f : w.files)
+		{
+			const std::string dir = fs::path(f).parent_path().generic_string();
+			const int wd = inotify_add_watch(m_inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd >= 0)
+			{
+				m_watched_dirs[wd] = dir;
+			}
+		}
+	}
+#endif
+
+	m_watches.push_back(std::move(w));
+
+	return m_watches.back().id;
+}
+
+void FileSystem::unwatch(int id)
+{
+	m_watches.erase(std::remove_if(m_watches.begin(), m_watches.end(), [id](const watch_t& w) { return w.id == id; }), m_watches.end());
+}
+
+void FileSystem::poll_watches()
+{
+	if (m_watches.empty())
+	{
+		return;
+	}
+
+	std::vector<int> fired;
+
+#ifdef __linux__
+	if (m_inotify_fd >= 0)
+	{
+		std::vector<std::string> changed;
+		alignas(inotify_event) char buf[4096];
+
+		for (;;)
+		{
+			const ssize_t len = read(m_inotify_fd, buf, sizeof(buf));
+			if (len <= 0) break;
+
+			for (ssize_t p = 0; p < len;)
+			{
+				const inotify_event* ev = reinterpret_cast<const inotify_event*>(buf + p);
+				p += sizeof(inotify_event) + ev->len;
+
+				auto dir = m_watched_dirs.find(ev->wd);
+				if (ev->len > 0 && dir != m_watched_dirs.end())
+				{
+					changed.push_back(dir->second + "/" + ev->name);
+				}
+			}
+		}
+
+		for (const watch_t& w : m_watches)
+		{
+			for (const std::string& f : w.files)
+			{
+				if (std::find(changed.begin(), changed.end(), f) != changed.end())
+				{
+					fired.push_back(w.id);
+					break;
+				}
+			}
+		}
+	}
+	else
+#endif
+	{
+		for (watch_t& w : m_watches)
+		{
+			bool any = false;
+			for (size_t i = 0; i < w.files.size(); ++i)
+			{
+				const fs::file_time_type t = WriteTime(w.files[i]);
+				if (t != w.times[i])
+				{
+					w.times[i] = t;
+					any = true;
+				}
+			}
+
+			if (any)
+			{
+				fired.push_back(w.id);
+			}
+		}
+	}
+
+	// callbacks may change m_watches, look every one up again
+	for (int id : fired)
+	{
+		auto it = std::find_if(m_watches.begin(), m_watches.end(), [id](const watch_t& w) { return w.id == id; });
+		if (it != m_watches.end())
+		{
+			std::function<void()> fn = it->fn;
+			fn();
+		}
+	}
+}
@@ -3,9 +3,44 @@
 #include <cinttypes>
 #include <filesystem>
 #include <functional>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <stb_image.h>
 
+/*
+Read-only memory mapping of a whole file.
+The mapping lives as long as the object, so anything pointing into data()
+must hold a reference to it.
+*/
+class MappedFile
+{
+public:
+	using Ptr = std::shared_ptr<MappedFile>;
+
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool open(const std::string& filename);
+	void close();
+
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool isOpen() const { return m_data != nullptr; }
+private:
+	const uint8_t* m_data{};
+	size_t m_size{};
+#ifdef _WIN32
+	void* m_file{};
+	void* m_mapping{};
+#else
+	int m_fd{ -1 };
+#endif
+};
+
 class FileSystem
 {
 public:
@@ -16,12 +51,40 @@ public:
 	bool read_text_file(const std::string&, std::string&);
 	bool read_text_file_base(const std::string&, std::string&);
 	std::vector<uint8_t> read_binary_file(const std::string& aFileName);
+	bool write_binary_file(const std::string& aFileName, const void* data, size_t size);
+	MappedFile::Ptr map_binary_file(const std::string& aFileName);
 	std::vector<std::string> get_directory_entries(const std::string& dirname, const char* filter = nullptr);
 	void get_directory_entries(const std::string& dirname, const std::function<void(const std::string&)>& fn, const char* filter = nullptr);
 	bool load_image_base(const std::string& filename, int& w, int& h, int& channels, unsigned char** data);
 	void free_image(void* data);
+
+	/*
+	File watching for hot reload, main thread only. fn runs from
+	poll_watches() once per poll however many of the files changed, it
+	may add or remove watches. inotify on Linux, modification times
+	elsewhere.
+	*/
+	int watch_files(const std::vector<std::string>& files, std::function<void()> fn);
+	void unwatch(int id);
+	// call once per frame, before anything is rendered
+	void poll_watches();
 private:
+	struct watch_t
+	{
+		int id;
+		std::vector<std::string> files;
+		std::vector<std::filesystem::file_time_type> times;
+		std::function<void()> fn;
+	};
+
 	std::filesystem::path m_working_dir;
+
+	std::vector<watch_t> m_watches;
+	int m_next_watch_id{ 1 };
+#ifdef __linux__
+	int m_inotify_fd{ -1 };
+	std::unordered_map<int, std::string> m_watched_dirs;	// inotify wd -> directory
+#endif
 };
 
 extern FileSystem g_fileSystem;
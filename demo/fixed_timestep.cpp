@@ -0,0 +1,57 @@
+#include <chrono>
+#include "fixed_timestep.h"
+
+static int64_t FixedTimestep_Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FixedTimestep::FixedTimestep(double stepMs, int maxSteps) :
+	m_StepMs(stepMs > 0.0 ? stepMs : 1000.0 / 60.0),
+	m_MaxSteps(maxSteps > 0 ? maxSteps : 1),
+	m_Last(-1),
+	m_Accumulator(0.0),
+	m_Steps(0),
+	m_Dropped(0)
+{
+}
+
+void FixedTimestep::reset()
+{
+	m_Last = FixedTimestep_Now();
+	m_Accumulator = 0.0;
+}
+
+int FixedTimestep::advance()
+{
+	const int64_t now = FixedTimestep_Now();
+
+	// the first frame simulates nothing, there is no interval yet
+	const double elapsedMs = m_Last < 0 ? 0.0 : double(now - m_Last) * 1e-6;
+	m_Last = now;
+
+	return advanceBy(elapsedMs);
+}
+
+int FixedTimestep::advanceBy(double elapsedMs)
+{
+	m_Accumulator += elapsedMs > 0.0 ? elapsedMs : 0.0;
+
+	int steps = int(m_Accumulator / m_StepMs);
+	if (steps > m_MaxSteps)
+	{
+		m_Dropped += uint64_t(steps - m_MaxSteps);
+		m_Accumulator -= double(steps - m_MaxSteps) * m_StepMs;
+		steps = m_MaxSteps;
+	}
+
+	m_Accumulator -= double(steps) * m_StepMs;
+	// rounding must not leave alpha at or above one
+	if (m_Accumulator < 0.0 || m_Accumulator >= m_StepMs)
+	{
+		m_Accumulator = m_Accumulator < 0.0 ? 0.0 : m_StepMs * 0.999999;
+	}
+	m_Steps += uint64_t(steps);
+
+	return steps;
+}
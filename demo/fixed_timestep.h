@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cinttypes>
+
+/*
+Fixed rate simulation clock.
+
+advance() adds the real time since the previous call to an accumulator
+and returns how many whole steps the simulation owes, at most maxSteps;
+a longer stall (a breakpoint, a slow load) is dropped instead of being
+caught up, the simulation slows down rather than spiralling. What is
+left in the accumulator becomes getAlpha(), the fraction of a step the
+renderer should interpolate from the previous state to the current one.
+
+advanceBy() feeds an explicit duration instead of the clock, a
+benchmark or a replay passing the step length gets exactly one update
+per frame and the same results on every run.
+*/
+class FixedTimestep
+{
+public:
+	// stepMs is the simulation step, maxSteps the catch-up limit per frame
+	explicit FixedTimestep(double stepMs = 1000.0 / 60.0, int maxSteps = 5);
+
+	// restarts from now with an empty accumulator
+	void reset();
+
+	int advance();
+	int advanceBy(double elapsedMs);
+
+	float getStepMs() const { return float(m_StepMs); }
+	// 0..1, how far the frame is past the last simulated step
+	float getAlpha() const { return float(m_Accumulator / m_StepMs); }
+	uint64_t getStepCount() const { return m_Steps; }
+	// steps given up because of the catch-up limit
+	uint64_t getDroppedSteps() const { return m_Dropped; }
+private:
+	double m_StepMs;
+	int m_MaxSteps;
+	int64_t m_Last;			// ns, -1 before the first advance()
+	double m_Accumulator;	// ms
+	uint64_t m_Steps;
+	uint64_t m_Dropped;
+};
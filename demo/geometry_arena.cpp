@@ -0,0 +1,289 @@
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include "logger.h"
+#include "heap.h"
+#include "mesh.h"
+#include "vertex_packing.h"
+#include "pipeline.h"
+#include "gpu_utils.h"
+#include "frame_scheduler.h"
+#include "geometry_arena.h"
+
+void RangeAllocator::reset(uint32_t capacity)
+{
+	m_Ranges.clear();
+	if (capacity)
+	{
+		m_Ranges[0] = capacity;
+	}
+	m_Free = capacity;
+}
+
+uint32_t RangeAllocator::alloc(uint32_t size)
+{
+	if (size == 0)
+	{
+		return INVALID;
+	}
+
+	for (auto it = m_Ranges.begin(); it != m_Ranges.end(); ++it)
+	{
+		if (it->second < size) continue;
+
+		const uint32_t offset = it->first;
+		const uint32_t rest = it->second - size;
+		m_Ranges.erase(it);
+		if (rest)
+		{
+			m_Ranges[offset + size] = rest;
+		}
+		m_Free -= size;
+
+		return offset;
+	}
+
+	return INVALID;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	auto it = m_Ranges.emplace(offset, size).first;
+	m_Free += size;
+
+	auto next = std::next(it);
+	if (next != m_Ranges.end() && it->first + it->second == next->first)
+	{
+		it->second += next->second;
+		m_Ranges.erase(next);
+	}
+
+	if (it != m_Ranges.begin())
+	{
+		auto prev = std::prev(it);
+		if (prev->first + prev->second == it->first)
+		{
+			prev->second += it->second;
+			m_Ranges.erase(it);
+		}
+	}
+}
+
+bool GeometryArena::create(uint32_t maxVerts, uint32_t maxIndices, uint32_t maxDraws)
+{
+	if (isCreated())
+	{
+		return false;
+	}
+
+	if (!m_VertexBuf.create(maxVerts * sizeof(packedVertex_t), eGpuBufferUsage::DYNAMIC, 0)
+		|| !m_IndexBuf.create(maxIndices * sizeof(uint32_t), eGpuBufferUsage::DYNAMIC, 0))
+	{
+		Error("GeometryArena: cannot allocate %u vertices, %u indices", maxVerts, maxIndices);
+		return false;
+	}
+
+	// identity stream, draw i reads element baseInstance = i
+	std::vector<uint32_t> drawIds(maxDraws);
+	for (uint32_t i = 0; i < maxDraws; ++i) drawIds[i] = i;
+
+	m_DrawIdBuf.create(maxDraws * sizeof(uint32_t), eGpuBufferUsage::STATIC, 0);
+	m_DrawIdBuf.update(0, maxDraws * sizeof(uint32_t), drawIds.data());
+
+	const unsigned int stride = sizeof(packedVertex_t);
+	m_Layout
+		.begin()
+		.with(PACKED_VERTEX_LOC_POSITION, 3, eDataType::FLOAT, false, offsetof(packedVertex_t, position), stride, &m_VertexBuf)
+		.with(PACKED_VERTEX_LOC_QTANGENT, 4, eDataType::SHORT, true, offsetof(packedVertex_t, qtangent), stride, &m_VertexBuf)
+		.with(PACKED_VERTEX_LOC_ST, 2, eDataType::HALF_FLOAT, false, offsetof(packedVertex_t, st), stride, &m_VertexBuf)
+		.with(PACKED_VERTEX_LOC_COLOR, 4, eDataType::UNSIGNED_BYTE, true, offsetof(packedVertex_t, color), stride, &m_VertexBuf)
+		.withInstanced(ARENA_DRAW_ID_LOC, 1, eDataType::UNSIGNED_INT32, sizeof(uint32_t), 1, &m_DrawIdBuf);
+	m_IndexBuf.bind();
+	m_Layout.end();
+
+	m_VertexAlloc.reset(maxVerts);
+	m_IndexAlloc.reset(maxIndices);
+	m_MaxDraws = maxDraws;
+
+	Info("GeometryArena: %u vertices, %u indices, %u draws", maxVerts, maxIndices, maxDraws);
+
+	return true;
+}
+
+bool GeometryArena::add(const Mesh3D& mesh, geometryRange_t& range)
+{
+	range = {};
+
+	if (!isCreated() || !mesh.getNumIndex() || mesh.getDrawMode() != eDrawMode::TRIANGLES)
+	{
+		return false;
+	}
+
+	packedVertex_t* stream = nullptr;
+	const int numVerts = Vertex_BuildPackedStream(mesh, &stream);
+	if (!numVerts)
+	{
+		return false;
+	}
+
+	const uint32_t numIndex = mesh.getNumIndex();
+	const uint32_t baseVertex = m_VertexAlloc.alloc(uint32_t(numVerts));
+	const uint32_t firstIndex = m_IndexAlloc.alloc(numIndex);
+
+	if (baseVertex == RangeAllocator::INVALID || firstIndex == RangeAllocator::INVALID)
+	{
+		Warning("GeometryArena: out of space for %d vertices, %u indices", numVerts, numIndex);
+		if (baseVertex != RangeAllocator::INVALID) m_VertexAlloc.free(baseVertex, uint32_t(numVerts));
+		if (firstIndex != RangeAllocator::INVALID) m_IndexAlloc.free(firstIndex, numIndex);
+		Mem_Free16(stream);
+		return false;
+	}
+
+	m_VertexBuf.update(baseVertex * sizeof(packedVertex_t), numVerts * sizeof(packedVertex_t), stream);
+	Mem_Free16(stream);
+
+	if (mesh.getIndexType() == eDataType::UNSIGNED_SHORT)
+	{
+		const uint16_t* src = static_cast<const uint16_t*>(mesh.getIndices());
+		std::vector<uint32_t> indices(src, src + numIndex);
+		m_IndexBuf.update(firstIndex * sizeof(uint32_t), numIndex * sizeof(uint32_t), indices.data());
+	}
+	else
+	{
+		m_IndexBuf.update(firstIndex * sizeof(uint32_t), numIndex * sizeof(uint32_t), mesh.getIndices());
+	}
+
+	range.baseVertex = baseVertex;
+	range.numVerts = uint32_t(numVerts);
+	range.firstIndex = firstIndex;
+	range.numIndex = numIndex;
+
+	return true;
+}
+
+void GeometryArena::remove(const geometryRange_t& range)
+{
+	m_VertexAlloc.free(range.baseVertex, range.numVerts);
+	m_IndexAlloc.free(range.firstIndex, range.numIndex);
+}
+
+bool IndirectDrawList::create(uint32_t maxDraws)
+{
+	if (!m_CommandRing.create(maxDraws * sizeof(drawElementsIndirectCommand_t))
+		|| !m_DrawDataRing.create(maxDraws * sizeof(glm::mat4)))
+	{
+		return false;
+	}
+
+	m_MaxDraws = maxDraws;
+	m_Draws.reserve(maxDraws);
+	m_Worlds.reserve(maxDraws);
+
+	return true;
+}
+
+void IndirectDrawList::clear()
+{
+	m_Draws.clear();
+	m_Worlds.clear();
+}
+
+bool IndirectDrawList::add(uint64_t stateBits, const geometryRange_t& range, uint32_t firstIndex, uint32_t numIndex, const glm::mat4& world)
+{
+	if (m_Draws.size() >= m_MaxDraws)
+	{
+		return false;
+	}
+
+	draw_t d;
+	d.stateBits = stateBits;
+	d.cmd.count = numIndex;
+	d.cmd.instanceCount = 1;
+	d.cmd.firstIndex = range.firstIndex + firstIndex;
+	d.cmd.baseVertex = int32_t(range.baseVertex);
+	d.cmd.baseInstance = 0;
+	d.world = uint32_t(m_Worlds.size());
+
+	m_Worlds.push_back(world);
+	m_Draws.push_back(d);
+
+	return true;
+}
+
+int IndirectDrawList::submit(Pipeline& p, const GeometryArena& arena)
+{
+	if (m_Draws.empty())
+	{
+		return 0;
+	}
+
+	// the slot's fence was waited on by g_frameScheduler, its region is free again
+	if (m_FrameIndex != g_frameScheduler.getFrameIndex())
+	{
+		m_FrameIndex = g_frameScheduler.getFrameIndex();
+		m_CommandRing.beginFrame();
+		m_DrawDataRing.beginFrame();
+	}
+
+	// the draw id stream only has arena.getMaxDraws() entries, baseInstance cannot go past it
+	const uint32_t available = (m_CommandRing.getFrameSize() - m_CommandRing.getFrameUsed()) / uint32_t(sizeof(drawElementsIndirectCommand_t));
+	const uint32_t numDraws = std::min({ uint32_t(m_Draws.size()), arena.getMaxDraws(), available });
+
+	if (numDraws < m_Draws.size() && m_Dropped == 0)
+	{
+		Warning("IndirectDrawList: %u of %u draws dropped, arena takes %u, %u left this frame",
+			uint32_t(m_Draws.size()) - numDraws, uint32_t(m_Draws.size()), arena.getMaxDraws(), available);
+	}
+	m_Dropped = uint32_t(m_Draws.size()) - numDraws;
+
+	if (numDraws == 0)
+	{
+		return 0;
+	}
+
+	uint32_t commandOffset, drawDataOffset;
+	drawElementsIndirectCommand_t* commands = reinterpret_cast<drawElementsIndirectCommand_t*>(m_CommandRing.alloc(numDraws * sizeof(drawElementsIndirectCommand_t), commandOffset));
+	glm::mat4* drawData = reinterpret_cast<glm::mat4*>(m_DrawDataRing.alloc(numDraws * sizeof(glm::mat4), drawDataOffset));
+
+	if (!commands || !drawData)
+	{
+		m_Dropped = uint32_t(m_Draws.size());
+		return 0;
+	}
+
+	// stable, so draws inside a bucket keep the order they were recorded in
+	std::stable_sort(m_Draws.begin(), m_Draws.begin() + numDraws, [](const draw_t& a, const draw_t& b) { return a.stateBits < b.stateBits; });
+
+	// baseInstance indexes the draw id stream, the draw data binding starts at this submit's matrices
+	for (uint32_t i = 0; i < numDraws; ++i)
+	{
+		commands[i] = m_Draws[i].cmd;
+		commands[i].baseInstance = i;
+		drawData[i] = m_Worlds[m_Draws[i].world];
+	}
+
+	p.bindVertexArray(&arena.getLayout());
+	m_CommandRing.getBuffer().bind();
+	m_DrawDataRing.bindIndexed(ARENA_DRAW_DATA_BINDING, drawDataOffset, numDraws * sizeof(glm::mat4));
+
+	int calls = 0;
+	uint32_t first = 0;
+	while (first < numDraws)
+	{
+		uint32_t last = first + 1;
+		while (last < numDraws && m_Draws[last].stateBits == m_Draws[first].stateBits) ++last;
+
+		p.setState(m_Draws[first].stateBits, false);
+		p.multiDrawElementsIndirect(eDrawMode::TRIANGLES, eDataType::UNSIGNED_INT32, commandOffset + first * sizeof(drawElementsIndirectCommand_t), last - first);
+		++calls;
+
+		first = last;
+	}
+
+	return calls;
+}
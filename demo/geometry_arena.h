@@ -0,0 +1,137 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <cinttypes>
+#include <glm/glm.hpp>
+#include "gpu_types.h"
+#include "gpu_buffer.h"
+#include "gpu_vertex_layout.h"
+#include "gpu_ring_buffer.h"
+
+class Mesh3D;
+class Pipeline;
+
+#define ARENA_DRAW_ID_LOC			4	// va_drawId, see draw_indirect.inc.glsl
+#define ARENA_DRAW_DATA_BINDING		0	// shader storage binding of the per draw world matrices
+
+// first fit allocator over [0, capacity) in abstract units, adjacent free ranges are merged
+class RangeAllocator
+{
+public:
+	static const uint32_t INVALID = ~0u;
+
+	void reset(uint32_t capacity);
+	uint32_t alloc(uint32_t size);
+	void free(uint32_t offset, uint32_t size);
+	uint32_t getFree() const { return m_Free; }
+private:
+	std::map<uint32_t, uint32_t> m_Ranges;		// offset -> size of the free ranges
+	uint32_t m_Free{};
+};
+
+// where a mesh lives inside the arena
+struct geometryRange_t
+{
+	uint32_t baseVertex;
+	uint32_t numVerts;
+	uint32_t firstIndex;
+	uint32_t numIndex;
+};
+
+/*
+Shared vertex and index storage for many meshes, all drawn through a
+single VAO. Vertices are packedVertex_t (see vertex_packing.h), indices
+are 32 bit and relative to the mesh's baseVertex, so a mesh is just a
+geometryRange_t and any number of them can go into one indirect draw.
+*/
+class GeometryArena
+{
+public:
+	GeometryArena() :
+		m_VertexBuf(eGpuBufferTarget::VERTEX),
+		m_IndexBuf(eGpuBufferTarget::INDEX),
+		m_DrawIdBuf(eGpuBufferTarget::VERTEX),
+		m_MaxDraws() {}
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	/*
+	maxDraws: upper limit of the draws in one IndirectDrawList::submit,
+	the size of the draw id stream
+	*/
+	bool create(uint32_t maxVerts, uint32_t maxIndices, uint32_t maxDraws);
+
+	// packs and uploads the mesh, index ranges of its LODs stay relative to range.firstIndex
+	bool add(const Mesh3D& mesh, geometryRange_t& range);
+	void remove(const geometryRange_t& range);
+
+	const VertexLayout& getLayout() const { return m_Layout; }
+	bool isCreated() const { return m_VertexBuf.isCreated(); }
+	uint32_t getMaxDraws() const { return m_MaxDraws; }
+	uint32_t getFreeVerts() const { return m_VertexAlloc.getFree(); }
+	uint32_t getFreeIndices() const { return m_IndexAlloc.getFree(); }
+private:
+	GpuBuffer m_VertexBuf;
+	GpuBuffer m_IndexBuf;
+	GpuBuffer m_DrawIdBuf;
+	VertexLayout m_Layout;
+
+	RangeAllocator m_VertexAlloc;
+	RangeAllocator m_IndexAlloc;
+	uint32_t m_MaxDraws;
+};
+
+/*
+Draws recorded during a frame, grouped into buckets of equal GLS_* state
+bits. submit() writes the commands and world matrices into the current
+g_frameScheduler slot of two persistently mapped rings and issues one
+glMultiDrawElementsIndirect per bucket, no buffer is respecified. The
+draw index reaches the shader through baseInstance and the
+ARENA_DRAW_ID_LOC instanced attribute.
+The caller binds the program; every bucket is drawn with it.
+*/
+class IndirectDrawList
+{
+public:
+	IndirectDrawList() :
+		m_CommandRing(eGpuBufferTarget::INDIRECT),
+		m_DrawDataRing(eGpuBufferTarget::STORAGE),
+		m_MaxDraws(),
+		m_Dropped(),
+		m_FrameIndex(~uint64_t(0)) {}
+
+	// maxDraws per frame over all submits, needs an initialized g_frameScheduler
+	bool create(uint32_t maxDraws);
+
+	void clear();
+	// firstIndex and numIndex relative to range, e.g. a LOD of the mesh; false when the list is full
+	bool add(uint64_t stateBits, const geometryRange_t& range, uint32_t firstIndex, uint32_t numIndex, const glm::mat4& world);
+
+	/*
+	Returns the number of multi-draw calls issued. Draws past the arena's
+	maxDraws or past the space left in this frame's ring region are not
+	drawn, getDropped() counts them and a warning is logged when dropping starts.
+	*/
+	int submit(Pipeline& p, const GeometryArena& arena);
+
+	size_t getNumDraws() const { return m_Draws.size(); }
+	// draws left out by the last submit()
+	uint32_t getDropped() const { return m_Dropped; }
+private:
+	struct draw_t
+	{
+		uint64_t stateBits;
+		drawElementsIndirectCommand_t cmd;
+		uint32_t world;			// index into m_Worlds
+	};
+
+	GpuRingBuffer m_CommandRing;
+	GpuRingBuffer m_DrawDataRing;
+
+	std::vector<draw_t> m_Draws;
+	std::vector<glm::mat4> m_Worlds;
+	uint32_t m_MaxDraws;
+	uint32_t m_Dropped;
+	uint64_t m_FrameIndex;		// scheduler frame the rings were last advanced for
+};
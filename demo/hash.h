@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+
+/*
+64 bit FNV-1a. Stable across runs and platforms, meant for cache keys
+that end up on disk, not for hash tables on hot paths.
+*/
+
+#define HASH_FNV1A_SEED		0xCBF29CE484222325ull
+#define HASH_FNV1A_PRIME	0x00000100000001B3ull
+
+inline uint64_t Hash_Fnv1a(const void* data, size_t size, uint64_t h = HASH_FNV1A_SEED)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		h = (h ^ p[i]) * HASH_FNV1A_PRIME;
+	}
+
+	return h;
+}
+
+inline uint64_t Hash_Fnv1a(const char* str, uint64_t h = HASH_FNV1A_SEED)
+{
+	return Hash_Fnv1a(str, strlen(str), h);
+}
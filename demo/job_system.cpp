@@ -0,0 +1,256 @@
+#include <algorithm>
+#include "logger.h"
+#include "profiler.h"
+#include "job_system.h"
+
+JobSystem g_jobSystem;
+
+// queue index of the current thread, -1 outside the pool
+static thread_local int t_workerIndex = -1;
+
+JobSystem::~JobSystem()
+{
+	shutdown();
+}
+
+bool JobSystem::init(int numThreads)
+{
+	if (m_bRunning)
+	{
+		return false;
+	}
+
+	if (numThreads <= 0)
+	{
+		numThreads = std::max(1, int(std::thread::hardware_concurrency()));
+	}
+
+	m_Queues.clear();
+	for (int i = 0; i < numThreads; ++i)
+	{
+		m_Queues.emplace_back(new queue_t);
+	}
+
+	m_bRunning = true;
+	t_workerIndex = 0;
+
+	for (int i = 1; i < numThreads; ++i)
+	{
+		m_Threads.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+
+	Info("JobSystem: %d threads", numThreads);
+
+	return true;
+}
+
+void JobSystem::shutdown()
+{
+	if (!m_bRunning)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(m_SleepLock);
+		m_bRunning = false;
+	}
+	m_WakeUp.notify_all();
+
+	for (std::thread& t : m_Threads)
+	{
+		t.join();
+	}
+	m_Threads.clear();
+
+	// whatever is left runs on the caller, counters must still reach zero
+	job_t job;
+	while (pop(0, job))
+	{
+		execute(job);
+	}
+
+	m_Queues.clear();
+	t_workerIndex = -1;
+}
+
+void JobSystem::push(job_t&& job)
+{
+	if (m_Queues.empty())
+	{
+		execute(job);
+		return;
+	}
+
+	// own queue for workers, round robin for outside threads
+	static std::atomic<uint32_t> s_next{ 0 };
+	const int q = t_workerIndex >= 0 ? t_workerIndex : int(s_next++ % m_Queues.size());
+
+	{
+		std::lock_guard<std::mutex> lk(m_Queues[q]->lock);
+		m_Queues[q]->jobs.push_back(std::move(job));
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(m_SleepLock);
+		++m_Pending;
+	}
+	m_WakeUp.notify_one();
+}
+
+bool JobSystem::pop(int worker, job_t& job)
+{
+	const int n = int(m_Queues.size());
+	if (n == 0)
+	{
+		return false;
+	}
+
+	// own queue first, newest job: its data is likely still in cache
+	{
+		queue_t& q = *m_Queues[worker];
+		std::lock_guard<std::mutex> lk(q.lock);
+		if (!q.jobs.empty())
+		{
+			job = std::move(q.jobs.back());
+			q.jobs.pop_back();
+			--m_Pending;
+			return true;
+		}
+	}
+
+	// steal the oldest job of another worker
+	for (int i = 1; i < n; ++i)
+	{
+		queue_t& q = *m_Queues[(worker + i) % n];
+		std::lock_guard<std::mutex> lk(q.lock);
+		if (!q.jobs.empty())
+		{
+			job = std::move(q.jobs.front());
+			q.jobs.pop_front();
+			--m_Pending;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::execute(job_t& job)
+{
+	{
+		PROFILE_SCOPE("Job");
+		job.func();
+	}
+
+	JobCounter* c = job.signal;
+	if (c)
+	{
+		// a waiter may destroy the counter as soon as it sees zero, which
+		// it can only do after this lock is released: c is not touched later
+		std::vector<job_t> released;
+		{
+			std::lock_guard<std::mutex> lk(c->m_Lock);
+			if (c->m_Count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				released.swap(c->m_Waiting);
+			}
+		}
+
+		for (job_t& r : released)
+		{
+			push(std::move(r));
+		}
+	}
+}
+
+void JobSystem::workerLoop(int worker)
+{
+	t_workerIndex = worker;
+
+	const std::string name = "Worker " + std::to_string(worker);
+	g_profiler.setThreadName(name.c_str());
+
+	job_t job;
+	while (true)
+	{
+		if (pop(worker, job))
+		{
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lk(m_SleepLock);
+		m_WakeUp.wait(lk, [this] { return !m_bRunning || m_Pending > 0; });
+
+		if (!m_bRunning)
+		{
+			break;
+		}
+	}
+}
+
+void JobSystem::run(std::function<void()> func, JobCounter* signal, JobCounter* dependsOn)
+{
+	if (signal)
+	{
+		signal->m_Count.fetch_add(1, std::memory_order_acq_rel);
+	}
+
+	job_t job{ std::move(func), signal };
+
+	if (dependsOn)
+	{
+		std::lock_guard<std::mutex> lk(dependsOn->m_Lock);
+		if (dependsOn->m_Count.load(std::memory_order_acquire) != 0)
+		{
+			dependsOn->m_Waiting.push_back(std::move(job));
+			return;
+		}
+	}
+
+	push(std::move(job));
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	const int worker = t_workerIndex >= 0 ? t_workerIndex : 0;
+
+	job_t job;
+	while (!counter.isDone())
+	{
+		if (pop(worker, job))
+		{
+			execute(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& func)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	grain = std::max(grain, 1u);
+
+	if (m_Queues.size() < 2 || count <= grain)
+	{
+		func(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	for (uint32_t begin = 0; begin < count; begin += grain)
+	{
+		const uint32_t end = std::min(begin + grain, count);
+		run([&func, begin, end] { func(begin, end); }, &counter);
+	}
+
+	wait(counter);
+}
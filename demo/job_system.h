@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cinttypes>
+
+/*
+Counts unfinished jobs. Jobs added with a dependency on a counter are
+held back until the counter drops to zero, wait() runs other jobs while
+it is not.
+*/
+class JobCounter
+{
+	friend class JobSystem;
+public:
+	JobCounter() : m_Count(0) {}
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	// under m_Lock: zero is only seen once the last job let go of the counter
+	bool isDone() const
+	{
+		std::lock_guard<std::mutex> lk(m_Lock);
+		return m_Count.load(std::memory_order_relaxed) == 0;
+	}
+private:
+	struct job_t
+	{
+		std::function<void()> func;
+		JobCounter* signal;
+	};
+
+	std::atomic<int> m_Count;
+	mutable std::mutex m_Lock;
+	std::vector<job_t> m_Waiting;	// released when m_Count reaches zero
+};
+
+/*
+Work stealing job pool. Every worker, the thread calling init() included,
+owns a deque: it pushes and pops at the back, idle workers steal from the
+front of the others. Deques are short mutex protected sections, jobs are
+expected to be coarse (a mesh, a texture, a few thousand elements).
+*/
+class JobSystem
+{
+public:
+	JobSystem() : m_bRunning(false), m_Pending(0) {}
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// numThreads counts the calling thread, 0 = hardware concurrency
+	bool init(int numThreads = 0);
+	void shutdown();
+
+	/*
+	Queues func. signal (optional) is incremented now and decremented when
+	func returns; dependsOn (optional) holds the job back until it is done.
+	*/
+	void run(std::function<void()> func, JobCounter* signal = nullptr, JobCounter* dependsOn = nullptr);
+
+	// runs queued jobs on the calling thread until counter is done
+	void wait(JobCounter& counter);
+
+	/*
+	Calls func(begin, end) over [0, count) in chunks of at most grain items
+	spread across all workers, returns when every chunk finished.
+	Without workers it runs inline.
+	*/
+	void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& func);
+
+	int getNumThreads() const { return int(m_Queues.size()); }
+private:
+	using job_t = JobCounter::job_t;
+
+	struct queue_t
+	{
+		std::mutex lock;
+		std::deque<job_t> jobs;
+	};
+
+	void push(job_t&& job);
+	bool pop(int worker, job_t& job);
+	void execute(job_t& job);
+	void workerLoop(int worker);
+
+	std::vector<std::unique_ptr<queue_t>> m_Queues;
+	std::vector<std::thread> m_Threads;
+
+	std::atomic<bool> m_bRunning;
+	std::atomic<int> m_Pending;		// queued, not yet started
+	std::mutex m_SleepLock;
+	std::condition_variable m_WakeUp;
+};
+
+extern JobSystem g_jobSystem;
@@ -1,21 +1,34 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <ctime>
 #include <cstring>
 #include <cstdarg>
 #include <cstdio>
+#include <cstdlib>
 #include <time.h>
 
 #include "SDL.h"
+
+#define JSE_LOGGER_IMPLEMENTATION
 #include "logger.h"
 
-static LogWriter gLogWriter("demo.log");
+#define LOG_RING_SIZE		2048		// records, power of two
+#define LOG_INLINE_SIZE		240			// longer messages go to the heap
+#define LOG_IDLE_WAIT_MS	10
+#define LOG_FULL_RETRIES	64
+
+static const char* LOG_LEVEL_TAGS[] = { "[DEBUG] ", "[INFO] ", "[WARN] ", "[ERROR] ", "[FATAL] " };
 
 void LogWriter::Write(const std::string& msg)
 {
 	if (!file) ReopenFile();
 	if (file)
 	{
-		fprintf(file, "%s\n", msg.c_str());
-		fprintf(stderr, "%s\n", msg.c_str());
+		fwrite(msg.data(), 1, msg.size(), file);
+		fwrite(msg.data(), 1, msg.size(), stderr);
 		fflush(file);
 	}
 }
@@ -59,61 +72,337 @@ void LogWriter::SetFileName(const std::string& fileName_)
 	if (file) ReopenFile();
 }
 
-static std::string jse_get_time()
+/*
+Bounded MPSC ring (Vyukov's sequence numbers): a producer claims a slot
+with one CAS on head, formats into it and publishes it by bumping the
+slot's sequence. The logger thread is the only consumer.
+*/
+struct logRecord_t
+{
+	std::atomic<uint32_t> sequence;
+	int level;
+	time_t time;
+	std::string* overflow;
+	char text[LOG_INLINE_SIZE];
+};
+
+class AsyncLog
 {
-	char text[100];
+public:
+	AsyncLog();
+
+	void write(int level, const char* fmt, va_list ap);
+	void flush();
+	void shutdown();
+
+	std::atomic<int> level;
+private:
+	void run();
+	// appends every published record to batch, false when there was none
+	bool drain(std::string& batch);
+	void appendTime(time_t t, std::string& batch);
+
+	logRecord_t m_Ring[LOG_RING_SIZE];
+	alignas(64) std::atomic<uint32_t> m_Head;
+	alignas(64) std::atomic<uint32_t> m_Consumed;
+	uint32_t m_Tail;
+	std::atomic<uint32_t> m_Dropped;
+
+	std::thread m_Thread;
+	std::mutex m_Lock;
+	std::condition_variable m_Wake;
+	std::condition_variable m_Flushed;
+	std::atomic<bool> m_bQuit;
+	std::atomic<bool> m_bStopped;
 
-	time_t now = time(NULL);
-	struct tm my_time;
-	localtime_s(&my_time, &now);
-	strftime(text, 100, "[%Y-%m-%d %H:%M:%S]", &my_time);
+	LogWriter m_Writer;
+	time_t m_LastTime;
+	char m_TimeText[32];
+};
 
-	return std::string(text);
+AsyncLog::AsyncLog() : level(LOG_LEVEL_DEBUG), m_Head(0), m_Consumed(0), m_Tail(0), m_Dropped(0), m_bQuit(false), m_bStopped(false), m_Writer("demo.log"), m_LastTime(-1)
+{
+	for (uint32_t i = 0; i < LOG_RING_SIZE; ++i)
+	{
+		m_Ring[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	m_Thread = std::thread(&AsyncLog::run, this);
 }
 
-void Info(const char* fmt, ...)
+void AsyncLog::write(int lvl, const char* fmt, va_list ap)
 {
-	char text[2048];
-	va_list ap;
+	if (m_bStopped.load(std::memory_order_acquire))
+	{
+		// after shutdown (static destructors) write through, unbatched
+		char text[2048];
+		vsnprintf(text, sizeof(text), fmt, ap);
+		std::lock_guard<std::mutex> lk(m_Lock);
+		std::string line;
+		appendTime(time(nullptr), line);
+		line += LOG_LEVEL_TAGS[lvl];
+		line += text;
+		line += '\n';
+		m_Writer.Write(line);
+		return;
+	}
 
-	if (fmt == NULL)
+	uint32_t pos = m_Head.load(std::memory_order_relaxed);
+	logRecord_t* rec;
+	int retries = 0;
+
+	for (;;)
+	{
+		rec = &m_Ring[pos & (LOG_RING_SIZE - 1)];
+		const int32_t diff = int32_t(rec->sequence.load(std::memory_order_acquire) - pos);
+
+		if (diff == 0)
+		{
+			if (m_Head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+		}
+		else if (diff < 0)
+		{
+			// the consumer is a whole ring behind, give it a chance before dropping
+			if (++retries > LOG_FULL_RETRIES)
+			{
+				m_Dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			m_Wake.notify_one();
+			std::this_thread::yield();
+			pos = m_Head.load(std::memory_order_relaxed);
+		}
+		else
+		{
+			pos = m_Head.load(std::memory_order_relaxed);
+		}
+	}
+
+	rec->level = lvl;
+	rec->time = time(nullptr);
+	rec->overflow = nullptr;
+
+	va_list ap2;
+	va_copy(ap2, ap);
+	const int len = vsnprintf(rec->text, LOG_INLINE_SIZE, fmt, ap);
+	if (len >= LOG_INLINE_SIZE)
+	{
+		rec->overflow = new std::string(size_t(len) + 1, '\0');
+		vsnprintf(&(*rec->overflow)[0], size_t(len) + 1, fmt, ap2);
+		rec->overflow->resize(size_t(len));
+	}
+	va_end(ap2);
+
+	rec->sequence.store(pos + 1, std::memory_order_release);
+
+	// the thread polls anyway, wake it early for what should show up right away
+	if (lvl >= LOG_LEVEL_WARNING || pos - m_Consumed.load(std::memory_order_relaxed) > LOG_RING_SIZE / 2)
+	{
+		m_Wake.notify_one();
+	}
+}
+
+void AsyncLog::appendTime(time_t t, std::string& batch)
+{
+	if (t != m_LastTime)
+	{
+		struct tm my_time;
+#ifdef _WIN32
+		localtime_s(&my_time, &t);
+#else
+		localtime_r(&t, &my_time);
+#endif
+		strftime(m_TimeText, sizeof(m_TimeText), "[%Y-%m-%d %H:%M:%S]", &my_time);
+		m_LastTime = t;
+	}
+
+	batch += m_TimeText;
+}
+
+bool AsyncLog::drain(std::string& batch)
+{
+	bool any = false;
+
+	for (;;)
+	{
+		logRecord_t& rec = m_Ring[m_Tail & (LOG_RING_SIZE - 1)];
+		if (rec.sequence.load(std::memory_order_acquire) != m_Tail + 1)
+		{
+			break;
+		}
+
+		appendTime(rec.time, batch);
+		batch += LOG_LEVEL_TAGS[rec.level];
+		if (rec.overflow)
+		{
+			batch += *rec.overflow;
+			delete rec.overflow;
+		}
+		else
+		{
+			batch += rec.text;
+		}
+		batch += '\n';
+
+		rec.sequence.store(m_Tail + LOG_RING_SIZE, std::memory_order_release);
+		++m_Tail;
+		any = true;
+	}
+
+	const uint32_t dropped = m_Dropped.exchange(0, std::memory_order_relaxed);
+	if (dropped)
+	{
+		appendTime(time(nullptr), batch);
+		batch += LOG_LEVEL_TAGS[LOG_LEVEL_WARNING];
+		batch += std::to_string(dropped) + " log records dropped, the ring was full\n";
+	}
+
+	return any;
+}
+
+void AsyncLog::run()
+{
+	std::string batch;
+	batch.reserve(64 * 1024);
+
+	for (;;)
+	{
+		const bool quit = m_bQuit.load(std::memory_order_acquire);
+
+		drain(batch);
+
+		std::unique_lock<std::mutex> lk(m_Lock);
+
+		if (!batch.empty())
+		{
+			m_Writer.Write(batch);
+			batch.clear();
+		}
+
+		m_Consumed.store(m_Tail, std::memory_order_release);
+		m_Flushed.notify_all();
+
+		if (quit)
+		{
+			break;
+		}
+
+		m_Wake.wait_for(lk, std::chrono::milliseconds(LOG_IDLE_WAIT_MS));
+	}
+}
+
+void AsyncLog::flush()
+{
+	if (m_bStopped.load(std::memory_order_acquire))
+	{
 		return;
+	}
 
-	va_start(ap, fmt);
-	vsnprintf(text, 2048, fmt, ap);
-	va_end(ap);
+	const uint32_t target = m_Head.load(std::memory_order_acquire);
 
-	gLogWriter.Write(jse_get_time() + "[INFO] " + std::string(text));
+	std::unique_lock<std::mutex> lk(m_Lock);
+	m_Wake.notify_one();
+	m_Flushed.wait(lk, [&] { return int32_t(m_Consumed.load(std::memory_order_acquire) - target) >= 0; });
 }
 
-void Warning(const char* fmt, ...)
+void AsyncLog::shutdown()
 {
-	char text[2048];
-	va_list ap;
+	if (m_bQuit.exchange(true))
+	{
+		return;
+	}
 
-	if (fmt == NULL)
+	m_Wake.notify_one();
+	m_Thread.join();
+
+	m_bStopped.store(true, std::memory_order_release);
+
+	// whatever raced with the thread's last pass
+	std::string batch;
+	drain(batch);
+	if (!batch.empty())
+	{
+		m_Writer.Write(batch);
+	}
+}
+
+// never destroyed: static destructors of other files may still log, after
+// the atexit shutdown those calls are written synchronously
+static AsyncLog& Log_Instance()
+{
+	static AsyncLog* instance = []
+	{
+		AsyncLog* log = new AsyncLog();
+		atexit([] { Log_Instance().shutdown(); });
+		return log;
+	}();
+
+	return *instance;
+}
+
+void Log_SetLevel(int level)
+{
+	Log_Instance().level.store(level, std::memory_order_relaxed);
+}
+
+int Log_GetLevel()
+{
+	return Log_Instance().level.load(std::memory_order_relaxed);
+}
+
+void Log_Flush()
+{
+	Log_Instance().flush();
+}
+
+static void Log_Write(int level, const char* fmt, va_list ap)
+{
+	AsyncLog& log = Log_Instance();
+
+	if (fmt == NULL || level < log.level.load(std::memory_order_relaxed))
 		return;
 
+	log.write(level, fmt, ap);
+}
+
+static void Log_Print(int level, const char* fmt, ...)
+{
+	va_list ap;
 	va_start(ap, fmt);
-	vsnprintf(text, 2048, fmt, ap);
+	Log_Write(level, fmt, ap);
 	va_end(ap);
-
-	gLogWriter.Write(jse_get_time() + "[WARN] " + std::string(text));
 }
 
-void Error(const char* fmt, ...)
+void Debug(const char* fmt, ...)
 {
-	char text[2048];
 	va_list ap;
+	va_start(ap, fmt);
+	Log_Write(LOG_LEVEL_DEBUG, fmt, ap);
+	va_end(ap);
+}
 
-	if (fmt == NULL)
-		return;
+void Info(const char* fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	Log_Write(LOG_LEVEL_INFO, fmt, ap);
+	va_end(ap);
+}
 
+void Warning(const char* fmt, ...)
+{
+	va_list ap;
 	va_start(ap, fmt);
-	vsnprintf(text, 2048, fmt, ap);
+	Log_Write(LOG_LEVEL_WARNING, fmt, ap);
 	va_end(ap);
+}
 
-	gLogWriter.Write(jse_get_time() + "[ERROR] " + std::string(text));
+void Error(const char* fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	Log_Write(LOG_LEVEL_ERROR, fmt, ap);
+	va_end(ap);
 }
 
 void FatalError(const char* fmt, ...)
@@ -128,7 +417,8 @@ void FatalError(const char* fmt, ...)
 	vsnprintf(text, 2048, fmt, ap);
 	va_end(ap);
 
-	gLogWriter.Write(jse_get_time() + "[FATAL] " + std::string(text));
+	Log_Print(LOG_LEVEL_FATAL, "%s", text);
+	Log_Flush();
 
 	SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "JSE ERROR", text, NULL);
 	SDL_Quit();
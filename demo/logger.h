@@ -4,6 +4,24 @@
 #include <string>
 #include <cstdio>
 
+#define LOG_LEVEL_DEBUG		0
+#define LOG_LEVEL_INFO		1
+#define LOG_LEVEL_WARNING	2
+#define LOG_LEVEL_ERROR		3
+#define LOG_LEVEL_FATAL		4
+
+// calls below this level are compiled out, Error and FatalError never are
+#ifndef LOG_COMPILE_LEVEL
+#ifdef _DEBUG
+#define LOG_COMPILE_LEVEL	LOG_LEVEL_DEBUG
+#else
+#define LOG_COMPILE_LEVEL	LOG_LEVEL_INFO
+#endif
+#endif
+
+/*
+File and stderr sink, written by the logger thread only.
+*/
 class LogWriter
 {
 public:
@@ -19,9 +37,34 @@ private:
 	std::string fileName;
 };
 
+/*
+The log calls format into a slot of a lock-free ring and return, a
+background thread turns the records into lines and writes them in
+batches. A full ring drops the record and the drop count is logged.
+Messages too long for a slot are carried on the heap.
+*/
+void Debug(const char* fmt, ...);
 void Info(const char* fmt, ...);
 void Warning(const char* fmt, ...);
 void Error(const char* fmt, ...);
 void FatalError(const char* fmt, ...);
 
+// run time filter on top of LOG_COMPILE_LEVEL
+void Log_SetLevel(int level);
+int Log_GetLevel();
+// blocks until every record logged so far is written
+void Log_Flush();
+
+#ifndef JSE_LOGGER_IMPLEMENTATION
+#if LOG_COMPILE_LEVEL > LOG_LEVEL_DEBUG
+#define Debug(...) ((void)0)
+#endif
+#if LOG_COMPILE_LEVEL > LOG_LEVEL_INFO
+#define Info(...) ((void)0)
+#endif
+#if LOG_COMPILE_LEVEL > LOG_LEVEL_WARNING
+#define Warning(...) ((void)0)
+#endif
+#endif
+
 #endif
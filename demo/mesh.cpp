@@ -1,14 +1,93 @@
 #include <string>
 #include <cstring>
+#include <cfloat>
+#include <algorithm>
 #include <tiny_gltf.h>
 #include "logger.h"
 #include "mesh.h"
 #include "heap.h"
-#include "gpu_buffer.h"
-#include "pipeline.h"
+#include "filesystem.h"
+#include "mesh_file.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
 using namespace tinygltf;
 
-bool Mesh3D::loadFromGLTF(const char* filename, int meshIdx, int primitiveIdx)
+static const char* MESH_SEMANTIC_NAMES[MFS_COUNT] = { "POSITION", "NORMAL", "TANGENT", "TEXCOORD_0", "COLOR_0" };
+
+static inline uint32_t alignMeshData(uint32_t x)
+{
+    return (x + (MESH_FILE_ALIGNMENT - 1)) & ~uint32_t(MESH_FILE_ALIGNMENT - 1);
+}
+
+static unsigned int attributeElementSize(const VertexAttribute& va)
+{
+    switch (va.type)
+    {
+    case eDataType::BYTE:
+    case eDataType::UNSIGNED_BYTE:
+        return va.size;
+    case eDataType::SHORT:
+    case eDataType::UNSIGNED_SHORT:
+    case eDataType::HALF_FLOAT:
+        return va.size * 2;
+    default:
+        return va.size * 4;
+    }
+}
+
+static void readIndices(std::vector<uint32_t>& out, const void* indices, eDataType type, unsigned int first, unsigned int count)
+{
+    out.resize(count);
+
+    if (type == eDataType::UNSIGNED_SHORT)
+    {
+        const uint16_t* src = static_cast<const uint16_t*>(indices) + first;
+        for (unsigned int i = 0; i < count; ++i) out[i] = src[i];
+    }
+    else
+    {
+        ::memcpy(out.data(), static_cast<const uint32_t*>(indices) + first, count * sizeof(uint32_t));
+    }
+}
+
+Mesh3D::~Mesh3D()
+{
+    clear();
+}
+
+void Mesh3D::clear()
+{
+    if (m_bOwnsData)
+    {
+        Mem_Free16(m_Positions);
+        Mem_Free16(m_TexCoords);
+        Mem_Free16(m_Normals);
+        Mem_Free16(m_Tangents);
+        Mem_Free16(m_Colors);
+        Mem_Free16(m_Indices);
+    }
+
+    m_Positions = nullptr;
+    m_TexCoords = nullptr;
+    m_Normals = nullptr;
+    m_Tangents = nullptr;
+    m_Colors = nullptr;
+    m_Indices = nullptr;
+
+    m_Position_layout = {};
+    m_TexCoord_layout = {};
+    m_Normal_layout = {};
+    m_Tangent_layout = {};
+    m_Color_layout = {};
+    m_NumIndex = 0;
+    m_Lods.clear();
+    m_Meshlets.clear();
+
+    m_bOwnsData = false;
+    m_Mapping.reset();
+}
+
+bool Mesh3D::loadFromGLTF(const char* filename, int meshIdx, int primitiveIdx, unsigned int importFlags)
 {
 
     Model model;
@@ -40,11 +119,14 @@ bool Mesh3D::loadFromGLTF(const char* filename, int meshIdx, int primitiveIdx)
         return false;
     }    
 
-    return importFromGLTF(model, m.primitives[primitiveIdx]);
+    return importFromGLTF(model, m.primitives[primitiveIdx], importFlags);
 }
 
-bool Mesh3D::importFromGLTF(const tinygltf::Model& model, const tinygltf::Primitive& meshPrimitive)
+bool Mesh3D::importFromGLTF(const tinygltf::Model& model, const tinygltf::Primitive& meshPrimitive, unsigned int importFlags)
 {
+    clear();
+    m_bOwnsData = true;
+
     for (auto p : meshPrimitive.attributes)
     {
         const Accessor& access = model.accessors[p.second];
@@ -54,7 +136,7 @@ bool Mesh3D::importFromGLTF(const tinygltf::Model& model, const tinygltf::Primit
         if (p.first == "POSITION")
         {
             // allocate position memory
-            VertexAttribute attr{ "POSITION", eDataType::FLOAT, 3, access.count, false, 0, 0, 0 };
+            VertexAttribute attr{ "POSITION", eDataType::FLOAT, 3, access.count, false, 0, 0, 0, view.byteLength };
             m_Position_layout = attr;
             m_Positions = Mem_Alloc16(view.byteLength);
             ::memcpy(m_Positions, buffer.data.data() + view.byteOffset + access.byteOffset, view.byteLength);
@@ -187,66 +269,518 @@ bool Mesh3D::importFromGLTF(const tinygltf::Model& model, const tinygltf::Primit
     m_Indices = Mem_Alloc16(view.byteLength);
     ::memcpy(m_Indices, buffer.data.data() + view.byteOffset + access.byteOffset, view.byteLength);
 
+    std::vector<uint32_t> indices;
+    const bool isTriangleList = m_Mode == eDrawMode::TRIANGLES && m_NumIndex && m_Position_layout.count;
+
+    meshCacheStats_t before{};
+    if (isTriangleList)
+    {
+        readIndices(indices, m_Indices, m_IndexType, 0, m_NumIndex);
+        before = MeshOpt_AnalyzeVertexCache(indices.data(), indices.size(), size_t(m_Position_layout.count));
+    }
+
+    if (importFlags & (MIF_OPTIMIZE_VERTEX_CACHE | MIF_OPTIMIZE_OVERDRAW))
+    {
+        optimize(importFlags);
+    }
+
+    buildMeshlets();
+
+    // measured on the final order, meshlet clustering reorders triangles again
+    if (isTriangleList)
+    {
+        readIndices(indices, m_Indices, m_IndexType, 0, m_NumIndex);
+        const meshCacheStats_t after = MeshOpt_AnalyzeVertexCache(indices.data(), indices.size(), size_t(m_Position_layout.count));
+
+        Info("Mesh imported: %u tris, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+            m_NumIndex / 3, before.acmr, after.acmr, before.atvr, after.atvr);
+    }
+
+    return true;
+}
+
+bool Mesh3D::optimize(unsigned int flags)
+{
+    if (!m_bOwnsData || m_Mode != eDrawMode::TRIANGLES || !m_NumIndex || !m_Positions)
+    {
+        return false;
+    }
+
+    if (!m_Lods.empty())
+    {
+        Warning("Mesh3D::optimize: mesh already has LODs, skipped");
+        return false;
+    }
+
+    const size_t numVerts = size_t(m_Position_layout.count);
+
+    VertexAttribute* layouts[] = { &m_Position_layout, &m_Normal_layout, &m_Tangent_layout, &m_TexCoord_layout, &m_Color_layout };
+    void** arrays[] = { &m_Positions, &m_Normals, &m_Tangents, &m_TexCoords, &m_Colors };
+
+    // every array follows the same vertex remap, one of a different length would end up misaligned
+    for (int i = 0; i < 5; ++i)
+    {
+        if (*arrays[i] && size_t(layouts[i]->count) != numVerts)
+        {
+            Error("Mesh3D::optimize: %s has %d elements for %u vertices", layouts[i]->name ? layouts[i]->name : "attribute", layouts[i]->count, unsigned(numVerts));
+            return false;
+        }
+    }
+
+    m_Meshlets.clear();
+
+    std::vector<uint32_t> indices;
+    readIndices(indices, m_Indices, m_IndexType, 0, m_NumIndex);
+
+    MeshOpt_OptimizeVertexCache(indices.data(), indices.size(), numVerts);
+
+    if ((flags & MIF_OPTIMIZE_OVERDRAW) && m_Position_layout.type == eDataType::FLOAT && m_Position_layout.size == 3)
+    {
+        MeshOpt_OptimizeOverdraw(indices.data(), indices.size(), static_cast<const float*>(m_Positions), numVerts, 1.05f);
+    }
+
+    // vertex fetch order, every attribute array follows the same remap
+    std::vector<uint32_t> remap(numVerts);
+    const size_t numUsed = MeshOpt_OptimizeVertexFetch(indices.data(), indices.size(), numVerts, remap.data());
+
+    for (int i = 0; i < 5; ++i)
+    {
+        VertexAttribute& va = *layouts[i];
+        if (!*arrays[i]) continue;
+
+        const unsigned int elementSize = attributeElementSize(va);
+        void* remapped = Mem_Alloc16(numUsed * elementSize);
+        MeshOpt_RemapVertexArray(remapped, *arrays[i], numVerts, elementSize, remap.data());
+        Mem_Free16(*arrays[i]);
+
+        *arrays[i] = remapped;
+        va.count = int(numUsed);
+        va.byteSize = unsigned(numUsed * elementSize);
+    }
+
+    if (m_IndexType == eDataType::UNSIGNED_SHORT)
+    {
+        uint16_t* dst = static_cast<uint16_t*>(m_Indices);
+        for (unsigned int i = 0; i < m_NumIndex; ++i) dst[i] = uint16_t(indices[i]);
+    }
+    else
+    {
+        ::memcpy(m_Indices, indices.data(), m_NumIndex * sizeof(uint32_t));
+    }
+
+    Info("Mesh optimized: %u tris, %u -> %u verts", m_NumIndex / 3, unsigned(numVerts), unsigned(numUsed));
+
+    return true;
+}
+
+bool Mesh3D::generateLods(int numLods, float ratio)
+{
+    if (!m_bOwnsData || m_Mode != eDrawMode::TRIANGLES || !m_NumIndex || !m_Positions || !m_Lods.empty())
+    {
+        return false;
+    }
+
+    if (m_Position_layout.type != eDataType::FLOAT || m_Position_layout.size != 3)
+    {
+        return false;
+    }
+
+    const size_t numVerts = size_t(m_Position_layout.count);
+    const float* positions = static_cast<const float*>(m_Positions);
+
+    // normals and texcoords steer the collapses away from visible attribute changes
+    const size_t numAttribs = 5;
+    const float attribWeights[numAttribs] = { 0.5f, 0.5f, 0.5f, 1.0f, 1.0f };
+    std::vector<float> attribs(numVerts * numAttribs, 0.0f);
+    const bool hasNormals = m_Normals && size_t(m_Normal_layout.count) == numVerts && m_Normal_layout.type == eDataType::FLOAT;
+    const bool hasTexCoords = m_TexCoords && size_t(m_TexCoord_layout.count) == numVerts && m_TexCoord_layout.type == eDataType::FLOAT;
+
+    for (size_t v = 0; v < numVerts; ++v)
+    {
+        if (hasNormals)
+        {
+            const float* n = static_cast<const float*>(m_Normals) + v * 3;
+            attribs[v * numAttribs + 0] = n[0];
+            attribs[v * numAttribs + 1] = n[1];
+            attribs[v * numAttribs + 2] = n[2];
+        }
+        if (hasTexCoords)
+        {
+            const float* st = static_cast<const float*>(m_TexCoords) + v * 2;
+            attribs[v * numAttribs + 3] = st[0];
+            attribs[v * numAttribs + 4] = st[1];
+        }
+    }
+
+    std::vector<uint32_t> all(m_NumIndex);
+    if (m_IndexType == eDataType::UNSIGNED_SHORT)
+    {
+        const uint16_t* src = static_cast<const uint16_t*>(m_Indices);
+        for (unsigned int i = 0; i < m_NumIndex; ++i) all[i] = src[i];
+    }
+    else
+    {
+        ::memcpy(all.data(), m_Indices, m_NumIndex * sizeof(uint32_t));
+    }
+
+    m_Lods.push_back({ 0, m_NumIndex, 0.0f });
+
+    std::vector<uint32_t> lod(m_NumIndex);
+    for (int level = 1; level < numLods; ++level)
+    {
+        const meshLod_t& prev = m_Lods.back();
+        const size_t target = size_t(float(prev.numIndex / 3) * ratio) * 3;
+
+        float error = 0.0f;
+        const size_t count = MeshOpt_Simplify(lod.data(), all.data() + prev.firstIndex, prev.numIndex,
+            positions, numVerts, attribs.data(), numAttribs, attribWeights, target, FLT_MAX, &error);
+
+        // not worth another level
+        if (count == 0 || count > size_t(prev.numIndex) * 9 / 10)
+        {
+            break;
+        }
+
+        MeshOpt_OptimizeVertexCache(lod.data(), count, numVerts);
+
+        // each level is simplified from the previous one, the deviations from LOD 0 add up
+        const meshLod_t next{ unsigned(all.size()), unsigned(count), prev.error + error };
+        all.insert(all.end(), lod.begin(), lod.begin() + count);
+        m_Lods.push_back(next);
+
+        Info("Mesh LOD %d: %u tris, error %f", level, next.numIndex / 3, next.error);
+    }
+
+    if (m_Lods.size() == 1)
+    {
+        m_Lods.clear();
+        return false;
+    }
+
+    const unsigned int indexSize = m_IndexType == eDataType::UNSIGNED_SHORT ? 2 : 4;
+    void* indices = Mem_Alloc16(all.size() * indexSize);
+
+    if (m_IndexType == eDataType::UNSIGNED_SHORT)
+    {
+        uint16_t* dst = static_cast<uint16_t*>(indices);
+        for (size_t i = 0; i < all.size(); ++i) dst[i] = uint16_t(all[i]);
+    }
+    else
+    {
+        ::memcpy(indices, all.data(), all.size() * sizeof(uint32_t));
+    }
+
+    Mem_Free16(m_Indices);
+    m_Indices = indices;
+    m_NumIndex = unsigned(all.size());
+
     return true;
 }
 
-void RenderMesh3D::compile(const Mesh3D& mesh)
+bool Mesh3D::buildMeshlets()
+{
+    if (!m_bOwnsData || m_Mode != eDrawMode::TRIANGLES || !m_NumIndex || !m_Positions)
+    {
+        return false;
+    }
+
+    if (m_Position_layout.type != eDataType::FLOAT || m_Position_layout.size != 3)
+    {
+        return false;
+    }
+
+    m_Meshlets.clear();
+
+    const unsigned int numIndex = m_Lods.empty() ? m_NumIndex : m_Lods[0].numIndex;
+    const unsigned int firstIndex = m_Lods.empty() ? 0 : m_Lods[0].firstIndex;
+
+    std::vector<uint32_t> indices;
+    readIndices(indices, m_Indices, m_IndexType, firstIndex, numIndex);
+
+    // triangles are reordered so every cluster is one contiguous index range
+    std::vector<uint32_t> clustered(numIndex);
+    const size_t numVerts = size_t(m_Position_layout.count);
+    Meshlet_Build(m_Meshlets, clustered.data(), indices.data(), numIndex, firstIndex, static_cast<const float*>(m_Positions), numVerts);
+
+    // clustering scatters the cache order, optimize each cluster again on its own (at most 64 vertices)
+    std::vector<uint32_t> toLocal(numVerts, ~0u);
+    std::vector<uint32_t> toGlobal;
+    std::vector<uint32_t> local;
+    for (const drawRange_t& range : m_Meshlets.ranges)
+    {
+        uint32_t* tris = clustered.data() + (range.firstIndex - firstIndex);
+
+        toGlobal.clear();
+        local.resize(range.numIndex);
+        for (uint32_t i = 0; i < range.numIndex; ++i)
+        {
+            uint32_t& l = toLocal[tris[i]];
+            if (l == ~0u)
+            {
+                l = uint32_t(toGlobal.size());
+                toGlobal.push_back(tris[i]);
+            }
+            local[i] = l;
+        }
+
+        MeshOpt_OptimizeVertexCache(local.data(), local.size(), toGlobal.size());
+
+        for (uint32_t i = 0; i < range.numIndex; ++i) tris[i] = toGlobal[local[i]];
+        for (uint32_t v : toGlobal) toLocal[v] = ~0u;
+    }
+
+    if (m_IndexType == eDataType::UNSIGNED_SHORT)
+    {
+        uint16_t* dst = static_cast<uint16_t*>(m_Indices) + firstIndex;
+        for (unsigned int i = 0; i < numIndex; ++i) dst[i] = uint16_t(clustered[i]);
+    }
+    else
+    {
+        ::memcpy(static_cast<uint32_t*>(m_Indices) + firstIndex, clustered.data(), numIndex * sizeof(uint32_t));
+    }
+
+    Info("Mesh meshlets: %u for %u tris", unsigned(m_Meshlets.size()), numIndex / 3);
+
+    return m_Meshlets.size() > 0;
+}
+
+bool Mesh3D::saveCooked(const char* filename) const
 {
-    if (isCompiled())
-        return;
+    const VertexAttribute* layouts[MFS_COUNT] = { &m_Position_layout, &m_Normal_layout, &m_Tangent_layout, &m_TexCoord_layout, &m_Color_layout };
+    const void* arrays[MFS_COUNT] = { m_Positions, m_Normals, m_Tangents, m_TexCoords, m_Colors };
+
+    const uint32_t indexSize = m_IndexType == eDataType::UNSIGNED_SHORT ? 2 : 4;
+
+    meshFileHeader_t header{};
+    meshFileAttrib_t attribs[MFS_COUNT]{};
+
+    uint32_t numAttribs = 0;
+    for (int i = 0; i < MFS_COUNT; ++i)
+    {
+        if (layouts[i]->count && arrays[i])
+        {
+            ++numAttribs;
+        }
+    }
 
-    int index = 0;
-    m_Layout.begin();
-    if (mesh.getPositionLayout().count)
+    const uint32_t lodOffset = sizeof(header) + numAttribs * sizeof(meshFileAttrib_t);
+    const uint32_t numLods = uint32_t(m_Lods.size());
+    const uint32_t meshletOffset = lodOffset + numLods * sizeof(meshFileLod_t);
+    const uint32_t numMeshlets = uint32_t(m_Meshlets.size());
+    uint32_t offset = alignMeshData(meshletOffset + numMeshlets * sizeof(meshFileMeshlet_t));
+
+    numAttribs = 0;
+    for (int i = 0; i < MFS_COUNT; ++i)
     {
-        const VertexAttribute& va = mesh.getPositionLayout();
-        m_PositionBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getPositions());
-        m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_PositionBuf);
+        const VertexAttribute& va = *layouts[i];
+        if (!va.count || !arrays[i]) continue;
+
+        meshFileAttrib_t& fa = attribs[numAttribs++];
+        fa.semantic = uint32_t(i);
+        fa.type = uint32_t(va.type);
+        fa.size = uint32_t(va.size);
+        fa.count = uint32_t(va.count);
+        fa.normalized = va.normalized ? 1 : 0;
+        fa.offset = offset;
+        fa.byteSize = va.byteSize;
+
+        offset = alignMeshData(offset + va.byteSize);
     }
-    if (mesh.getNormalLayout().count)
+
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.numAttribs = numAttribs;
+    header.drawMode = uint32_t(m_Mode);
+    header.indexType = uint32_t(m_IndexType);
+    header.numIndex = m_NumIndex;
+    header.indexOffset = offset;
+    header.indexByteSize = m_NumIndex * indexSize;
+    header.numLods = numLods;
+    header.lodOffset = lodOffset;
+    header.numMeshlets = numMeshlets;
+    for (int i = 0; i < 3; ++i)
     {
-        const VertexAttribute& va = mesh.getNormalLayout();
-        m_NormalBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getNormals());
-        m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_NormalBuf);
+        header.boundsMin[i] = m_Bounds[0][i];
+        header.boundsMax[i] = m_Bounds[1][i];
     }
-    if (mesh.getTangentLayout().count)
+    header.fileSize = alignMeshData(offset + header.indexByteSize);
+
+    std::vector<uint8_t> blob(header.fileSize, 0);
+    ::memcpy(blob.data(), &header, sizeof(header));
+    ::memcpy(blob.data() + sizeof(header), attribs, numAttribs * sizeof(meshFileAttrib_t));
+
+    for (uint32_t i = 0; i < numLods; ++i)
     {
-        const VertexAttribute& va = mesh.getTangentLayout();
-        m_TangentBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getTangents());
-        m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_TangentBuf);
+        meshFileLod_t lod{};
+        lod.firstIndex = m_Lods[i].firstIndex;
+        lod.numIndex = m_Lods[i].numIndex;
+        lod.error = m_Lods[i].error;
+        ::memcpy(blob.data() + lodOffset + i * sizeof(meshFileLod_t), &lod, sizeof(lod));
     }
-    if (mesh.getTexCoordLayout().count)
+
+    for (uint32_t i = 0; i < numMeshlets; ++i)
     {
-        const VertexAttribute& va = mesh.getTexCoordLayout();
-        m_TexCoordBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getTexCoords());
-        m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_TexCoordBuf);
+        meshFileMeshlet_t ml{};
+        ::memcpy(ml.sphere, &m_Meshlets.spheres[i], sizeof(ml.sphere));
+        ::memcpy(ml.cone, &m_Meshlets.cones[i], sizeof(ml.cone));
+        ml.firstIndex = m_Meshlets.ranges[i].firstIndex;
+        ml.numIndex = m_Meshlets.ranges[i].numIndex;
+        ::memcpy(blob.data() + meshletOffset + i * sizeof(meshFileMeshlet_t), &ml, sizeof(ml));
     }
-    if (mesh.getColorLayout().count)
+
+    for (uint32_t i = 0; i < numAttribs; ++i)
     {
-        const VertexAttribute& va = mesh.getColorLayout();
-        m_ColorBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getColors());
-        m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_ColorBuf);
+        ::memcpy(blob.data() + attribs[i].offset, arrays[attribs[i].semantic], attribs[i].byteSize);
     }
-    m_Layout.end();
 
-    if (mesh.getNumIndex())
+    if (header.indexByteSize)
     {
-        m_IndexBuf.create(mesh.getNumIndex() * (mesh.getIndexType() == eDataType::UNSIGNED_SHORT ? 2 : 4), eGpuBufferUsage::STATIC, 0, mesh.getIndices());
-        m_NumIndex = mesh.getNumIndex();
-        m_IndexType = mesh.getIndexType();
+        ::memcpy(blob.data() + header.indexOffset, m_Indices, header.indexByteSize);
     }
-    m_Mode = mesh.getDrawMode();
 
-    m_bCompiled = true;
+    return g_fileSystem.write_binary_file(filename, blob.data(), blob.size());
 }
 
-void RenderMesh3D::render(Pipeline& p) const
+bool Mesh3D::loadFromCooked(const char* filename)
 {
-    m_Layout.bind();
+    MappedFile::Ptr file = g_fileSystem.map_binary_file(filename);
+    if (!file)
+    {
+        return false;
+    }
+
+    const uint8_t* base = file->data();
+    const meshFileHeader_t* header = reinterpret_cast<const meshFileHeader_t*>(base);
+
+    if (file->size() < sizeof(meshFileHeader_t) || header->magic != MESH_FILE_MAGIC)
+    {
+        Error("%s: not a cooked mesh file", filename);
+        return false;
+    }
+
+    if (header->version < 1 || header->version > MESH_FILE_VERSION)
+    {
+        Error("%s: cooked mesh version %u, expected %u", filename, header->version, MESH_FILE_VERSION);
+        return false;
+    }
+
+    const uint32_t indexSize = header->indexType == uint32_t(eDataType::UNSIGNED_SHORT) ? 2 : 4;
+
+    if (header->fileSize > file->size()
+        || header->numAttribs > MFS_COUNT
+        || sizeof(meshFileHeader_t) + uint64_t(header->numAttribs) * sizeof(meshFileAttrib_t) > header->fileSize
+        || (header->indexType != uint32_t(eDataType::UNSIGNED_SHORT) && header->indexType != uint32_t(eDataType::UNSIGNED_INT32))
+        || uint64_t(header->numIndex) * indexSize > header->indexByteSize
+        || uint64_t(header->indexOffset) + header->indexByteSize > header->fileSize
+        || uint64_t(header->lodOffset) + uint64_t(header->numLods) * sizeof(meshFileLod_t) > header->fileSize
+        || (header->version >= 3 && uint64_t(header->lodOffset) + uint64_t(header->numLods) * sizeof(meshFileLod_t)
+            + uint64_t(header->numMeshlets) * sizeof(meshFileMeshlet_t) > header->fileSize))
+    {
+        Error("%s: corrupt cooked mesh file", filename);
+        return false;
+    }
+
+    clear();
+
+    const meshFileAttrib_t* attribs = reinterpret_cast<const meshFileAttrib_t*>(base + sizeof(meshFileHeader_t));
+
+    for (uint32_t i = 0; i < header->numAttribs; ++i)
+    {
+        const meshFileAttrib_t& fa = attribs[i];
+
+        if (fa.semantic >= MFS_COUNT || fa.type > uint32_t(eDataType::UNSIGNED_INT_24_8) || fa.size < 1 || fa.size > 4
+            || uint64_t(fa.offset) + fa.byteSize > header->fileSize)
+        {
+            Error("%s: corrupt attribute table", filename);
+            clear();
+            return false;
+        }
+
+        VertexAttribute va{};
+        va.name = const_cast<char*>(MESH_SEMANTIC_NAMES[fa.semantic]);
+        va.type = eDataType(fa.type);
+        va.size = int(fa.size);
+        va.count = int(fa.count);
+        va.normalized = fa.normalized != 0;
+        va.byteSize = fa.byteSize;
+
+        // the GPU buffers are created from count elements, not from byteSize
+        if (fa.count > uint32_t(INT32_MAX) || uint64_t(fa.count) * attributeElementSize(va) > fa.byteSize)
+        {
+            Error("%s: attribute %s is truncated", filename, MESH_SEMANTIC_NAMES[fa.semantic]);
+            clear();
+            return false;
+        }
+
+        // the mapping is read-only, the arrays are only ever exposed as const
+        void* data = const_cast<uint8_t*>(base + fa.offset);
+
+        switch (fa.semantic)
+        {
+        case MFS_POSITION:
+            m_Position_layout = va;
+            m_Positions = data;
+            break;
+        case MFS_NORMAL:
+            m_Normal_layout = va;
+            m_Normals = data;
+            break;
+        case MFS_TANGENT:
+            m_Tangent_layout = va;
+            m_Tangents = data;
+            break;
+        case MFS_TEXCOORD_0:
+            m_TexCoord_layout = va;
+            m_TexCoords = data;
+            break;
+        case MFS_COLOR_0:
+            m_Color_layout = va;
+            m_Colors = data;
+            break;
+        }
+    }
+
+    m_Mode = eDrawMode(header->drawMode);
+    m_IndexType = eDataType(header->indexType);
+    m_NumIndex = header->numIndex;
+    m_Indices = header->indexByteSize ? const_cast<uint8_t*>(base + header->indexOffset) : nullptr;
+
+    const meshFileLod_t* lods = reinterpret_cast<const meshFileLod_t*>(base + header->lodOffset);
+    for (uint32_t i = 0; i < header->numLods; ++i)
+    {
+        if (uint64_t(lods[i].firstIndex) + lods[i].numIndex > m_NumIndex)
+        {
+            Error("%s: corrupt LOD table", filename);
+            clear();
+            return false;
+        }
+        m_Lods.push_back({ lods[i].firstIndex, lods[i].numIndex, lods[i].error });
+    }
+
+    // the mapping is read-only, older files simply come without meshlets
+    const uint32_t numMeshlets = header->version >= 3 ? header->numMeshlets : 0;
+    const meshFileMeshlet_t* meshlets = reinterpret_cast<const meshFileMeshlet_t*>(lods + header->numLods);
+    for (uint32_t i = 0; i < numMeshlets; ++i)
+    {
+        const meshFileMeshlet_t& ml = meshlets[i];
+        if (uint64_t(ml.firstIndex) + ml.numIndex > m_NumIndex)
+        {
+            Error("%s: corrupt meshlet table", filename);
+            clear();
+            return false;
+        }
+        m_Meshlets.spheres.push_back(glm::vec4(ml.sphere[0], ml.sphere[1], ml.sphere[2], ml.sphere[3]));
+        m_Meshlets.cones.push_back(glm::vec4(ml.cone[0], ml.cone[1], ml.cone[2], ml.cone[3]));
+        m_Meshlets.ranges.push_back({ ml.firstIndex, ml.numIndex });
+    }
 
-    if (m_IndexBuf.isCreated())
+    for (int i = 0; i < 3; ++i)
     {
-        m_IndexBuf.bind();
-        p.drawElements(m_Mode, m_NumIndex, m_IndexType, 0U);
+        m_Bounds[0][i] = header->boundsMin[i];
+        m_Bounds[1][i] = header->boundsMax[i];
     }
+
+    m_Mapping = file;
+
+    return true;
 }
@@ -10,6 +10,24 @@
 #include "gpu_types.h"
 #include "gpu_vertex_layout.h"
 #include "gpu_buffer.h"
+#include "meshlet.h"
+#include "geometry_arena.h"
+#include "render_queue.h"
+
+class Pipeline;
+
+enum eMeshImportFlags { MIF_OPTIMIZE_VERTEX_CACHE = 1, MIF_OPTIMIZE_OVERDRAW = 2 };
+
+/*
+One level of detail: a range of the shared index buffer, all LODs index
+the same vertices. error bounds the world space deviation from LOD 0.
+*/
+struct meshLod_t
+{
+	unsigned int firstIndex;
+	unsigned int numIndex;
+	float error;
+};
 
 class Mesh3D
 {
@@ -29,12 +47,46 @@ public:
 		m_IndexType(eDataType::UNSIGNED_SHORT),
 		m_NumIndex(),
 		m_Mode(),
-		m_Bounds() {}
+		m_Bounds(),
+		m_bOwnsData() {}
+	Mesh3D(const Mesh3D&) = delete;
+	Mesh3D& operator=(const Mesh3D&) = delete;
+	~Mesh3D();
 
 	using Ptr = std::shared_ptr<Mesh3D>;
 
-	bool loadFromGLTF(const char* filename, int meshIdx, int primitiveIdx);
-	bool importFromGLTF(const tinygltf::Model& model, const tinygltf::Primitive& meshPrimitive);
+	bool loadFromGLTF(const char* filename, int meshIdx, int primitiveIdx, unsigned int importFlags = MIF_OPTIMIZE_VERTEX_CACHE);
+	bool importFromGLTF(const tinygltf::Model& model, const tinygltf::Primitive& meshPrimitive, unsigned int importFlags = MIF_OPTIMIZE_VERTEX_CACHE);
+
+	/*
+	* Reorders triangles for post-transform cache locality, optionally clusters
+	* them against overdraw, then reorders vertices by first use.
+	* flags: eMeshImportFlags. Only owned triangle lists can be optimized,
+	* and only when every attribute array has one element per position.
+	*/
+	bool optimize(unsigned int flags);
+
+	/*
+	* Appends up to numLods - 1 simplified index ranges after LOD 0, each
+	* targeting ratio times the triangles of the previous one. Stops early
+	* when simplification no longer makes progress. Run optimize() first.
+	*/
+	bool generateLods(int numLods, float ratio = 0.5f);
+
+	/*
+	* Splits LOD 0 into clusters of at most MESHLET_MAX_VERTICES vertices and
+	* MESHLET_MAX_TRIANGLES triangles with culling bounds (see meshlet.h).
+	* Triangles inside each cluster are vertex cache optimized again.
+	* Index reordering invalidates them, optimize() clears the set.
+	*/
+	bool buildMeshlets();
+
+	/*
+	* Cooked binary format (see mesh_file.h). loadFromCooked maps the file
+	* and points the attribute/index arrays into the mapping, nothing is copied.
+	*/
+	bool loadFromCooked(const char* filename);
+	bool saveCooked(const char* filename) const;
 
 	const void* getPositions() const { return m_Positions; }
 	const void* getTexCoords() const { return m_TexCoords; }
@@ -42,7 +94,11 @@ public:
 	const void* getTangents() const { return m_Tangents; }
 	const void* getColors() const { return m_Colors; }
 	const void* getIndices() const { return m_Indices; }
+	// total number of indices, all LODs included
 	unsigned int getNumIndex() const { return m_NumIndex; }
+	// LOD ranges, empty when only the full detail mesh exists
+	const std::vector<meshLod_t>& getLods() const { return m_Lods; }
+	const MeshletSet& getMeshlets() const { return m_Meshlets; }
 	eDataType getIndexType() const { return m_IndexType; }
 	eDrawMode getDrawMode() const { return m_Mode; }
 	const VertexAttribute& getPositionLayout() const { return m_Position_layout; }
@@ -50,7 +106,7 @@ public:
 	const VertexAttribute& getNormalLayout() const { return m_Normal_layout; }
 	const VertexAttribute& getTangentLayout() const { return m_Tangent_layout; }
 	const VertexAttribute& getColorLayout() const { return m_Color_layout; }
-	void getBounds(glm::vec3& min, glm::vec3& max)
+	void getBounds(glm::vec3& min, glm::vec3& max) const
 	{
 		min.x = m_Bounds[0].x;
 		min.y = m_Bounds[0].y;
@@ -60,6 +116,7 @@ public:
 		max.z = m_Bounds[1].z;
 	}
 private:
+	void clear();
 
 	void* m_Positions;
 	void* m_TexCoords;
@@ -79,6 +136,13 @@ private:
 
 	glm::vec3 m_Bounds[2];
 
+	std::vector<meshLod_t> m_Lods;
+	MeshletSet m_Meshlets;
+
+	// false when the arrays point into m_Mapping
+	bool m_bOwnsData;
+	MappedFile::Ptr m_Mapping;
+
 	/*
 	* TODO
 	* textures, materials, animations,...
@@ -94,27 +158,76 @@ public:
 		m_NormalBuf(eGpuBufferTarget::VERTEX),
 		m_TangentBuf(eGpuBufferTarget::VERTEX),
 		m_ColorBuf(eGpuBufferTarget::VERTEX),
+		m_PackedBuf(eGpuBufferTarget::VERTEX),
 		m_IndexBuf(eGpuBufferTarget::INDEX),
+		m_Arena(),
+		m_ArenaRange(),
 		m_bCompiled(),
 		m_NumIndex(),
 		m_IndexType(),
 		m_Min(),
 		m_Max() {}
+	RenderMesh3D(const RenderMesh3D&) = delete;
+	RenderMesh3D& operator=(const RenderMesh3D&) = delete;
+	~RenderMesh3D();
+
+	/*
+	* packed = false: one full precision stream per attribute
+	* packed = true: a single interleaved packedVertex_t stream (see vertex_packing.h)
+	*/
+	void compile(const Mesh3D& mesh, bool packed = false);
+
+	/*
+	* Places the mesh in the shared arena instead of buffers of its own.
+	* render() then draws through the arena's VAO with a base vertex and
+	* record() queues the mesh for IndirectDrawList::submit.
+	*/
+	bool compile(const Mesh3D& mesh, GeometryArena& arena);
+	bool record(IndirectDrawList& list, uint64_t stateBits, const glm::mat4& world, int lod = 0) const;
 
-	void compile(const Mesh3D& mesh);
+	/*
+	* Fills the geometry part of a RenderQueue packet (layout, index buffer,
+	* draw range), program, state bits, textures and depth are up to the caller.
+	*/
+	bool getDrawPacket(drawPacket_t& packet, int lod = 0) const;
 	void render(Pipeline&) const;
+	void render(Pipeline&, int lod) const;
+
+	/*
+	* Picks the coarsest LOD whose error, projected with the current world
+	* matrix and Pipeline::g_cam, stays below maxPixelError pixels.
+	*/
+	int selectLod(const Pipeline& p, float maxPixelError = 1.0f) const;
+	int getLodCount() const { return int(m_Lods.size()); }
+
+	/*
+	* Draws the meshlets of LOD 0 that pass the frustum and backface cone
+	* tests against the current world matrix and camera, adjacent visible
+	* clusters merged into one draw. Falls back to render(p, 0) without meshlets.
+	* Returns the number of visible clusters.
+	*/
+	size_t renderCulled(Pipeline& p) const;
+	size_t getMeshletCount() const { return m_Meshlets.size(); }
 
 	inline bool isCompiled() const { return m_bCompiled; }
+	inline bool isPacked() const { return m_PackedBuf.isCreated() || m_Arena; }
+	inline bool isInArena() const { return m_Arena != nullptr; }
 private:
 	GpuBuffer m_PositionBuf;
 	GpuBuffer m_TexCoordBuf;
 	GpuBuffer m_NormalBuf;
 	GpuBuffer m_TangentBuf;
 	GpuBuffer m_ColorBuf;
+	GpuBuffer m_PackedBuf;
 	GpuBuffer m_IndexBuf;
 
 	VertexLayout m_Layout;
+	GeometryArena* m_Arena;
+	geometryRange_t m_ArenaRange;
 	glm::vec3 m_Min, m_Max;
+	std::vector<meshLod_t> m_Lods;
+	MeshletSet m_Meshlets;
+	mutable std::vector<drawRange_t> m_VisibleRanges;
 
 	unsigned int m_NumIndex;
 	eDataType m_IndexType;
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cinttypes>
+
+/*
+Cooked mesh file layout (all offsets from the start of the file)
+
+	meshFileHeader_t
+	meshFileAttrib_t[numAttribs]
+	meshFileLod_t[numLods], at lodOffset (version 2)
+	meshFileMeshlet_t[numMeshlets], right after the LOD table (version 3)
+	attribute data, each block aligned to MESH_FILE_ALIGNMENT
+	index data, aligned to MESH_FILE_ALIGNMENT
+
+Data blocks are aligned so the loader can hand pointers into the
+mapped file straight to GpuBuffer::create.
+*/
+
+#define MESH_FILE_MAGIC		0x4D45534A		// 'JSEM'
+#define MESH_FILE_VERSION	3
+#define MESH_FILE_ALIGNMENT	16
+
+enum eMeshFileSemantic { MFS_POSITION, MFS_NORMAL, MFS_TANGENT, MFS_TEXCOORD_0, MFS_COLOR_0, MFS_COUNT };
+
+struct meshFileHeader_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t fileSize;
+	uint32_t numAttribs;
+
+	uint32_t drawMode;			// eDrawMode
+	uint32_t indexType;			// eDataType
+	uint32_t numIndex;
+	uint32_t indexOffset;
+
+	uint32_t indexByteSize;
+	uint32_t numLods;			// 0 in version 1 files
+	uint32_t lodOffset;
+	uint32_t numMeshlets;		// 0 before version 3
+
+	float boundsMin[4];
+	float boundsMax[4];
+};
+
+struct meshFileAttrib_t
+{
+	uint32_t semantic;			// eMeshFileSemantic
+	uint32_t type;				// eDataType
+	uint32_t size;
+	uint32_t count;
+
+	uint32_t normalized;
+	uint32_t offset;
+	uint32_t byteSize;
+	uint32_t reserved;
+};
+
+// index range of one LOD inside the shared index data
+struct meshFileLod_t
+{
+	uint32_t firstIndex;
+	uint32_t numIndex;
+	float error;				// world space simplification error
+	uint32_t reserved;
+};
+
+// cluster of LOD 0, see meshlet.h
+struct meshFileMeshlet_t
+{
+	float sphere[4];			// xyz center, w radius
+	float cone[4];				// xyz axis, w cutoff
+	uint32_t firstIndex;
+	uint32_t numIndex;
+	uint32_t reserved[2];
+};
+
+static_assert(sizeof(meshFileHeader_t) == 80, "meshFileHeader_t layout changed");
+static_assert(sizeof(meshFileAttrib_t) == 32, "meshFileAttrib_t layout changed");
+static_assert(sizeof(meshFileLod_t) == 16, "meshFileLod_t layout changed");
+static_assert(sizeof(meshFileMeshlet_t) == 48, "meshFileMeshlet_t layout changed");
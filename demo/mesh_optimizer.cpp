@@ -0,0 +1,364 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "mesh_optimizer.h"
+
+/*
+Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006
+https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+*/
+static const int FORSYTH_CACHE_SIZE = 32;
+
+static float forsythVertexScore(int cachePos, unsigned remaining)
+{
+	if (remaining == 0)
+	{
+		// no triangle needs this vertex any more
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+
+	if (cachePos >= 0)
+	{
+		if (cachePos < 3)
+		{
+			// vertices of the last triangle get a fixed score so the
+			// algorithm does not just strip along
+			score = 0.75f;
+		}
+		else
+		{
+			const float s = 1.0f - float(cachePos - 3) / float(FORSYTH_CACHE_SIZE - 3);
+			score = std::pow(s, 1.5f);
+		}
+	}
+
+	// boost vertices with few triangles left to get rid of lone triangles
+	score += 2.0f * std::pow(float(remaining), -0.5f);
+
+	return score;
+}
+
+meshCacheStats_t MeshOpt_AnalyzeVertexCache(const uint32_t* indices, size_t numIndex, size_t numVerts, unsigned cacheSize)
+{
+	meshCacheStats_t result{};
+
+	if (numIndex < 3 || numVerts == 0)
+	{
+		return result;
+	}
+
+	// FIFO cache: a vertex is resident while misses - timestamp < cacheSize
+	std::vector<size_t> timestamp(numVerts, 0);
+	size_t misses = 0;
+
+	for (size_t i = 0; i < numIndex; ++i)
+	{
+		const uint32_t v = indices[i];
+
+		if (timestamp[v] == 0 || misses + 1 - timestamp[v] > cacheSize)
+		{
+			++misses;
+			timestamp[v] = misses;
+		}
+	}
+
+	result.acmr = float(misses) / float(numIndex / 3);
+	result.atvr = float(misses) / float(numVerts);
+
+	return result;
+}
+
+void MeshOpt_OptimizeVertexCache(uint32_t* indices, size_t numIndex, size_t numVerts)
+{
+	const size_t numTris = numIndex / 3;
+
+	if (numTris == 0 || numVerts == 0)
+	{
+		return;
+	}
+
+	// vertex -> triangle adjacency, compressed rows
+	std::vector<unsigned> valence(numVerts, 0);
+	for (size_t i = 0; i < numTris * 3; ++i)
+	{
+		++valence[indices[i]];
+	}
+
+	std::vector<unsigned> adjOffset(numVerts + 1, 0);
+	for (size_t v = 0; v < numVerts; ++v)
+	{
+		adjOffset[v + 1] = adjOffset[v] + valence[v];
+	}
+
+	std::vector<uint32_t> adjTris(numTris * 3);
+	std::vector<unsigned> remaining(numVerts, 0);
+	for (size_t t = 0; t < numTris; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32_t v = indices[t * 3 + k];
+			adjTris[adjOffset[v] + remaining[v]++] = uint32_t(t);
+		}
+	}
+
+	std::vector<int> cachePos(numVerts, -1);
+	std::vector<float> vertScore(numVerts);
+	for (size_t v = 0; v < numVerts; ++v)
+	{
+		vertScore[v] = forsythVertexScore(-1, remaining[v]);
+	}
+
+	std::vector<bool> emitted(numTris, false);
+
+	int bestTri = -1;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < numTris; ++t)
+	{
+		const float score = vertScore[indices[t * 3]] + vertScore[indices[t * 3 + 1]] + vertScore[indices[t * 3 + 2]];
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestTri = int(t);
+		}
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(numTris * 3);
+
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	size_t scanCursor = 0;
+
+	while (output.size() < numTris * 3)
+	{
+		if (bestTri < 0)
+		{
+			// nothing in the cache has live triangles, take the next unused one
+			while (emitted[scanCursor]) ++scanCursor;
+			bestTri = int(scanCursor);
+		}
+
+		const uint32_t* tri = indices + size_t(bestTri) * 3;
+		emitted[bestTri] = true;
+
+		uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+		int newCount = 0;
+
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32_t v = tri[k];
+			output.push_back(v);
+			newCache[newCount++] = v;
+
+			// drop the triangle from the live adjacency of v
+			const unsigned begin = adjOffset[v];
+			const unsigned end = begin + remaining[v];
+			for (unsigned a = begin; a < end; ++a)
+			{
+				if (adjTris[a] == uint32_t(bestTri))
+				{
+					std::swap(adjTris[a], adjTris[end - 1]);
+					break;
+				}
+			}
+			--remaining[v];
+		}
+
+		for (int c = 0; c < cacheCount; ++c)
+		{
+			const uint32_t v = cache[c];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+			{
+				newCache[newCount++] = v;
+			}
+		}
+
+		for (int c = FORSYTH_CACHE_SIZE; c < newCount; ++c)
+		{
+			cachePos[newCache[c]] = -1;
+			vertScore[newCache[c]] = forsythVertexScore(-1, remaining[newCache[c]]);
+		}
+
+		cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+		for (int c = 0; c < cacheCount; ++c)
+		{
+			const uint32_t v = newCache[c];
+			cache[c] = v;
+			cachePos[v] = c;
+			vertScore[v] = forsythVertexScore(c, remaining[v]);
+		}
+
+		// rescore the live triangles touching the cache, pick the best one
+		bestTri = -1;
+		bestScore = -1.0f;
+		for (int c = 0; c < newCount; ++c)
+		{
+			const uint32_t v = newCache[c];
+			for (unsigned a = adjOffset[v]; a < adjOffset[v] + remaining[v]; ++a)
+			{
+				const uint32_t t = adjTris[a];
+				const float score = vertScore[indices[t * 3]] + vertScore[indices[t * 3 + 1]] + vertScore[indices[t * 3 + 2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTri = int(t);
+				}
+			}
+		}
+	}
+
+	::memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void MeshOpt_OptimizeOverdraw(uint32_t* indices, size_t numIndex, const float* positions, size_t numVerts, float threshold)
+{
+	const size_t numTris = numIndex / 3;
+
+	if (numTris < 2 || !positions)
+	{
+		return;
+	}
+
+	const meshCacheStats_t before = MeshOpt_AnalyzeVertexCache(indices, numIndex, numVerts);
+
+	// hard cluster boundaries: triangles that miss the cache on all three vertices
+	std::vector<size_t> clusters;
+	{
+		std::vector<size_t> timestamp(numVerts, 0);
+		size_t misses = 0;
+
+		for (size_t t = 0; t < numTris; ++t)
+		{
+			int triMisses = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t v = indices[t * 3 + k];
+				if (timestamp[v] == 0 || misses + 1 - timestamp[v] > MESHOPT_DEFAULT_CACHE_SIZE)
+				{
+					++misses;
+					++triMisses;
+					timestamp[v] = misses;
+				}
+			}
+
+			if (t == 0 || triMisses == 3)
+			{
+				clusters.push_back(t);
+			}
+		}
+	}
+
+	if (clusters.size() < 2)
+	{
+		return;
+	}
+
+	auto vertex = [positions](uint32_t v) {
+		return glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+	};
+
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	struct cluster_t
+	{
+		size_t first, count;
+		glm::vec3 centroid;
+		glm::vec3 normal;
+		float area;
+		float key;
+	};
+	std::vector<cluster_t> sorted(clusters.size());
+
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		cluster_t& cl = sorted[c];
+		cl.first = clusters[c];
+		cl.count = (c + 1 < clusters.size() ? clusters[c + 1] : numTris) - cl.first;
+		cl.centroid = glm::vec3(0.0f);
+		cl.normal = glm::vec3(0.0f);
+		cl.area = 0.0f;
+
+		for (size_t t = cl.first; t < cl.first + cl.count; ++t)
+		{
+			const glm::vec3 p0 = vertex(indices[t * 3]);
+			const glm::vec3 p1 = vertex(indices[t * 3 + 1]);
+			const glm::vec3 p2 = vertex(indices[t * 3 + 2]);
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float area = glm::length(n);
+
+			cl.centroid += (p0 + p1 + p2) * (area / 3.0f);
+			cl.normal += n;
+			cl.area += area;
+		}
+
+		meshCentroid += cl.centroid;
+		meshArea += cl.area;
+
+		if (cl.area > 0.0f) cl.centroid /= cl.area;
+	}
+
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	// clusters that face away from the mesh centre are likely to occlude the rest, draw them first
+	for (cluster_t& cl : sorted)
+	{
+		const float len = glm::length(cl.normal);
+		cl.key = len > 0.0f ? glm::dot(cl.centroid - meshCentroid, cl.normal / len) : 0.0f;
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](const cluster_t& a, const cluster_t& b) { return a.key > b.key; });
+
+	std::vector<uint32_t> output;
+	output.reserve(numTris * 3);
+	for (const cluster_t& cl : sorted)
+	{
+		output.insert(output.end(), indices + cl.first * 3, indices + (cl.first + cl.count) * 3);
+	}
+
+	const meshCacheStats_t after = MeshOpt_AnalyzeVertexCache(output.data(), numTris * 3, numVerts);
+
+	if (after.acmr <= before.acmr * threshold)
+	{
+		::memcpy(indices, output.data(), numTris * 3 * sizeof(uint32_t));
+	}
+}
+
+size_t MeshOpt_OptimizeVertexFetch(uint32_t* indices, size_t numIndex, size_t numVerts, uint32_t* remap)
+{
+	for (size_t v = 0; v < numVerts; ++v)
+	{
+		remap[v] = ~0u;
+	}
+
+	uint32_t next = 0;
+	for (size_t i = 0; i < numIndex; ++i)
+	{
+		uint32_t& r = remap[indices[i]];
+		if (r == ~0u)
+		{
+			r = next++;
+		}
+		indices[i] = r;
+	}
+
+	return next;
+}
+
+void MeshOpt_RemapVertexArray(void* dst, const void* src, size_t numVerts, size_t elementSize, const uint32_t* remap)
+{
+	uint8_t* d = static_cast<uint8_t*>(dst);
+	const uint8_t* s = static_cast<const uint8_t*>(src);
+
+	for (size_t v = 0; v < numVerts; ++v)
+	{
+		if (remap[v] != ~0u)
+		{
+			::memcpy(d + size_t(remap[v]) * elementSize, s + v * elementSize, elementSize);
+		}
+	}
+}
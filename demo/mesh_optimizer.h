@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+/*
+CPU side index/vertex reordering for triangle lists.
+All passes work on 32 bit indices, Mesh3D::optimize converts as needed.
+*/
+
+#define MESHOPT_DEFAULT_CACHE_SIZE 16
+
+struct meshCacheStats_t
+{
+	float acmr;		// average cache miss ratio, transformed vertices per triangle
+	float atvr;		// average transform to vertex ratio, 1.0 is optimal
+};
+
+// simulates a FIFO post-transform cache of cacheSize entries
+meshCacheStats_t MeshOpt_AnalyzeVertexCache(const uint32_t* indices, size_t numIndex, size_t numVerts, unsigned cacheSize = MESHOPT_DEFAULT_CACHE_SIZE);
+
+// Forsyth's linear-speed vertex cache optimization, reorders triangles in place
+void MeshOpt_OptimizeVertexCache(uint32_t* indices, size_t numIndex, size_t numVerts);
+
+/*
+Splits the cache-optimized triangle order into clusters at cache flush
+boundaries and sorts the clusters so outward facing ones come first.
+The new order is kept only if ACMR does not grow by more than threshold
+(e.g. 1.05 allows 5% worse vertex cache efficiency).
+positions: tightly packed float3
+*/
+void MeshOpt_OptimizeOverdraw(uint32_t* indices, size_t numIndex, const float* positions, size_t numVerts, float threshold);
+
+/*
+Builds a remap table that orders vertices by first use and rewrites the
+indices accordingly. remap[old] = new, or ~0u for unreferenced vertices.
+Returns the number of referenced vertices.
+*/
+size_t MeshOpt_OptimizeVertexFetch(uint32_t* indices, size_t numIndex, size_t numVerts, uint32_t* remap);
+
+// scatters a tightly packed vertex array through remap, dst and src must not overlap
+void MeshOpt_RemapVertexArray(void* dst, const void* src, size_t numVerts, size_t elementSize, const uint32_t* remap);
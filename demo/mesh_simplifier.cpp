@@ -0,0 +1,313 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "mesh_simplifier.h"
+
+/*
+Symmetric 4x4 plane quadric, stored as its upper triangle.
+Planes are area weighted, w keeps the total so the error can be
+normalized back to a squared distance.
+*/
+struct quadric_t
+{
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+	double w;
+};
+
+static void quadricAddPlane(quadric_t& q, const glm::dvec3& n, double d, double w)
+{
+	q.a00 += w * n.x * n.x; q.a01 += w * n.x * n.y; q.a02 += w * n.x * n.z; q.a03 += w * n.x * d;
+	q.a11 += w * n.y * n.y; q.a12 += w * n.y * n.z; q.a13 += w * n.y * d;
+	q.a22 += w * n.z * n.z; q.a23 += w * n.z * d;
+	q.a33 += w * d * d;
+	q.w += w;
+}
+
+static void quadricAdd(quadric_t& q, const quadric_t& r)
+{
+	q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02; q.a03 += r.a03;
+	q.a11 += r.a11; q.a12 += r.a12; q.a13 += r.a13;
+	q.a22 += r.a22; q.a23 += r.a23;
+	q.a33 += r.a33;
+	q.w += r.w;
+}
+
+static double quadricError(const quadric_t& q, const glm::dvec3& p)
+{
+	const double e =
+		q.a00 * p.x * p.x + 2.0 * q.a01 * p.x * p.y + 2.0 * q.a02 * p.x * p.z + 2.0 * q.a03 * p.x +
+		q.a11 * p.y * p.y + 2.0 * q.a12 * p.y * p.z + 2.0 * q.a13 * p.y +
+		q.a22 * p.z * p.z + 2.0 * q.a23 * p.z +
+		q.a33;
+
+	return e > 0.0 && q.w > 0.0 ? e / q.w : 0.0;
+}
+
+static inline uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+	return (uint64_t(a) << 32) | b;
+}
+
+struct collapse_t
+{
+	uint32_t from, to;
+	float cost;
+	float error;		// positional part of cost, squared world units
+};
+
+size_t MeshOpt_Simplify(uint32_t* dst, const uint32_t* indices, size_t numIndex,
+	const float* positions, size_t numVerts,
+	const float* attributes, size_t numAttribs, const float* attribWeights,
+	size_t targetIndexCount, float targetError, float* resultError)
+{
+	if (resultError) *resultError = 0.0f;
+
+	::memmove(dst, indices, numIndex * sizeof(uint32_t));
+	size_t count = numIndex - numIndex % 3;
+
+	if (count <= targetIndexCount || numVerts == 0)
+	{
+		return count;
+	}
+
+	auto position = [positions](uint32_t v) {
+		return glm::dvec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+	};
+
+	// vertices sharing a position are one wedge; wedges with more than one vertex are seams
+	std::vector<uint32_t> wedge(numVerts);
+	std::vector<bool> locked(numVerts, false);
+	{
+		struct posHash_t
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				// equality treats -0 and 0 as one position, the hash has to as well
+				const float c[3] = { p.x == 0.0f ? 0.0f : p.x, p.y == 0.0f ? 0.0f : p.y, p.z == 0.0f ? 0.0f : p.z };
+				uint32_t h[3];
+				::memcpy(h, c, sizeof(h));
+				return size_t(h[0] * 73856093u ^ h[1] * 19349663u ^ h[2] * 83492791u);
+			}
+		};
+
+		std::unordered_map<glm::vec3, uint32_t, posHash_t> firstAt;
+		firstAt.reserve(numVerts);
+
+		for (uint32_t v = 0; v < numVerts; ++v)
+		{
+			const glm::vec3 p(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+			auto it = firstAt.emplace(p, v);
+			wedge[v] = it.first->second;
+			if (!it.second)
+			{
+				locked[v] = true;
+				locked[it.first->second] = true;
+			}
+		}
+	}
+
+	// open border edges have no twin going the other way
+	{
+		std::unordered_map<uint64_t, int> edges;
+		edges.reserve(count);
+
+		for (size_t i = 0; i < count; i += 3)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t a = wedge[dst[i + k]];
+				const uint32_t b = wedge[dst[i + (k + 1) % 3]];
+				++edges[edgeKey(a, b)];
+			}
+		}
+
+		for (size_t i = 0; i < count; i += 3)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t a = dst[i + k];
+				const uint32_t b = dst[i + (k + 1) % 3];
+				if (edges.find(edgeKey(wedge[b], wedge[a])) == edges.end())
+				{
+					locked[a] = true;
+					locked[b] = true;
+				}
+			}
+		}
+	}
+
+	std::vector<quadric_t> quadrics(numVerts, quadric_t{});
+	for (size_t i = 0; i < count; i += 3)
+	{
+		const glm::dvec3 p0 = position(dst[i]);
+		const glm::dvec3 p1 = position(dst[i + 1]);
+		const glm::dvec3 p2 = position(dst[i + 2]);
+		glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+		const double area = glm::length(n);
+
+		if (area <= 0.0) continue;
+
+		n /= area;
+		const double d = -glm::dot(n, p0);
+
+		for (int k = 0; k < 3; ++k)
+		{
+			quadricAddPlane(quadrics[dst[i + k]], n, d, area);
+		}
+	}
+
+	const double errorLimit = double(targetError) * double(targetError);
+	double maxError = 0.0;
+
+	std::vector<uint32_t> adjOffset(numVerts + 1);
+	std::vector<uint32_t> adjTris;
+	std::vector<uint32_t> remap(numVerts);
+	std::vector<bool> touched(numVerts);
+	std::vector<collapse_t> candidates;
+
+	while (count > targetIndexCount)
+	{
+		// vertex -> triangle adjacency for the current triangle list
+		std::fill(adjOffset.begin(), adjOffset.end(), 0);
+		for (size_t i = 0; i < count; ++i) ++adjOffset[dst[i] + 1];
+		for (size_t v = 0; v < numVerts; ++v) adjOffset[v + 1] += adjOffset[v];
+		adjTris.resize(count);
+		{
+			std::vector<uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+			for (size_t i = 0; i < count; ++i) adjTris[fill[dst[i]]++] = uint32_t(i / 3);
+		}
+
+		candidates.clear();
+		for (size_t i = 0; i < count; i += 3)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t a = dst[i + k];
+				const uint32_t b = dst[i + (k + 1) % 3];
+
+				for (int dir = 0; dir < 2; ++dir)
+				{
+					const uint32_t from = dir ? b : a;
+					const uint32_t to = dir ? a : b;
+
+					if (locked[from]) continue;
+
+					quadric_t q = quadrics[from];
+					quadricAdd(q, quadrics[to]);
+
+					const glm::dvec3 pto = position(to);
+					const double error = quadricError(q, pto);
+					double cost = error;
+
+					if (attributes && numAttribs)
+					{
+						const glm::dvec3 e = pto - position(from);
+						double attrCost = 0.0;
+						for (size_t c = 0; c < numAttribs; ++c)
+						{
+							const double diff = attributes[from * numAttribs + c] - attributes[to * numAttribs + c];
+							attrCost += (attribWeights ? attribWeights[c] : 1.0) * diff * diff;
+						}
+						cost += attrCost * glm::dot(e, e);
+					}
+
+					candidates.push_back({ from, to, float(cost), float(error) });
+				}
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const collapse_t& x, const collapse_t& y) { return x.cost < y.cost; });
+
+		for (uint32_t v = 0; v < numVerts; ++v) remap[v] = v;
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t removed = 0;
+		size_t collapses = 0;
+
+		for (const collapse_t& c : candidates)
+		{
+			if (count - removed * 3 <= targetIndexCount) break;
+			if (c.cost > errorLimit) break;
+			if (touched[c.from] || touched[c.to]) continue;
+
+			// reject collapses that flip or degenerate a remaining triangle
+			const glm::dvec3 pto = position(c.to);
+			bool valid = true;
+			size_t dying = 0;
+
+			for (uint32_t a = adjOffset[c.from]; a < adjOffset[c.from + 1] && valid; ++a)
+			{
+				const uint32_t* tri = dst + size_t(adjTris[a]) * 3;
+
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+				{
+					++dying;
+					continue;
+				}
+
+				const glm::dvec3 p0 = position(tri[0]);
+				const glm::dvec3 p1 = position(tri[1]);
+				const glm::dvec3 p2 = position(tri[2]);
+				const glm::dvec3 nBefore = glm::cross(p1 - p0, p2 - p0);
+
+				const glm::dvec3 q0 = tri[0] == c.from ? pto : p0;
+				const glm::dvec3 q1 = tri[1] == c.from ? pto : p1;
+				const glm::dvec3 q2 = tri[2] == c.from ? pto : p2;
+				const glm::dvec3 nAfter = glm::cross(q1 - q0, q2 - q0);
+
+				if (glm::dot(nBefore, nAfter) <= 0.25 * glm::length(nBefore) * glm::length(nAfter))
+				{
+					valid = false;
+				}
+			}
+
+			if (!valid || dying == 0) continue;
+
+			// everything around the collapsed vertex is stale for the rest of this pass
+			for (uint32_t a = adjOffset[c.from]; a < adjOffset[c.from + 1]; ++a)
+			{
+				const uint32_t* tri = dst + size_t(adjTris[a]) * 3;
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+
+			remap[c.from] = c.to;
+			quadricAdd(quadrics[c.to], quadrics[c.from]);
+			// the attribute term has no unit, only the distance is reported
+			maxError = std::max(maxError, double(c.error));
+			removed += dying;
+			++collapses;
+		}
+
+		if (collapses == 0)
+		{
+			break;
+		}
+
+		// apply the collapses and drop the degenerate triangles
+		size_t write = 0;
+		for (size_t i = 0; i < count; i += 3)
+		{
+			const uint32_t a = remap[dst[i]];
+			const uint32_t b = remap[dst[i + 1]];
+			const uint32_t c = remap[dst[i + 2]];
+
+			if (a != b && b != c && a != c)
+			{
+				dst[write++] = a;
+				dst[write++] = b;
+				dst[write++] = c;
+			}
+		}
+		count = write;
+	}
+
+	if (resultError) *resultError = float(std::sqrt(maxError));
+
+	return count;
+}
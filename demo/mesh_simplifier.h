@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+/*
+Quadric error metric edge-collapse simplification (Garland & Heckbert 1997).
+
+Collapses move a vertex onto one of its neighbours, so the result indexes
+the original vertex buffer and LODs can share it. Vertices on open borders
+and on attribute seams (several vertices at the same position) never move.
+
+dst: receives the simplified triangle list, at least numIndex entries
+positions: tightly packed float3
+attributes: optional, numAttribs tightly packed floats per vertex, scaled
+	by attribWeights when comparing the two ends of an edge
+targetError: largest allowed collapse cost, the distance in world units
+	plus the attribute term
+resultError: receives the largest distance actually introduced, in world
+	units, the attribute term left out
+
+Returns the number of indices written to dst.
+*/
+size_t MeshOpt_Simplify(uint32_t* dst, const uint32_t* indices, size_t numIndex,
+	const float* positions, size_t numVerts,
+	const float* attributes, size_t numAttribs, const float* attribWeights,
+	size_t targetIndexCount, float targetError, float* resultError);
@@ -0,0 +1,242 @@
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include "meshlet.h"
+
+void MeshletSet::clear()
+{
+	spheres.clear();
+	cones.clear();
+	ranges.clear();
+}
+
+static void computeClusterBounds(MeshletSet& out, const uint32_t* indices, size_t first, size_t count, const float* positions)
+{
+	auto vertex = [positions](uint32_t v) {
+		return glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+	};
+
+	glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX);
+	glm::vec3 axis(0.0f);
+
+	for (size_t i = first; i < first + count; i += 3)
+	{
+		const glm::vec3 p0 = vertex(indices[i]);
+		const glm::vec3 p1 = vertex(indices[i + 1]);
+		const glm::vec3 p2 = vertex(indices[i + 2]);
+
+		bmin = glm::min(bmin, glm::min(p0, glm::min(p1, p2)));
+		bmax = glm::max(bmax, glm::max(p0, glm::max(p1, p2)));
+
+		const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		const float len = glm::length(n);
+		if (len > 0.0f) axis += n / len;
+	}
+
+	const glm::vec3 center = (bmin + bmax) * 0.5f;
+	float radius = 0.0f;
+	float minDot = 1.0f;
+
+	const float axisLen = glm::length(axis);
+	axis = axisLen > 0.0f ? axis / axisLen : glm::vec3(0, 0, 1);
+
+	for (size_t i = first; i < first + count; i += 3)
+	{
+		const glm::vec3 p0 = vertex(indices[i]);
+		const glm::vec3 p1 = vertex(indices[i + 1]);
+		const glm::vec3 p2 = vertex(indices[i + 2]);
+
+		radius = std::max(radius, glm::length(p0 - center));
+		radius = std::max(radius, glm::length(p1 - center));
+		radius = std::max(radius, glm::length(p2 - center));
+
+		const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		const float len = glm::length(n);
+		if (len > 0.0f) minDot = std::min(minDot, glm::dot(n / len, axis));
+	}
+
+	// cutoff = sin of the cone spread; 1 disables the backface test for wide cones
+	const float cutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+
+	out.spheres.push_back(glm::vec4(center, radius));
+	out.cones.push_back(glm::vec4(axis, cutoff));
+}
+
+void Meshlet_Build(MeshletSet& out, uint32_t* dst, const uint32_t* indices, size_t numIndex, uint32_t firstIndex, const float* positions, size_t numVerts)
+{
+	out.clear();
+
+	const size_t numTris = numIndex / 3;
+	if (numTris == 0)
+	{
+		return;
+	}
+
+	auto vertex = [positions](uint32_t v) {
+		return glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+	};
+
+	// vertex -> triangle adjacency
+	std::vector<uint32_t> adjOffset(numVerts + 1, 0);
+	std::vector<uint32_t> adjTris(numTris * 3);
+	for (size_t i = 0; i < numTris * 3; ++i) ++adjOffset[indices[i] + 1];
+	for (size_t v = 0; v < numVerts; ++v) adjOffset[v + 1] += adjOffset[v];
+	{
+		std::vector<uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+		for (size_t i = 0; i < numTris * 3; ++i) adjTris[fill[indices[i]]++] = uint32_t(i / 3);
+	}
+
+	std::vector<bool> emitted(numTris, false);
+	// last cluster each vertex was added to, so membership is O(1)
+	std::vector<uint32_t> owner(numVerts, ~0u);
+	std::vector<uint32_t> candidates;
+
+	size_t write = 0;
+	size_t seedCursor = 0;
+	uint32_t clusterId = 0;
+
+	while (write < numTris * 3)
+	{
+		const size_t clusterStart = write;
+		unsigned clusterVerts = 0;
+		glm::vec3 centroidSum(0.0f);
+		candidates.clear();
+
+		auto newVertices = [&](uint32_t t) {
+			unsigned n = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				if (owner[indices[t * 3 + k]] != clusterId) ++n;
+			}
+			return n;
+		};
+
+		auto emit = [&](uint32_t t) {
+			emitted[t] = true;
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t v = indices[t * 3 + k];
+				dst[write++] = v;
+				if (owner[v] != clusterId)
+				{
+					owner[v] = clusterId;
+					++clusterVerts;
+					centroidSum += vertex(v);
+					for (uint32_t a = adjOffset[v]; a < adjOffset[v + 1]; ++a)
+					{
+						if (!emitted[adjTris[a]]) candidates.push_back(adjTris[a]);
+					}
+				}
+			}
+		};
+
+		// seed with the next unused triangle in the incoming (cache optimized) order
+		while (emitted[seedCursor]) ++seedCursor;
+		emit(uint32_t(seedCursor));
+
+		while ((write - clusterStart) / 3 < MESHLET_MAX_TRIANGLES)
+		{
+			// grow towards the neighbour that adds the fewest vertices, closest to the centroid on ties
+			const glm::vec3 centroid = centroidSum / float(clusterVerts);
+			uint32_t best = ~0u;
+			unsigned bestNew = 4;
+			float bestDist = FLT_MAX;
+
+			size_t keep = 0;
+			for (size_t c = 0; c < candidates.size(); ++c)
+			{
+				const uint32_t t = candidates[c];
+				if (emitted[t]) continue;
+				candidates[keep++] = t;
+
+				const unsigned n = newVertices(t);
+				if (clusterVerts + n > MESHLET_MAX_VERTICES || n > bestNew) continue;
+
+				const glm::vec3 d = (vertex(indices[t * 3]) + vertex(indices[t * 3 + 1]) + vertex(indices[t * 3 + 2])) * (1.0f / 3.0f) - centroid;
+				const float dist = glm::dot(d, d);
+				if (n < bestNew || dist < bestDist)
+				{
+					best = t;
+					bestNew = n;
+					bestDist = dist;
+				}
+			}
+			candidates.resize(keep);
+
+			if (best == ~0u)
+			{
+				break;
+			}
+
+			emit(best);
+		}
+
+		computeClusterBounds(out, dst, clusterStart, write - clusterStart, positions);
+		out.ranges.push_back({ firstIndex + uint32_t(clusterStart), uint32_t(write - clusterStart) });
+		++clusterId;
+	}
+}
+
+size_t Meshlet_Cull(const MeshletSet& set, const glm::vec4 planes[6], const glm::vec3& cameraPos, std::vector<drawRange_t>& out)
+{
+	const size_t count = set.size();
+	size_t visible = 0;
+
+	for (size_t c = 0; c < count; ++c)
+	{
+		const glm::vec4& s = set.spheres[c];
+		const glm::vec3 center(s);
+
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; ++p)
+		{
+			inside = glm::dot(glm::vec3(planes[p]), center) + planes[p].w >= -s.w;
+		}
+
+		if (!inside) continue;
+
+		// every triangle faces away when the camera is inside the cone's back side
+		const glm::vec4& cone = set.cones[c];
+		const glm::vec3 toCenter = center - cameraPos;
+		if (glm::dot(toCenter, glm::vec3(cone)) >= cone.w * glm::length(toCenter) + s.w)
+		{
+			continue;
+		}
+
+		const drawRange_t& r = set.ranges[c];
+		if (!out.empty() && out.back().firstIndex + out.back().numIndex == r.firstIndex)
+		{
+			out.back().numIndex += r.numIndex;
+		}
+		else
+		{
+			out.push_back(r);
+		}
+
+		++visible;
+	}
+
+	return visible;
+}
+
+void Meshlet_ExtractFrustum(const glm::mat4& m, glm::vec4 planes[6])
+{
+	// Gribb & Hartmann, rows of the matrix combined; glm is column major
+	const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	planes[0] = row3 + row0;	// left
+	planes[1] = row3 - row0;	// right
+	planes[2] = row3 + row1;	// bottom
+	planes[3] = row3 - row1;	// top
+	planes[4] = row3 + row2;	// near
+	planes[5] = row3 - row2;	// far
+
+	for (int i = 0; i < 6; ++i)
+	{
+		const float len = glm::length(glm::vec3(planes[i]));
+		if (len > 0.0f) planes[i] /= len;
+	}
+}
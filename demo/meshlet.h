@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define MESHLET_MAX_VERTICES	64
+#define MESHLET_MAX_TRIANGLES	124
+
+// a contiguous run of the index buffer, in indices
+struct drawRange_t
+{
+	uint32_t firstIndex;
+	uint32_t numIndex;
+};
+
+/*
+Triangle clusters of a triangle list, stored as parallel arrays so the
+culling loop only touches the fields it tests.
+Each cluster is a contiguous run of the index buffer, so visible clusters
+can be drawn as plain index ranges.
+*/
+struct MeshletSet
+{
+	std::vector<glm::vec4> spheres;		// xyz center, w radius
+	std::vector<glm::vec4> cones;		// xyz axis, w cutoff, see Meshlet_Cull
+	std::vector<drawRange_t> ranges;
+
+	size_t size() const { return ranges.size(); }
+	void clear();
+};
+
+/*
+Greedy clustering: each cluster is seeded with the next unused triangle in
+index order and grown through shared vertices.
+dst: receives the triangles reordered cluster by cluster, numIndex entries, must not alias indices
+indices: 32 bit triangle list, firstIndex is added to every stored range
+positions: tightly packed float3
+*/
+void Meshlet_Build(MeshletSet& out, uint32_t* dst, const uint32_t* indices, size_t numIndex, uint32_t firstIndex, const float* positions, size_t numVerts);
+
+/*
+Frustum and backface cone test in the space the meshlets were built in.
+planes: 6 planes, xyz normal pointing inside, w distance (see Meshlet_ExtractFrustum)
+Visible clusters are appended to out, adjacent ones merged into a single range.
+Returns the number of visible clusters.
+*/
+size_t Meshlet_Cull(const MeshletSet& set, const glm::vec4 planes[6], const glm::vec3& cameraPos, std::vector<drawRange_t>& out);
+
+// planes of the clip volume of a (model)view-projection matrix
+void Meshlet_ExtractFrustum(const glm::mat4& mvp, glm::vec4 planes[6]);
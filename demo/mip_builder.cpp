@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cmath>
+#include "job_system.h"
+#include "mip_builder.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Kaiser and Lanczos support, in destination texels
+static const float MIP_FILTER_RADIUS = 3.0f;
+static const float MIP_KAISER_ALPHA = 4.0f;
+static const uint32_t MIP_ROWS_PER_JOB = 16;
+
+static const float MIP_PI = 3.14159265358979f;
+
+static float Sinc(float x)
+{
+	if (std::fabs(x) < 1e-5f) return 1.0f;
+	x *= MIP_PI;
+	return std::sin(x) / x;
+}
+
+// zeroth order modified Bessel function of the first kind
+static float BesselI0(float x)
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+
+	for (int k = 1; k < 32; ++k)
+	{
+		const float f = x / (2.0f * k);
+		term *= f * f;
+		sum += term;
+		if (term < sum * 1e-7f) break;
+	}
+
+	return sum;
+}
+
+static float FilterWeight(eMipFilter filter, float t)
+{
+	t = std::fabs(t);
+
+	switch (filter)
+	{
+	case MF_BOX:
+		return t <= 0.5f ? 1.0f : 0.0f;
+	case MF_LANCZOS:
+		return t < MIP_FILTER_RADIUS ? Sinc(t) * Sinc(t / MIP_FILTER_RADIUS) : 0.0f;
+	case MF_KAISER:
+	{
+		if (t >= MIP_FILTER_RADIUS) return 0.0f;
+		const float r = t / MIP_FILTER_RADIUS;
+		return Sinc(t) * BesselI0(MIP_KAISER_ALPHA * std::sqrt(1.0f - r * r)) / BesselI0(MIP_KAISER_ALPHA);
+	}
+	}
+
+	return 0.0f;
+}
+
+/*
+Polyphase weights of one axis: numTaps source indices (clamped to the
+edge) and normalized weights per destination texel.
+*/
+struct filterTaps_t
+{
+	int numTaps;
+	std::vector<int> index;
+	std::vector<float> weight;
+};
+
+static void BuildTaps(eMipFilter filter, int srcSize, int dstSize, filterTaps_t& taps)
+{
+	const float scale = float(srcSize) / float(dstSize);
+	const float radius = (filter == MF_BOX ? 0.5f : MIP_FILTER_RADIUS) * scale;
+
+	taps.numTaps = int(std::ceil(radius)) * 2 + 2;
+	taps.index.assign(size_t(dstSize) * taps.numTaps, 0);
+	taps.weight.assign(size_t(dstSize) * taps.numTaps, 0.0f);
+
+	for (int x = 0; x < dstSize; ++x)
+	{
+		const float center = (x + 0.5f) * scale;
+		const int first = int(std::floor(center - radius));
+
+		int* index = &taps.index[size_t(x) * taps.numTaps];
+		float* weight = &taps.weight[size_t(x) * taps.numTaps];
+		float sum = 0.0f;
+
+		for (int k = 0; k < taps.numTaps; ++k)
+		{
+			const int i = first + k;
+			index[k] = std::min(std::max(i, 0), srcSize - 1);
+			weight[k] = FilterWeight(filter, (i + 0.5f - center) / scale);
+			sum += weight[k];
+		}
+
+		for (int k = 0; k < taps.numTaps; ++k)
+		{
+			weight[k] /= sum;
+		}
+	}
+}
+
+// dst[0..n) += src[0..n) * w
+static inline void MulAdd(float* dst, const float* src, float w, int n)
+{
+	int i = 0;
+#ifdef MIP_USE_SSE2
+	const __m128 vw = _mm_set1_ps(w);
+	for (; i + 4 <= n; i += 4)
+	{
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), vw)));
+	}
+#endif
+	for (; i < n; ++i)
+	{
+		dst[i] += src[i] * w;
+	}
+}
+
+static void Downsample(eMipFilter filter, const std::vector<float>& src, int sw, int sh, std::vector<float>& dst, int dw, int dh)
+{
+	filterTaps_t tapsX, tapsY;
+	BuildTaps(filter, sw, dw, tapsX);
+	BuildTaps(filter, sh, dh, tapsY);
+
+	// horizontal: sh rows of dw texels
+	std::vector<float> tmp(size_t(dw) * sh * 4);
+
+	g_jobSystem.parallelFor(uint32_t(sh), MIP_ROWS_PER_JOB, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t y = begin; y < end; ++y)
+		{
+			const float* srcRow = &src[size_t(y) * sw * 4];
+			float* tmpRow = &tmp[size_t(y) * dw * 4];
+
+			for (int x = 0; x < dw; ++x)
+			{
+				const int* index = &tapsX.index[size_t(x) * tapsX.numTaps];
+				const float* weight = &tapsX.weight[size_t(x) * tapsX.numTaps];
+#ifdef MIP_USE_SSE2
+				__m128 acc = _mm_setzero_ps();
+				for (int k = 0; k < tapsX.numTaps; ++k)
+				{
+					acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(srcRow + index[k] * 4), _mm_set1_ps(weight[k])));
+				}
+				_mm_storeu_ps(tmpRow + x * 4, acc);
+#else
+				float acc[4] = {};
+				for (int k = 0; k < tapsX.numTaps; ++k)
+				{
+					for (int c = 0; c < 4; ++c) acc[c] += srcRow[index[k] * 4 + c] * weight[k];
+				}
+				for (int c = 0; c < 4; ++c) tmpRow[x * 4 + c] = acc[c];
+#endif
+			}
+		}
+	});
+
+	// vertical: whole rows at a time
+	dst.assign(size_t(dw) * dh * 4, 0.0f);
+
+	g_jobSystem.parallelFor(uint32_t(dh), MIP_ROWS_PER_JOB, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t y = begin; y < end; ++y)
+		{
+			const int* index = &tapsY.index[size_t(y) * tapsY.numTaps];
+			const float* weight = &tapsY.weight[size_t(y) * tapsY.numTaps];
+			float* dstRow = &dst[size_t(y) * dw * 4];
+
+			for (int k = 0; k < tapsY.numTaps; ++k)
+			{
+				if (weight[k] != 0.0f)
+				{
+					MulAdd(dstRow, &tmp[size_t(index[k]) * dw * 4], weight[k], dw * 4);
+				}
+			}
+		}
+	});
+}
+
+static float SrgbToLinear(float c)
+{
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float c)
+{
+	return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static void Decode(const uint8_t* rgba, int w, int h, const mipSettings_t& settings, std::vector<float>& out)
+{
+	float srgbToLinear[256];
+	for (int i = 0; i < 256; ++i)
+	{
+		srgbToLinear[i] = SrgbToLinear(i / 255.0f);
+	}
+
+	out.resize(size_t(w) * h * 4);
+
+	g_jobSystem.parallelFor(uint32_t(h), MIP_ROWS_PER_JOB, [&](uint32_t begin, uint32_t end)
+	{
+		for (size_t i = size_t(begin) * w; i < size_t(end) * w; ++i)
+		{
+			const uint8_t* p = rgba + i * 4;
+			float* f = &out[i * 4];
+
+			for (int c = 0; c < 4; ++c)
+			{
+				const float v = p[c] / 255.0f;
+
+				if (c == settings.roughnessChannel) f[c] = v * v;
+				else if (c < 3 && settings.normalMap) f[c] = v * 2.0f - 1.0f;
+				else if (c < 3 && settings.srgb) f[c] = srgbToLinear[p[c]];
+				else f[c] = v;
+			}
+		}
+	});
+}
+
+// clamps filter overshoot and renormalizes, the result feeds the next level
+static void Resolve(std::vector<float>& level, int w, int h, const mipSettings_t& settings)
+{
+	g_jobSystem.parallelFor(uint32_t(h), MIP_ROWS_PER_JOB, [&](uint32_t begin, uint32_t end)
+	{
+		for (size_t i = size_t(begin) * w; i < size_t(end) * w; ++i)
+		{
+			float* f = &level[i * 4];
+
+			for (int c = 0; c < 4; ++c)
+			{
+				const float lo = c < 3 && settings.normalMap && c != settings.roughnessChannel ? -1.0f : 0.0f;
+				f[c] = std::min(std::max(f[c], lo), 1.0f);
+			}
+
+			if (settings.normalMap)
+			{
+				const float len = std::sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+				if (len > 1e-6f)
+				{
+					f[0] /= len;
+					f[1] /= len;
+					f[2] /= len;
+				}
+				else
+				{
+					f[0] = f[1] = 0.0f;
+					f[2] = 1.0f;
+				}
+			}
+		}
+	});
+}
+
+static void Encode(const std::vector<float>& level, int w, int h, const mipSettings_t& settings, std::vector<uint8_t>& out)
+{
+	out.resize(size_t(w) * h * 4);
+
+	g_jobSystem.parallelFor(uint32_t(h), MIP_ROWS_PER_JOB, [&](uint32_t begin, uint32_t end)
+	{
+		for (size_t i = size_t(begin) * w; i < size_t(end) * w; ++i)
+		{
+			const float* f = &level[i * 4];
+			uint8_t* p = &out[i * 4];
+
+			for (int c = 0; c < 4; ++c)
+			{
+				float v;
+
+				if (c == settings.roughnessChannel) v = std::sqrt(f[c]);
+				else if (c < 3 && settings.normalMap) v = f[c] * 0.5f + 0.5f;
+				else if (c < 3 && settings.srgb) v = LinearToSrgb(f[c]);
+				else v = f[c];
+
+				p[c] = uint8_t(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	});
+}
+
+void Mip_BuildChain(const uint8_t* rgba, int width, int height, const mipSettings_t& settings, std::vector<mipLevel_t>& levels)
+{
+	levels.clear();
+	levels.push_back({ width, height, std::vector<uint8_t>(rgba, rgba + size_t(width) * height * 4) });
+
+	std::vector<float> current, next;
+	Decode(rgba, width, height, settings, current);
+
+	int w = width;
+	int h = height;
+
+	while (w > 1 || h > 1)
+	{
+		const int nw = std::max(w / 2, 1);
+		const int nh = std::max(h / 2, 1);
+
+		Downsample(settings.filter, current, w, h, next, nw, nh);
+		Resolve(next, nw, nh, settings);
+
+		levels.push_back({ nw, nh, {} });
+		Encode(next, nw, nh, settings, levels.back().rgba);
+
+		current.swap(next);
+		w = nw;
+		h = nh;
+	}
+}
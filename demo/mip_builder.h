@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cinttypes>
+#include <vector>
+
+/*
+CPU mip chain builder for RGBA8 images.
+
+Each level is a separable resample of the previous one, in float and
+in linear space: sRGB color is decoded first, packed normals are
+unpacked to [-1, 1] and renormalized after every level, a roughness
+channel is averaged as alpha = roughness^2 so glossy highlights do not
+spread when texels merge. Negative filter lobes are clamped per level.
+
+Rows of both passes are spread over g_jobSystem.
+*/
+
+enum eMipFilter
+{
+	MF_BOX,			// 2x2 average
+	MF_KAISER,		// windowed sinc, alpha 4, 3 texel radius
+	MF_LANCZOS		// Lanczos 3
+};
+
+struct mipSettings_t
+{
+	eMipFilter filter = MF_KAISER;
+	bool srgb = false;				// rgb is sRGB encoded
+	bool normalMap = false;			// rgb is a unit vector packed to [0, 1]
+	int roughnessChannel = -1;		// 0..3, -1 when the image has none
+};
+
+struct mipLevel_t
+{
+	int width;
+	int height;
+	std::vector<uint8_t> rgba;
+};
+
+// levels[0] is a copy of the source, the chain ends at 1x1
+void Mip_BuildChain(const uint8_t* rgba, int width, int height, const mipSettings_t& settings, std::vector<mipLevel_t>& levels);
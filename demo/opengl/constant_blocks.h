@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/*
+std140 mirrors of the uniform blocks in assets/shaders/constant_blocks.inc.glsl.
+Field order and padding must match the GLSL declarations, the asserts
+below catch layout drift on the C++ side.
+*/
+
+// fixed binding points shared by every program, low points stay free for effect local blocks
+enum eConstantBlockBinding
+{
+	CB_BINDING_MATRIX = 8,
+	CB_BINDING_SUNLIGHT,
+	CB_BINDING_CAMERA,
+	CB_BINDING_LOW_FREQ,
+	CB_BINDING_HIGH_FREQ,
+	CB_BINDING_COUNT = 5
+};
+
+struct cbMatrix_t
+{
+	glm::mat4 m_W;
+	glm::mat4 m_V;
+	glm::mat4 m_P;
+	glm::mat4 m_Normal;
+
+	glm::mat4 m_WV;
+	glm::mat4 m_VP;
+	glm::mat4 m_WVP;
+
+	glm::mat4 m_iP;
+	glm::mat4 m_iVP;
+};
+
+struct cbSunlight_t
+{
+	glm::vec4 v_position;
+	glm::vec4 v_direction;
+	glm::vec4 v_color;
+	float f_intensity;
+	float pad[3];
+};
+
+struct cbCamera_t
+{
+	glm::vec4 v_position;
+	glm::vec4 v_target;
+	glm::vec4 v_direction;
+	glm::vec4 v_up;
+	glm::vec4 v_near_far_fov;
+};
+
+struct cbLowFreq_t
+{
+	glm::vec4 v_lowFreq[32];
+};
+
+struct cbHighFreq_t
+{
+	glm::vec4 v_highFreq[32];
+};
+
+static_assert(sizeof(glm::vec4) == 16 && sizeof(glm::mat4) == 64, "glm types must be tightly packed for std140");
+
+static_assert(offsetof(cbMatrix_t, m_Normal) == 192, "cb_matrix layout");
+static_assert(offsetof(cbMatrix_t, m_iVP) == 512, "cb_matrix layout");
+static_assert(sizeof(cbMatrix_t) == 576, "cb_matrix layout");
+
+static_assert(offsetof(cbSunlight_t, f_intensity) == 48, "cb_sunlight layout");
+static_assert(sizeof(cbSunlight_t) == 64, "cb_sunlight layout");
+
+static_assert(offsetof(cbCamera_t, v_near_far_fov) == 64, "cb_camera layout");
+static_assert(sizeof(cbCamera_t) == 80, "cb_camera layout");
+
+static_assert(sizeof(cbLowFreq_t) == 512, "cb_lowFreq layout");
+static_assert(sizeof(cbHighFreq_t) == 512, "cb_highFreq layout");
@@ -0,0 +1,171 @@
+#include "logger.h"
+#include "gpu_utils.h"
+#include "profiler.h"
+#include "frame_scheduler.h"
+
+FrameScheduler g_frameScheduler;
+
+static const float FRAME_SCHEDULER_AVERAGE_WEIGHT = 0.05f;
+// GPU and CPU clocks drift apart slowly, the offset is measured again this often
+static const uint64_t FRAME_SCHEDULER_CALIBRATE_FRAMES = 256;
+
+static void Average(float& avg, int64_t ns)
+{
+	avg += (float(ns) * 1e-6f - avg) * FRAME_SCHEDULER_AVERAGE_WEIGHT;
+}
+
+FrameScheduler::FrameScheduler() :
+	m_Slots(),
+	m_NumFrames(1),
+	m_Slot(0),
+	m_FrameIndex(0),
+	m_bInitialized(false),
+	m_GpuToCpu(0),
+	m_WaitNs(0),
+	m_CpuMs(0.0f),
+	m_GpuMs(0.0f),
+	m_LatencyMs(0.0f),
+	m_WaitMs(0.0f),
+	m_RetiredIndex(-1),
+	m_RetiredGpuMs(0.0f),
+	m_RetiredLatencyMs(0.0f)
+{
+}
+
+bool FrameScheduler::init(int framesInFlight)
+{
+	if (m_bInitialized)
+	{
+		return false;
+	}
+
+	if (framesInFlight < 1 || framesInFlight > FRAME_SCHEDULER_MAX_FRAMES)
+	{
+		Warning("FrameScheduler: %d frames in flight is out of range, using %d", framesInFlight, framesInFlight < 1 ? 1 : FRAME_SCHEDULER_MAX_FRAMES);
+		framesInFlight = framesInFlight < 1 ? 1 : FRAME_SCHEDULER_MAX_FRAMES;
+	}
+
+	m_NumFrames = framesInFlight;
+
+	for (int i = 0; i < m_NumFrames; ++i)
+	{
+		m_Slots[i].fence = nullptr;
+		m_Slots[i].cpuStart = 0;
+		m_Slots[i].frameIndex = -1;
+		GL_CHECK(glCreateQueries(GL_TIMESTAMP, 2, m_Slots[i].queries));
+	}
+
+	m_Slot = 0;
+	m_FrameIndex = 0;
+	calibrate();
+	m_bInitialized = true;
+
+	Info("FrameScheduler: %d frames in flight", m_NumFrames);
+
+	return true;
+}
+
+void FrameScheduler::shutdown()
+{
+	if (!m_bInitialized)
+	{
+		return;
+	}
+
+	for (int i = 0; i < m_NumFrames; ++i)
+	{
+		retire(m_Slots[i]);
+		GL_CHECK(glDeleteQueries(2, m_Slots[i].queries));
+	}
+
+	m_bInitialized = false;
+}
+
+void FrameScheduler::calibrate()
+{
+	GLint64 gpu = 0;
+	GL_CHECK(glGetInteger64v(GL_TIMESTAMP, &gpu));
+
+	m_GpuToCpu = Profiler::now() - int64_t(gpu);
+}
+
+bool FrameScheduler::retire(slot_t& slot)
+{
+	if (!slot.fence)
+	{
+		return false;
+	}
+
+	GLenum res = glClientWaitSync(slot.fence, 0, 0);
+	while (res == GL_TIMEOUT_EXPIRED)
+	{
+		res = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+
+	if (res == GL_WAIT_FAILED)
+	{
+		Error("FrameScheduler: glClientWaitSync failed");
+	}
+
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	// the fence came after both stamps, reading them does not stall
+	GLuint64 start = 0, end = 0;
+	GL_CHECK(glGetQueryObjectui64v(slot.queries[0], GL_QUERY_RESULT, &start));
+	GL_CHECK(glGetQueryObjectui64v(slot.queries[1], GL_QUERY_RESULT, &end));
+
+	m_RetiredIndex = slot.frameIndex;
+	m_RetiredGpuMs = float(int64_t(end - start)) * 1e-6f;
+	m_RetiredLatencyMs = float(int64_t(end) + m_GpuToCpu - slot.cpuStart) * 1e-6f;
+
+	m_GpuMs += (m_RetiredGpuMs - m_GpuMs) * FRAME_SCHEDULER_AVERAGE_WEIGHT;
+	m_LatencyMs += (m_RetiredLatencyMs - m_LatencyMs) * FRAME_SCHEDULER_AVERAGE_WEIGHT;
+
+	return true;
+}
+
+void FrameScheduler::beginFrame()
+{
+	if (!m_bInitialized)
+	{
+		return;
+	}
+
+	if (m_FrameIndex % FRAME_SCHEDULER_CALIBRATE_FRAMES == 0)
+	{
+		calibrate();
+	}
+
+	m_Slot = int(m_FrameIndex % uint64_t(m_NumFrames));
+	slot_t& slot = m_Slots[m_Slot];
+
+	const int64_t t = Profiler::now();
+	{
+		PROFILE_SCOPE("WaitGpu");
+		retire(slot);
+	}
+	slot.cpuStart = Profiler::now();
+	slot.frameIndex = int64_t(m_FrameIndex);
+	m_WaitNs = slot.cpuStart - t;
+
+	GL_CHECK(glQueryCounter(slot.queries[0], GL_TIMESTAMP));
+}
+
+void FrameScheduler::endFrame()
+{
+	if (!m_bInitialized)
+	{
+		return;
+	}
+
+	slot_t& slot = m_Slots[m_Slot];
+
+	GL_CHECK(glQueryCounter(slot.queries[1], GL_TIMESTAMP));
+	GL_CHECK(slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+	Average(m_CpuMs, Profiler::now() - slot.cpuStart);
+	Average(m_WaitMs, m_WaitNs);
+
+	++m_FrameIndex;
+}
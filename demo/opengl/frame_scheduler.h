@@ -0,0 +1,90 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cinttypes>
+
+#define FRAME_SCHEDULER_MAX_FRAMES 3
+
+/*
+Keeps up to framesInFlight frames queued on the GPU instead of waiting
+for each one before the next starts. Every frame slot has its own fence:
+beginFrame() waits only on the frame that last used the slot, so with
+two or more frames in flight the CPU builds frame N while the GPU still
+draws N-1 and a frame costs max(CPU, GPU) rather than CPU + GPU.
+
+Per-frame resources (GpuRingBuffer regions, transient buffers) are
+indexed by getSlot(), the wait in beginFrame() is what makes the slot's
+memory free to overwrite.
+
+The averages are reported separately:
+- CPU: beginFrame() to endFrame(), without the fence wait
+- GPU: first to last command of the frame on the GPU clock
+- latency: beginFrame() returning to the GPU finishing the frame
+- wait: time beginFrame() spent blocked on the fence
+*/
+class FrameScheduler
+{
+public:
+	FrameScheduler();
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+	// needs a current GL context, framesInFlight is clamped to 1..FRAME_SCHEDULER_MAX_FRAMES
+	bool init(int framesInFlight = 2);
+	// waits for the GPU to finish every frame in flight
+	void shutdown();
+
+	// main thread, before the frame touches any per-frame resource
+	void beginFrame();
+	// after the frame's last command, before the swap
+	void endFrame();
+
+	bool isInitialized() const { return m_bInitialized; }
+	int getSlot() const { return m_Slot; }
+	int getFramesInFlight() const { return m_NumFrames; }
+	uint64_t getFrameIndex() const { return m_FrameIndex; }
+
+	// milliseconds, averaged over a few frames
+	float getCpuMs() const { return m_CpuMs; }
+	float getGpuMs() const { return m_GpuMs; }
+	float getLatencyMs() const { return m_LatencyMs; }
+	float getWaitMs() const { return m_WaitMs; }
+
+	// the frame retired by the last beginFrame(), getFramesInFlight() frames
+	// behind it; index is -1 until one has retired
+	int64_t getRetiredIndex() const { return m_RetiredIndex; }
+	float getRetiredGpuMs() const { return m_RetiredGpuMs; }
+	float getRetiredLatencyMs() const { return m_RetiredLatencyMs; }
+private:
+	struct slot_t
+	{
+		GLsync fence;
+		GLuint queries[2];		// GL_TIMESTAMP at the start and end of the frame
+		int64_t cpuStart;		// Profiler::now() when the frame began
+		int64_t frameIndex;
+	};
+
+	// blocks on the slot's fence and reads its timers back, false when the slot was unused
+	bool retire(slot_t& slot);
+	void calibrate();
+
+	slot_t m_Slots[FRAME_SCHEDULER_MAX_FRAMES];
+	int m_NumFrames;
+	int m_Slot;
+	uint64_t m_FrameIndex;
+	bool m_bInitialized;
+
+	int64_t m_GpuToCpu;			// ns added to GPU timestamps
+	int64_t m_WaitNs;
+
+	float m_CpuMs;
+	float m_GpuMs;
+	float m_LatencyMs;
+	float m_WaitMs;
+
+	int64_t m_RetiredIndex;
+	float m_RetiredGpuMs;
+	float m_RetiredLatencyMs;
+};
+
+extern FrameScheduler g_frameScheduler;
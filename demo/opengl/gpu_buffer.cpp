@@ -17,6 +17,12 @@ static inline GLenum GL_CastBufferType(eGpuBufferTarget type)
 		return GL_ELEMENT_ARRAY_BUFFER;
 	case eGpuBufferTarget::UNIFORM:
 		return GL_UNIFORM_BUFFER;
+	case eGpuBufferTarget::INDIRECT:
+		return GL_DRAW_INDIRECT_BUFFER;
+	case eGpuBufferTarget::STORAGE:
+		return GL_SHADER_STORAGE_BUFFER;
+	case eGpuBufferTarget::PIXEL_UNPACK:
+		return GL_PIXEL_UNPACK_BUFFER;
 	}
 
 	return GL_FALSE;
@@ -55,6 +61,15 @@ void GpuBuffer::bindIndexed(uint32_t index, uint32_t offset, uint32_t size)
 	}
 }
 
+void GpuBuffer::update(uint32_t offset, uint32_t size, const void* bytes)
+{
+	assert(mBuffer != INVALID_BUFFER);
+	assert(offset + size <= mSize);
+
+	// DSA, so uploading indices never touches the element binding of the bound VAO
+	GL_CHECK(glNamedBufferSubData(mBuffer, mOffset + offset, size, bytes));
+}
+
 void GpuBuffer::unMap()
 {
 	assert(mBuffer != INVALID_BUFFER);
@@ -66,7 +81,7 @@ void GpuBuffer::unMap()
 	mIsMapped = false;
 	mMapPtr = nullptr;
 
-	Info("Buffer %d, type: %d UnMapped.", mBuffer, mTarget);
+	Debug("Buffer %d, type: %d UnMapped.", mBuffer, mTarget);
 
 }
 
@@ -90,7 +105,7 @@ uint8_t* GpuBuffer::map(unsigned int pAccess)
 	{
 		mMapPtr = ptr;
 		mIsMapped = true;
-		Info("Buffer %d, type: %d mapped.", mBuffer, mTarget);
+		Debug("Buffer %d, type: %d mapped.", mBuffer, mTarget);
 	}
 	else
 	{
@@ -8,6 +8,7 @@
 class GpuBuffer
 {
 	friend class Pipeline;
+	friend class GpuRingBuffer;
 public:
 	GpuBuffer() = delete;
 	~GpuBuffer();
@@ -26,6 +27,9 @@ public:
 	void unBind() const;
 	void bindVertexBuffer(uint32_t stream, uint32_t offset, uint32_t stride) const;
 	void bindIndexed(uint32_t index, uint32_t offset = 0, uint32_t size = 0);
+	// glBufferSubData, buffers created with storage flags need BA_DYNAMIC
+	void update(uint32_t offset, uint32_t size, const void* bytes);
+	uint32_t size() const { return mSize; }
 private:
 	GLuint mBuffer;
 	bool mIsMapped;
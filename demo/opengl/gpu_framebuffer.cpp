@@ -6,6 +6,8 @@
 #include "gpu_types.h"
 #include "gpu_utils.h"
 
+GpuFrameBuffer* GpuFrameBuffer::s_backBuffer = nullptr;
+
 GpuFrameBuffer::~GpuFrameBuffer()
 {
 	if (!m_fbo) return;
@@ -119,9 +121,3 @@ bool GpuFrameBuffer::checkCompletness()
 
 	return true;
 }
-
-void GpuFrameBuffer::bind()
-{
-	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
-}
-
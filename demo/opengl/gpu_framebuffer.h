@@ -9,6 +9,7 @@
 
 class GpuFrameBuffer
 {
+	friend class Pipeline;
 public:
 	~GpuFrameBuffer();
 	GpuFrameBuffer() :
@@ -25,9 +26,17 @@ public:
 	GpuFrameBuffer& setDepthStencilAttachment(GpuTexture2D::Ptr texture);
 
 	bool checkCompletness();
-	void bind();
+
+	/*
+	What effects draw their final image into: the window by default, a
+	GpuFrameBuffer when rendering offscreen (demo_bench). Effects bind it
+	with Pipeline::bindFrameBuffer(nullptr).
+	*/
+	static void setBackBuffer(GpuFrameBuffer* fb) { s_backBuffer = fb; }
 
 private:
+	static GpuFrameBuffer* s_backBuffer;
+
 	GLuint m_fbo;
 	GLuint m_depthRenderBuffer;
 	std::shared_ptr<GpuTexture2D> m_depthRenderTexture;
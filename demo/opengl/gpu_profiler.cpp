@@ -0,0 +1,175 @@
+#include "logger.h"
+#include "gpu_utils.h"
+#include "gpu_profiler.h"
+
+GpuProfiler g_gpuProfiler;
+
+static const float GPU_PROFILER_AVERAGE_WEIGHT = 0.05f;
+
+GpuProfiler::GpuProfiler() :
+	m_Current(0),
+	m_MaxScopes(0),
+	m_Skipped(0),
+	m_bInitialized(false),
+	m_bWasCapturing(false),
+	m_GpuToCpu(0)
+{
+}
+
+bool GpuProfiler::init(int latency, int maxScopes)
+{
+	if (m_bInitialized)
+	{
+		return false;
+	}
+
+	m_Frames.resize(size_t(latency > 1 ? latency : 2));
+	m_MaxScopes = maxScopes;
+
+	for (frame_t& frame : m_Frames)
+	{
+		frame.queries.resize(size_t(maxScopes) * 2);
+		frame.names.resize(size_t(maxScopes));
+		GL_CHECK(glCreateQueries(GL_TIMESTAMP, GLsizei(frame.queries.size()), frame.queries.data()));
+	}
+
+	m_Current = 0;
+	m_bInitialized = true;
+
+	return true;
+}
+
+void GpuProfiler::shutdown()
+{
+	if (!m_bInitialized)
+	{
+		return;
+	}
+
+	for (frame_t& frame : m_Frames)
+	{
+		GL_CHECK(glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data()));
+	}
+
+	m_Frames.clear();
+	m_bInitialized = false;
+}
+
+void GpuProfiler::calibrate()
+{
+	GLint64 gpu = 0;
+	GL_CHECK(glGetInteger64v(GL_TIMESTAMP, &gpu));
+
+	m_GpuToCpu = Profiler::now() - int64_t(gpu);
+}
+
+void GpuProfiler::beginFrame()
+{
+	if (!m_bInitialized)
+	{
+		return;
+	}
+
+	const bool capturing = g_profiler.isCapturing();
+	if (capturing && !m_bWasCapturing)
+	{
+		calibrate();
+	}
+	m_bWasCapturing = capturing;
+
+	m_Current = (m_Current + 1) % int(m_Frames.size());
+
+	frame_t& frame = m_Frames[m_Current];
+	readBack(frame);
+	frame.count = 0;
+}
+
+void GpuProfiler::readBack(frame_t& frame)
+{
+	if (frame.count == 0)
+	{
+		return;
+	}
+
+	// scopes are numbered in begin order, the outer one ends last: every end stamp is checked
+	GLint available = GL_TRUE;
+	for (int i = 0; i < frame.count && available != GL_FALSE; ++i)
+	{
+		GL_CHECK(glGetQueryObjectiv(frame.queries[size_t(i) * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available));
+	}
+
+	if (available == GL_FALSE)
+	{
+		if (++m_Skipped == 1)
+		{
+			Warning("GpuProfiler: the GPU is more than %d frames behind, results are skipped", int(m_Frames.size()));
+		}
+		return;
+	}
+
+	const bool capturing = g_profiler.isCapturing();
+
+	for (int i = 0; i < frame.count; ++i)
+	{
+		GLuint64 start = 0, end = 0;
+		GL_CHECK(glGetQueryObjectui64v(frame.queries[size_t(i) * 2], GL_QUERY_RESULT, &start));
+		GL_CHECK(glGetQueryObjectui64v(frame.queries[size_t(i) * 2 + 1], GL_QUERY_RESULT, &end));
+
+		const float ms = float(end - start) * 1e-6f;
+
+		auto it = m_Stats.find(frame.names[i]);
+		if (it == m_Stats.end())
+		{
+			m_Stats.emplace(frame.names[i], scopeStats_t{ ms, double(ms), 1 });
+		}
+		else
+		{
+			it->second.averageMs += (ms - it->second.averageMs) * GPU_PROFILER_AVERAGE_WEIGHT;
+			it->second.totalMs += double(ms);
+			++it->second.count;
+		}
+
+		if (capturing)
+		{
+			g_profiler.addGpuEvent(frame.names[i], int64_t(start) + m_GpuToCpu, int64_t(end) + m_GpuToCpu);
+		}
+	}
+}
+
+int GpuProfiler::beginScope(const char* name)
+{
+	if (!m_bInitialized)
+	{
+		return -1;
+	}
+
+	frame_t& frame = m_Frames[m_Current];
+	if (frame.count >= m_MaxScopes)
+	{
+		return -1;
+	}
+
+	const int scope = frame.count++;
+	frame.names[scope] = name;
+	GL_CHECK(glQueryCounter(frame.queries[size_t(scope) * 2], GL_TIMESTAMP));
+
+	return scope;
+}
+
+void GpuProfiler::endScope(int scope)
+{
+	if (scope < 0)
+	{
+		return;
+	}
+
+	frame_t& frame = m_Frames[m_Current];
+	GL_CHECK(glQueryCounter(frame.queries[size_t(scope) * 2 + 1], GL_TIMESTAMP));
+}
+
+float GpuProfiler::getAverageMs(const std::string& name) const
+{
+	auto it = m_Stats.find(name);
+
+	return it != m_Stats.end() ? it->second.averageMs : 0.0f;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cinttypes>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "profiler.h"
+
+/*
+GPU pass timing with GL_TIMESTAMP queries.
+
+Every scope writes a timestamp at its start and end, so scopes nest,
+which GL_TIME_ELAPSED queries cannot. The queries of a frame live in
+one of `latency` slots and are read back when the slot comes round
+again, by then the GPU has long finished them and nothing stalls; a
+slot still in flight is skipped rather than waited for.
+
+Results feed per-name averages and, during a capture, g_profiler's GPU
+track, moved onto the CPU clock with an offset measured when the
+capture starts.
+*/
+class GpuProfiler
+{
+public:
+	GpuProfiler();
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// needs a current GL context
+	bool init(int latency = 4, int maxScopes = 64);
+	void shutdown();
+
+	// main thread, once per frame before the first scope
+	void beginFrame();
+
+	// -1 when the frame ran out of queries, endScope() ignores it
+	int beginScope(const char* name);
+	void endScope(int scope);
+
+	struct scopeStats_t
+	{
+		float averageMs;		// recent frames weigh more
+		double totalMs;			// since the last resetStats()
+		uint32_t count;
+	};
+
+	// milliseconds, 0 for a name not seen yet
+	float getAverageMs(const std::string& name) const;
+	const std::unordered_map<std::string, scopeStats_t>& getStats() const { return m_Stats; }
+	// clears the totals, e.g. after a benchmark's warm-up frames
+	void resetStats() { m_Stats.clear(); }
+private:
+	struct frame_t
+	{
+		std::vector<GLuint> queries;		// start, end per scope
+		std::vector<const char*> names;
+		int count = 0;
+	};
+
+	void readBack(frame_t& frame);
+	void calibrate();
+
+	std::vector<frame_t> m_Frames;
+	int m_Current;
+	int m_MaxScopes;
+	int m_Skipped;
+	bool m_bInitialized;
+	bool m_bWasCapturing;
+
+	int64_t m_GpuToCpu;		// ns added to GPU timestamps
+	std::unordered_map<std::string, scopeStats_t> m_Stats;
+};
+
+extern GpuProfiler g_gpuProfiler;
+
+class GpuProfileScope
+{
+public:
+	explicit GpuProfileScope(const char* name) : m_Scope(g_gpuProfiler.beginScope(name)) {}
+	~GpuProfileScope() { g_gpuProfiler.endScope(m_Scope); }
+private:
+	int m_Scope;
+};
+
+#define GPU_PROFILE_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope_, __LINE__)(name)
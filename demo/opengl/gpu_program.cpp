@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <memory>
 #include <cstdio>
 #include <string>
@@ -6,6 +7,8 @@
 #include "logger.h"
 #include "gpu_types.h"
 #include "gpu_utils.h"
+#include "program_cache.h"
+#include "shader_preprocessor.h"
 #include "gpu_program.h"
 
 #undef _std
@@ -16,19 +19,38 @@
 GpuProgram::GpuProgram()
 {
 	mProgId = 0xffff;
+	mCurrentPermutation = 0;
+	mWatchId = 0;
 }
 
 GpuProgram& GpuProgram::operator=(GpuProgram&& moved)
 {
+	destroy();
+
 	mProgId = moved.mProgId;
+	mMapVar = std::move(moved.mMapVar);
+	mMapNames = std::move(moved.mMapNames);
+	mVertexFile = std::move(moved.mVertexFile);
+	mFragmentFile = std::move(moved.mFragmentFile);
+	mComputeFile = std::move(moved.mComputeFile);
+	mPermutations = std::move(moved.mPermutations);
+	mCurrentPermutation = moved.mCurrentPermutation;
+	mSourceFiles = std::move(moved.mSourceFiles);
+
 	moved.mProgId = 0xFFFF;
+	moved.mPermutations.clear();
+	moved.unwatchSources();
+
+	// the watch callback points at the object
+	watchSources({});
 
 	return *this;
 }
 GpuProgram::GpuProgram(GpuProgram&& moved)
 {
-	mProgId = moved.mProgId;
-	moved.mProgId = 0xFFFF;
+	mProgId = 0xFFFF;
+	mWatchId = 0;
+	*this = std::move(moved);
 }
 GpuProgram::~GpuProgram()
 {
@@ -46,23 +68,130 @@ bool GpuProgram::bindUniformBlock(const std::string& name, int bindingIndex)
 }
 bool GpuProgram::loadShader(const std::string& vertexShader, const std::string& fragmentShader)
 {
-	std::string vs, fs;
-	if (!g_fileSystem.read_text_file(vertexShader, vs))		return false;
-	if (!g_fileSystem.read_text_file(fragmentShader, fs))	return false;
+	destroy();
 
-	std::vector<const char*> vs_c = { vs.c_str() };
-	std::vector<const char*> fs_c = { fs.c_str() };
-	return createProgramFromShaderSource(vs_c, fs_c);
+	mVertexFile = vertexShader;
+	mFragmentFile = fragmentShader;
+	mComputeFile.clear();
 
+	return selectPermutation({});
 }
 
 bool GpuProgram::loadComputeShader(const std::string& shader)
 {
-	std::string cs;
-	if (!g_fileSystem.read_text_file(shader, cs))		return false;
+	destroy();
+
+	mVertexFile.clear();
+	mFragmentFile.clear();
+	mComputeFile = shader;
+
+	return selectPermutation({});
+}
+
+bool GpuProgram::selectPermutation(const std::vector<std::string>& defines)
+{
+	const uint64_t key = Shader_PermutationHash(defines);
+
+	if (key == mCurrentPermutation && mProgId != 0xFFFF)
+	{
+		return true;
+	}
+
+	if (mPermutations.find(key) == mPermutations.end())
+	{
+		programBuild_t build;
+		startPermutation(defines, build);
+		addPermutation(build);
+	}
+
+	return makeCurrent(key);
+}
+
+bool GpuProgram::makeCurrent(uint64_t key)
+{
+	auto it = mPermutations.find(key);
+	if (it == mPermutations.end() || it->second.program == 0)
+	{
+		return false;
+	}
+
+	mProgId = it->second.program;
+	mMapVar = it->second.locations;
+	mCurrentPermutation = key;
+
+	return true;
+}
+
+bool GpuProgram::startPermutation(const std::vector<std::string>& defines, programBuild_t& build)
+{
+	build = programBuild_t();
+	build.permutation = Shader_PermutationHash(defines);
+	build.defines = defines;
+
+	const bool compute = !mComputeFile.empty();
+	const eShaderStage stages[2] = { compute ? eShaderStage::COMPUTE : eShaderStage::VERTEX, eShaderStage::FRAGMENT };
+	const std::string* files[2] = { compute ? &mComputeFile : &mVertexFile, &mFragmentFile };
+	const int numStages = compute ? 1 : 2;
+
+	shaderSource_t preprocessed[2];
+	std::vector<const char*> sources[2];
+
+	for (int i = 0; i < numStages; ++i)
+	{
+		if (files[i]->empty() || !Shader_Preprocess(*files[i], defines, preprocessed[i]))
+		{
+			return false;
+		}
+
+		sources[i].push_back(preprocessed[i].code.c_str());
+		build.files.insert(build.files.end(), preprocessed[i].files.begin(), preprocessed[i].files.end());
+
+		// compiler messages say <source string>(<line>)
+		for (size_t n = 0; n < preprocessed[i].files.size(); ++n)
+		{
+			build.sourceTable.push_back(std::string(GetShaderStageTitle(stages[i])) + " " + std::to_string(n) + ": " + preprocessed[i].files[n]);
+		}
+	}
+
+	startBuild(numStages, stages, sources, build);
+
+	return true;
+}
+
+// a failed build is kept too, so it is not retried every frame
+bool GpuProgram::addPermutation(programBuild_t& build)
+{
+	const GLuint program = finishBuild(build);
+
+	permutation_t& perm = mPermutations[build.permutation];
+	perm.program = program;
+	perm.defines = build.defines;
+	resolveLocations(perm);
+
+	if (program)
+	{
+		watchSources(build.files);
+	}
+
+	return program != 0;
+}
+
+void GpuProgram::resolveLocations(permutation_t& perm) const
+{
+	perm.locations.assign(mMapNames.size(), -1);
 
-	std::vector<const char*> cs_c = { cs.c_str() };
-	return createComputeProgramFromShaderSource(cs_c);
+	if (perm.program == 0)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < mMapNames.size(); ++i)
+	{
+		if (!mMapNames[i].empty())
+		{
+			GL_CHECK(perm.locations[i] = glGetUniformLocation(perm.program, mMapNames[i].c_str()));
+		}
+	}
 }
 
 GLuint GpuProgram::createShaderInternal(eShaderStage stage, const std::vector<const char*>& sources)
@@ -80,97 +209,140 @@ GLuint GpuProgram::createShaderInternal(eShaderStage stage, const std::vector<co
 
 bool GpuProgram::createProgramFromShaderSource(const std::vector<const char*>& vert_sources, const std::vector<const char*>& frag_sources)
 {
-	if (mProgId != 0xFFFF)
-	{
-		GL_CHECK(glDeleteProgram(mProgId));
-	}
+	destroy();
 
-	GL_CHECK(mProgId = glCreateProgram());
+	mVertexFile.clear();
+	mFragmentFile.clear();
+	mComputeFile.clear();
 
-	GLuint vertShader = createShaderInternal(eShaderStage::VERTEX, vert_sources);
+	const eShaderStage stages[2] = { eShaderStage::VERTEX, eShaderStage::FRAGMENT };
+	const std::vector<const char*> sources[2] = { vert_sources, frag_sources };
 
-	if (!compileSingleStage(vertShader, eShaderStage::VERTEX))
-	{
-		destroy();
-		return false;
-	}
+	programBuild_t build;
+	startBuild(2, stages, sources, build);
 
-	GLuint fragShader = createShaderInternal(eShaderStage::FRAGMENT, frag_sources);
+	// raw sources have a single permutation, the one without defines
+	return addPermutation(build) && makeCurrent(0);
+}
 
-	if (!compileSingleStage(fragShader, eShaderStage::FRAGMENT))
-	{
-		GL_CHECK(glDeleteShader(vertShader));
-		destroy();
-		return false;
-	}
+bool GpuProgram::createComputeProgramFromShaderSource(const std::vector<const char*>& sources)
+{
+	destroy();
 
-	GL_CHECK(glAttachShader(mProgId, vertShader));
-	GL_CHECK(glAttachShader(mProgId, fragShader));
-	GL_CHECK(glLinkProgram(mProgId));
+	mVertexFile.clear();
+	mFragmentFile.clear();
+	mComputeFile.clear();
 
-	GL_CHECK(glDeleteShader(vertShader));
-	GL_CHECK(glDeleteShader(fragShader));
+	const eShaderStage stage = eShaderStage::COMPUTE;
 
-	GLint result = GL_FALSE;
+	programBuild_t build;
+	startBuild(1, &stage, &sources, build);
+
+	return addPermutation(build) && makeCurrent(0);
+}
 
-	GL_CHECK(glGetProgramiv(mProgId, GL_LINK_STATUS, &result));
+void GpuProgram::startBuild(int numStages, const eShaderStage* stages, const std::vector<const char*>* sources, programBuild_t& build)
+{
+	GL_CHECK(build.program = glCreateProgram());
+	build.numShaders = 0;
 
-	if (result == GL_FALSE)
+	build.cacheKey = g_programCache.getKey();
+	for (int i = 0; i < numStages; ++i)
 	{
-		GLint infologLen;
-		GL_CHECK(glGetProgramiv(mProgId, GL_INFO_LOG_LENGTH, &infologLen));
-		if (infologLen > 0) {
-			std::vector<char> logBuf(infologLen);
-			GL_CHECK(glGetProgramInfoLog(mProgId, infologLen, nullptr, logBuf.data()));
-			Error("Linking of shader program failed: %s", logBuf.data());
+		build.cacheKey = ProgramCache::addStage(build.cacheKey, stages[i], sources[i]);
+	}
 
-			destroy();
-			return false;
-		}
+	if (g_programCache.load(build.program, build.cacheKey))
+	{
+		return;
 	}
 
-	return true;
+	GL_CHECK(glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+
+	// nothing is read back here, a parallel compiling driver returns right away
+	for (int i = 0; i < numStages; ++i)
+	{
+		GLuint shader = createShaderInternal(stages[i], sources[i]);
+		GL_CHECK(glCompileShader(shader));
+		GL_CHECK(glAttachShader(build.program, shader));
+
+		build.shaders[build.numShaders] = shader;
+		build.stages[build.numShaders] = stages[i];
+		++build.numShaders;
+	}
+
+	GL_CHECK(glLinkProgram(build.program));
 }
-bool GpuProgram::createComputeProgramFromShaderSource(const std::vector<const char*>& sources)
+
+bool GpuProgram::isBuildComplete(const programBuild_t& build)
 {
-	if (mProgId != 0xFFFF)
+	if (build.numShaders == 0 || !(GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile))
 	{
-		GL_CHECK(glDeleteProgram(mProgId));
+		return true;
 	}
 
-	GL_CHECK(mProgId = glCreateProgram());
+	GLint done = GL_FALSE;
+	GL_CHECK(glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done));
 
-	GLuint shader = createShaderInternal(eShaderStage::COMPUTE, sources);
+	return done == GL_TRUE;
+}
 
-	if (!compileSingleStage(shader, eShaderStage::COMPUTE))
+GLuint GpuProgram::finishBuild(programBuild_t& build)
+{
+	if (build.program == 0 || build.numShaders == 0)
 	{
-		destroy();
-		return false;
+		// not started or loaded from the cache
+		return build.program;
 	}
 
-	GL_CHECK(glAttachShader(mProgId, shader));
-	GL_CHECK(glLinkProgram(mProgId));
-	GL_CHECK(glDeleteShader(shader));
-	GLint result = GL_FALSE;
+	bool ok = true;
 
-	GL_CHECK(glGetProgramiv(mProgId, GL_LINK_STATUS, &result));
+	for (int i = 0; i < build.numShaders; ++i)
+	{
+		ok = checkCompileStatus(build.shaders[i], build.stages[i]) && ok;
+	}
 
-	if (result == GL_FALSE)
+	if (ok)
 	{
-		GLint infologLen;
-		GL_CHECK(glGetProgramiv(mProgId, GL_INFO_LOG_LENGTH, &infologLen));
-		if (infologLen > 0) {
-			std::vector<char> logBuf(infologLen);
-			GL_CHECK(glGetProgramInfoLog(mProgId, infologLen, nullptr, logBuf.data()));
-			Error("Linking of shader program failed: %s", logBuf.data());
+		GLint result = GL_FALSE;
+		GL_CHECK(glGetProgramiv(build.program, GL_LINK_STATUS, &result));
+
+		if (result == GL_FALSE)
+		{
+			GLint infologLen;
+			GL_CHECK(glGetProgramiv(build.program, GL_INFO_LOG_LENGTH, &infologLen));
+			if (infologLen > 0) {
+				std::vector<char> logBuf(infologLen);
+				GL_CHECK(glGetProgramInfoLog(build.program, infologLen, nullptr, logBuf.data()));
+				Error("Linking of shader program failed: %s", logBuf.data());
+			}
+			ok = false;
+		}
+	}
 
-			destroy();
-			return false;
+	for (int i = 0; i < build.numShaders; ++i)
+	{
+		GL_CHECK(glDetachShader(build.program, build.shaders[i]));
+		GL_CHECK(glDeleteShader(build.shaders[i]));
+	}
+	build.numShaders = 0;
+
+	if (!ok)
+	{
+		for (const std::string& line : build.sourceTable)
+		{
+			Info("  %s", line.c_str());
 		}
+
+		GL_CHECK(glDeleteProgram(build.program));
+		build.program = 0;
+
+		return 0;
 	}
 
-	return true;
+	g_programCache.store(build.program, build.cacheKey);
 
+	return build.program;
 }
 
 int GpuProgram::getLocation(const std::string& name) const
@@ -192,96 +364,292 @@ bool GpuProgram::mapLocationToIndex(const std::string& name, const int index)
 
 	if (mMapVar.size() <= index)
 	{
-		mMapVar.resize(index + 1);
+		mMapVar.resize(index + 1, -1);
+	}
+	if (mMapNames.size() <= index)
+	{
+		mMapNames.resize(index + 1);
 	}
 
 	mMapVar[index] = loc;
+	mMapNames[index] = name;
+
+	// the other permutations pick the name up as well
+	for (auto& it : mPermutations)
+	{
+		resolveLocations(it.second);
+	}
 
+	return true;
 }
 
 void GpuProgram::set(int index, float f) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniform1f(mMapVar[index], f));
+	GL_CHECK(glProgramUniform1f(mProgId, mMapVar[index], f));
 }
 void GpuProgram::set(int index, int n, const float* f) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniform1fv(mMapVar[index], n, f));
+	GL_CHECK(glProgramUniform1fv(mProgId, mMapVar[index], n, f));
 }
 void GpuProgram::set(int index, int i) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniform1i(mMapVar[index], i));
+	GL_CHECK(glProgramUniform1i(mProgId, mMapVar[index], i));
 }
 void GpuProgram::set(int index, bool transpose, const glm::mat4& m) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniformMatrix4fv(mMapVar[index], 1, GLboolean(transpose), &m[0][0]));
+	GL_CHECK(glProgramUniformMatrix4fv(mProgId, mMapVar[index], 1, GLboolean(transpose), &m[0][0]));
 }
 void GpuProgram::set(int index, bool transpose, const glm::mat3& m) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniformMatrix3fv(mMapVar[index], 1, GLboolean(transpose), &m[0][0]));
+	GL_CHECK(glProgramUniformMatrix3fv(mProgId, mMapVar[index], 1, GLboolean(transpose), &m[0][0]));
 }
 void GpuProgram::set(int index, bool transpose, int n, const glm::mat4* m) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniformMatrix4fv(mMapVar[index], n, GLboolean(transpose), reinterpret_cast<const GLfloat*>(m)));
+	GL_CHECK(glProgramUniformMatrix4fv(mProgId, mMapVar[index], n, GLboolean(transpose), reinterpret_cast<const GLfloat*>(m)));
 }
 void GpuProgram::set(int index, bool transpose, int n, const glm::mat3* m) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniformMatrix3fv(mMapVar[index], n, GLboolean(transpose), reinterpret_cast<const GLfloat*>(m)));
+	GL_CHECK(glProgramUniformMatrix3fv(mProgId, mMapVar[index], n, GLboolean(transpose), reinterpret_cast<const GLfloat*>(m)));
 }
 void GpuProgram::set(int index, const glm::vec2& v) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniform2fv(mMapVar[index], 1, &v[0]));
+	GL_CHECK(glProgramUniform2fv(mProgId, mMapVar[index], 1, &v[0]));
 }
 void GpuProgram::set(int index, const glm::vec3& v) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniform3fv(mMapVar[index], 1, &v[0]));
+	GL_CHECK(glProgramUniform3fv(mProgId, mMapVar[index], 1, &v[0]));
 }
 void GpuProgram::set(int index, const glm::vec4& v) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniform4fv(mMapVar[index], 1, &v[0]));
+	GL_CHECK(glProgramUniform4fv(mProgId, mMapVar[index], 1, &v[0]));
 }
 void GpuProgram::set(int index, int n, const glm::vec2* v) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniform2fv(mMapVar[index], n, reinterpret_cast<const GLfloat*>(v)));
+	GL_CHECK(glProgramUniform2fv(mProgId, mMapVar[index], n, reinterpret_cast<const GLfloat*>(v)));
 }
 void GpuProgram::set(int index, int n, const glm::vec3* v) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniform3fv(mMapVar[index], n, reinterpret_cast<const GLfloat*>(v)));
+	GL_CHECK(glProgramUniform3fv(mProgId, mMapVar[index], n, reinterpret_cast<const GLfloat*>(v)));
 }
 void GpuProgram::set(int index, int n, const glm::vec4* v) const
 {
 	assert(index < mMapVar.size());
-	GL_CHECK(glUniform4fv(mMapVar[index], n, reinterpret_cast<const GLfloat*>(v)));
+	GL_CHECK(glProgramUniform4fv(mProgId, mMapVar[index], n, reinterpret_cast<const GLfloat*>(v)));
+}
+void GpuProgram::destroy()
+{
+	for (auto& it : mPermutations)
+	{
+		if (it.second.program)
+		{
+			GL_CHECK(glDeleteProgram(it.second.program));
+		}
+	}
+
+	mPermutations.clear();
+	mProgId = 0xFFFF;
+
+	unwatchSources();
+	mSourceFiles.clear();
 }
-void GpuProgram::use() const
+
+void GpuProgram::watchSources(const std::vector<std::string>& files)
 {
-	assert(mProgId != 0xFFFF);
-	GL_CHECK(glUseProgram(mProgId));
+	bool added = false;
+	for (const std::string& f : files)
+	{
+		if (std::find(mSourceFiles.begin(), mSourceFiles.end(), f) == mSourceFiles.end())
+		{
+			mSourceFiles.push_back(f);
+			added = true;
+		}
+	}
+
+	if ((added || mWatchId == 0) && !mSourceFiles.empty())
+	{
+		unwatchSources();
+		mWatchId = g_fileSystem.watch_files(mSourceFiles, [this]() { reload(); });
+	}
 }
-void GpuProgram::destroy()
+
+void GpuProgram::unwatchSources()
+{
+	if (mWatchId)
+	{
+		g_fileSystem.unwatch(mWatchId);
+		mWatchId = 0;
+	}
+}
+
+// values are per program object, a rebuilt program starts from zero
+static void CopyUniforms(GLuint from, GLuint to)
+{
+	GLint count = 0, maxLen = 0;
+	GL_CHECK(glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count));
+	GL_CHECK(glGetProgramiv(from, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLen));
+
+	std::vector<char> name(size_t(maxLen) + 1);
+
+	for (GLint i = 0; i < count; ++i)
+	{
+		GLint size = 0;
+		GLenum type = 0;
+		GL_CHECK(glGetActiveUniform(from, GLuint(i), GLsizei(name.size()), nullptr, &size, &type, name.data()));
+
+		std::string base = name.data();
+		if (size > 1 && base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+		{
+			base.resize(base.size() - 3);
+		}
+
+		for (GLint e = 0; e < size; ++e)
+		{
+			const std::string elem = size > 1 ? base + "[" + std::to_string(e) + "]" : base;
+
+			GLint src, dst;
+			GL_CHECK(src = glGetUniformLocation(from, elem.c_str()));
+			GL_CHECK(dst = glGetUniformLocation(to, elem.c_str()));
+
+			// block members have no location
+			if (src < 0 || dst < 0) continue;
+
+			GLfloat f[16];
+			GLint n[4];
+			GLuint u[4];
+
+			switch (type)
+			{
+			case GL_FLOAT:		GL_CHECK(glGetUniformfv(from, src, f)); GL_CHECK(glProgramUniform1fv(to, dst, 1, f)); break;
+			case GL_FLOAT_VEC2:	GL_CHECK(glGetUniformfv(from, src, f)); GL_CHECK(glProgramUniform2fv(to, dst, 1, f)); break;
+			case GL_FLOAT_VEC3:	GL_CHECK(glGetUniformfv(from, src, f)); GL_CHECK(glProgramUniform3fv(to, dst, 1, f)); break;
+			case GL_FLOAT_VEC4:	GL_CHECK(glGetUniformfv(from, src, f)); GL_CHECK(glProgramUniform4fv(to, dst, 1, f)); break;
+			case GL_FLOAT_MAT3:	GL_CHECK(glGetUniformfv(from, src, f)); GL_CHECK(glProgramUniformMatrix3fv(to, dst, 1, GL_FALSE, f)); break;
+			case GL_FLOAT_MAT4:	GL_CHECK(glGetUniformfv(from, src, f)); GL_CHECK(glProgramUniformMatrix4fv(to, dst, 1, GL_FALSE, f)); break;
+			case GL_INT_VEC2:	GL_CHECK(glGetUniformiv(from, src, n)); GL_CHECK(glProgramUniform2iv(to, dst, 1, n)); break;
+			case GL_INT_VEC3:	GL_CHECK(glGetUniformiv(from, src, n)); GL_CHECK(glProgramUniform3iv(to, dst, 1, n)); break;
+			case GL_INT_VEC4:	GL_CHECK(glGetUniformiv(from, src, n)); GL_CHECK(glProgramUniform4iv(to, dst, 1, n)); break;
+			case GL_UNSIGNED_INT: GL_CHECK(glGetUniformuiv(from, src, u)); GL_CHECK(glProgramUniform1uiv(to, dst, 1, u)); break;
+			case GL_INT:
+			case GL_BOOL:
+			case GL_SAMPLER_2D:
+			case GL_SAMPLER_3D:
+			case GL_SAMPLER_CUBE:
+			case GL_SAMPLER_2D_SHADOW:
+			case GL_SAMPLER_2D_ARRAY:
+			case GL_IMAGE_2D:
+				GL_CHECK(glGetUniformiv(from, src, n));
+				GL_CHECK(glProgramUniform1iv(to, dst, 1, n));
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	GLint blocks = 0;
+	GL_CHECK(glGetProgramiv(from, GL_ACTIVE_UNIFORM_BLOCKS, &blocks));
+
+	for (GLint i = 0; i < blocks; ++i)
+	{
+		char blockName[256];
+		GLint binding = 0;
+		GL_CHECK(glGetActiveUniformBlockName(from, GLuint(i), sizeof(blockName), nullptr, blockName));
+		GL_CHECK(glGetActiveUniformBlockiv(from, GLuint(i), GL_UNIFORM_BLOCK_BINDING, &binding));
+
+		GLuint index;
+		GL_CHECK(index = glGetUniformBlockIndex(to, blockName));
+		if (index != GL_INVALID_INDEX)
+		{
+			GL_CHECK(glUniformBlockBinding(to, index, GLuint(binding)));
+		}
+	}
+}
+
+bool GpuProgram::reload()
 {
-	if (mProgId != 0xFFFF)
+	if (mSourceFiles.empty())
+	{
+		return false;
+	}
+
+	// every permutation is submitted before any status is read back
+	std::vector<programBuild_t> builds;
+	builds.reserve(mPermutations.size());
+
+	for (auto it = mPermutations.begin(); it != mPermutations.end();)
+	{
+		if (it->second.program == 0)
+		{
+			// failed before, selectPermutation tries it again
+			it = mPermutations.erase(it);
+			continue;
+		}
+
+		builds.emplace_back();
+		startPermutation(it->second.defines, builds.back());
+		++it;
+	}
+
+	bool ok = true;
+	std::vector<GLuint> programs;
+
+	for (programBuild_t& build : builds)
+	{
+		programs.push_back(finishBuild(build));
+		ok = ok && programs.back() != 0;
+	}
+
+	const std::string& name = mComputeFile.empty() ? mFragmentFile : mComputeFile;
+
+	if (!ok)
+	{
+		for (GLuint program : programs)
+		{
+			if (program)
+			{
+				GL_CHECK(glDeleteProgram(program));
+			}
+		}
+
+		Warning("Reload of %s failed, keeping the old program", name.c_str());
+		return false;
+	}
+
+	for (size_t i = 0; i < builds.size(); ++i)
 	{
-		GL_CHECK(glDeleteProgram(mProgId));
-		mProgId = 0xFFFF;
+		permutation_t& perm = mPermutations[builds[i].permutation];
+
+		CopyUniforms(perm.program, programs[i]);
+		GL_CHECK(glDeleteProgram(perm.program));
+
+		perm.program = programs[i];
+		resolveLocations(perm);
+
+		watchSources(builds[i].files);
 	}
+
+	makeCurrent(mCurrentPermutation);
+
+	Info("Reloaded %s, %d permutation(s)", name.c_str(), int(builds.size()));
+
+	return true;
 }
-bool GpuProgram::compileSingleStage(GLuint shaderId, eShaderStage type)
+bool GpuProgram::checkCompileStatus(GLuint shaderId, eShaderStage type)
 {
 	GLint result = GL_FALSE;
 
-	GL_CHECK(glCompileShader(shaderId));
 	GL_CHECK(glGetShaderiv(shaderId, GL_COMPILE_STATUS, &result));
 
 	if (result == GL_FALSE)
@@ -295,12 +663,93 @@ bool GpuProgram::compileSingleStage(GLuint shaderId, eShaderStage type)
 			Error("%s shader compilation failed: %s", sType, logBuf.data());
 		}
 
-		GL_CHECK(glDeleteShader(shaderId));
-
 		return false;
 	}
 
 	return true;
 }
 
+void GpuProgramBatch::init()
+{
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		GL_CHECK(glMaxShaderCompilerThreadsKHR(0xFFFFFFFF));
+		Info("KHR_parallel_shader_compile enabled");
+	}
+	else if (GLEW_ARB_parallel_shader_compile)
+	{
+		GL_CHECK(glMaxShaderCompilerThreadsARB(0xFFFFFFFF));
+		Info("ARB_parallel_shader_compile enabled");
+	}
+}
+
+void GpuProgramBatch::add(GpuProgram& program, const std::string& vertexShader, const std::string& fragmentShader)
+{
+	program.destroy();
+	program.mVertexFile = vertexShader;
+	program.mFragmentFile = fragmentShader;
+	program.mComputeFile.clear();
+
+	m_Pending.push_back({ &program, {} });
+	if (!program.startPermutation({}, m_Pending.back().build))
+	{
+		finish(m_Pending.back());
+		m_Pending.pop_back();
+	}
+}
+
+void GpuProgramBatch::addCompute(GpuProgram& program, const std::string& shader)
+{
+	program.destroy();
+	program.mVertexFile.clear();
+	program.mFragmentFile.clear();
+	program.mComputeFile = shader;
+
+	m_Pending.push_back({ &program, {} });
+	if (!program.startPermutation({}, m_Pending.back().build))
+	{
+		finish(m_Pending.back());
+		m_Pending.pop_back();
+	}
+}
+
+void GpuProgramBatch::finish(pending_t& pending)
+{
+	GpuProgram& program = *pending.program;
+
+	if (!program.addPermutation(pending.build) || !program.makeCurrent(pending.build.permutation))
+	{
+		m_bFailed = true;
+	}
+}
+
+bool GpuProgramBatch::poll()
+{
+	for (size_t i = 0; i < m_Pending.size();)
+	{
+		if (GpuProgram::isBuildComplete(m_Pending[i].build))
+		{
+			finish(m_Pending[i]);
+			m_Pending[i] = std::move(m_Pending.back());
+			m_Pending.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	return m_Pending.empty();
+}
+
+bool GpuProgramBatch::wait()
+{
+	// the status queries in finishBuild block on whatever is still compiling
+	for (pending_t& pending : m_Pending)
+	{
+		finish(pending);
+	}
+	m_Pending.clear();
 
+	return !m_bFailed;
+}
@@ -2,13 +2,33 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <unordered_map>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
 #include "gpu_types.h"
 
+/*
+A program build between issuing its compile and link commands and
+reading their status back, see GpuProgramBatch.
+*/
+struct programBuild_t
+{
+	GLuint program = 0;
+	GLuint shaders[2] = {};
+	eShaderStage stages[2] = {};
+	int numShaders = 0;					// 0 when the binary came from the cache
+	uint64_t cacheKey = 0;
+	uint64_t permutation = 0;
+	std::vector<std::string> defines;
+	std::vector<std::string> files;			// every file read, includes too
+	std::vector<std::string> sourceTable;	// logged when the build fails
+};
+
 class GpuProgram
 {
+	friend class Pipeline;
+	friend class GpuProgramBatch;
 public:
 
 	GpuProgram();
@@ -19,15 +39,25 @@ public:
 	~GpuProgram();
 
 	bool bindUniformBlock(const std::string& name, int index);
+	// files go through Shader_Preprocess, the permutation without defines is built right away
 	bool loadShader(const std::string& vertexShader, const std::string& fragmentShader);
 	bool loadComputeShader(const std::string& shader);
 
+	/*
+	Makes the permutation with the given defines current, compiling it on
+	first use. Uniform locations mapped so far are resolved for it, but
+	uniform values belong to the permutation and have to be set again.
+	*/
+	bool selectPermutation(const std::vector<std::string>& defines);
+
 	bool createProgramFromShaderSource(const std::vector<const char*>& vert_sources, const std::vector<const char*>& frag_sources);
 	bool createComputeProgramFromShaderSource(const std::vector<const char*>&  sources);
 
 	int getLocation(const std::string& name) const;
 	bool mapLocationToIndex(const std::string& name, const int index);
 
+	// glProgramUniform*: the program does not have to be bound
+
 	void set(int index, float f) const;
 	void set(int index, int n, const float* f) const;
 	void set(int index, int i) const;
@@ -42,13 +72,86 @@ public:
 	void set(int index, int n, const glm::vec3* v) const;
 	void set(int index, int n, const glm::vec4* v) const;
 
-	void use() const;
 	void destroy();
 
+	/*
+	Rebuilds every permutation from the files, called by the file watcher
+	when one of them changes. The new programs replace the old ones only
+	if all of them built, uniform values and block bindings are carried
+	over. Runs from FileSystem::poll_watches(), before Pipeline::beginFrame()
+	so the bind cache does not see a recycled name.
+	*/
+	bool reload();
+
 private:
+	struct permutation_t
+	{
+		GLuint program;					// 0 when it failed to build
+		std::vector<GLint> locations;
+		std::vector<std::string> defines;
+	};
+
 	GLuint programId() const { return mProgId; }
 	GLuint createShaderInternal(eShaderStage stage, const std::vector<const char*>& sources);
-	bool compileSingleStage(GLuint shaderId, eShaderStage type);
+	bool checkCompileStatus(GLuint shaderId, eShaderStage type);
+	void startBuild(int numStages, const eShaderStage* stages, const std::vector<const char*>* sources, programBuild_t& build);
+	bool startPermutation(const std::vector<std::string>& defines, programBuild_t& build);
+	static bool isBuildComplete(const programBuild_t& build);
+	GLuint finishBuild(programBuild_t& build);
+	bool addPermutation(programBuild_t& build);
+	bool makeCurrent(uint64_t key);
+	void resolveLocations(permutation_t& perm) const;
+	void watchSources(const std::vector<std::string>& files);
+	void unwatchSources();
+
 	GLuint mProgId;
 	std::vector<GLint> mMapVar;
+	std::vector<std::string> mMapNames;
+
+	std::string mVertexFile;
+	std::string mFragmentFile;
+	std::string mComputeFile;
+	std::unordered_map<uint64_t, permutation_t> mPermutations;
+	uint64_t mCurrentPermutation;
+
+	std::vector<std::string> mSourceFiles;
+	int mWatchId;
+};
+
+/*
+Builds many programs at once: add() preprocesses the sources and issues
+every compile and link without reading anything back, so with
+KHR_parallel_shader_compile the driver works on them in its own threads
+while poll() checks GL_COMPLETION_STATUS_KHR. Without the extension
+each program simply completes on the first poll.
+*/
+class GpuProgramBatch
+{
+public:
+	GpuProgramBatch() : m_bFailed(false) {}
+	~GpuProgramBatch() { wait(); }
+
+	// the program is usable once poll() or wait() returned true
+	void add(GpuProgram& program, const std::string& vertexShader, const std::string& fragmentShader);
+	void addCompute(GpuProgram& program, const std::string& shader);
+
+	// never blocks; true when nothing is pending, see failed()
+	bool poll();
+	// blocks until every build finished, false if any of them failed
+	bool wait();
+	bool failed() const { return m_bFailed; }
+
+	// asks the driver for as many compiler threads as it likes, once after glewInit
+	static void init();
+private:
+	struct pending_t
+	{
+		GpuProgram* program;
+		programBuild_t build;
+	};
+
+	void finish(pending_t& pending);
+
+	std::vector<pending_t> m_Pending;
+	bool m_bFailed;
 };
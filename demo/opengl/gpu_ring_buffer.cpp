@@ -0,0 +1,161 @@
+#include <cassert>
+#include <algorithm>
+#include "gpu_utils.h"
+#include "logger.h"
+#include "frame_scheduler.h"
+#include "gpu_ring_buffer.h"
+
+static uint32_t GL_getOffsetAlignment(eGpuBufferTarget target)
+{
+	GLint align = 16;
+
+	switch (target)
+	{
+	case eGpuBufferTarget::UNIFORM:
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+		break;
+	case eGpuBufferTarget::STORAGE:
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+		break;
+	default:
+		break;
+	}
+
+	return uint32_t(std::max(align, 16));
+}
+
+GpuRingBuffer::GpuRingBuffer(eGpuBufferTarget target) :
+	m_Buffer(target),
+	m_Base(),
+	m_FrameSize(),
+	m_Alignment(16),
+	m_Head(),
+	m_Stalls(),
+	m_Frame(),
+	m_NumFrames(),
+	m_bScheduled(false)
+{
+}
+
+GpuRingBuffer::~GpuRingBuffer()
+{
+	for (GLsync fence : m_Fences)
+	{
+		if (fence) glDeleteSync(fence);
+	}
+}
+
+bool GpuRingBuffer::create(uint32_t frameSize, int numFrames)
+{
+	assert(numFrames >= 0);
+
+	if (m_Base)
+	{
+		return false;
+	}
+
+	m_bScheduled = numFrames == 0;
+	if (m_bScheduled)
+	{
+		// before init() the scheduler reports one slot and fences nothing, the region would be overwritten in use
+		assert(g_frameScheduler.isInitialized());
+		if (!g_frameScheduler.isInitialized())
+		{
+			Error("GpuRingBuffer: numFrames 0 needs an initialized g_frameScheduler");
+			return false;
+		}
+		numFrames = g_frameScheduler.getFramesInFlight();
+	}
+
+	m_Alignment = GL_getOffsetAlignment(m_Buffer.mTarget);
+	m_FrameSize = (frameSize + m_Alignment - 1) / m_Alignment * m_Alignment;
+
+	if (!m_Buffer.create(m_FrameSize * numFrames, eGpuBufferUsage::DYNAMIC, BA_MAP_WRITE | BA_MAP_PERSISTENT | BA_MAP_COHERENT))
+	{
+		Error("GpuRingBuffer: cannot allocate %d x %u bytes", numFrames, m_FrameSize);
+		return false;
+	}
+
+	m_Base = m_Buffer.mapPeristentWrite();
+	if (!m_Base)
+	{
+		return false;
+	}
+
+	m_Fences.assign(m_bScheduled ? 0 : numFrames, nullptr);
+	m_NumFrames = numFrames;
+	m_Frame = 0;
+	m_Head = 0;
+
+	Info("GpuRingBuffer: %d frames x %u bytes, alignment %u", numFrames, m_FrameSize, m_Alignment);
+
+	return true;
+}
+
+void GpuRingBuffer::beginFrame()
+{
+	m_Head = 0;
+
+	if (m_bScheduled)
+	{
+		m_Frame = g_frameScheduler.getSlot();
+		return;
+	}
+
+	m_Frame = (m_Frame + 1) % m_NumFrames;
+
+	GLsync& fence = m_Fences[m_Frame];
+	if (!fence)
+	{
+		return;
+	}
+
+	GLenum res = glClientWaitSync(fence, 0, 0);
+	if (res == GL_TIMEOUT_EXPIRED)
+	{
+		++m_Stalls;
+		do
+		{
+			res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (res == GL_TIMEOUT_EXPIRED);
+	}
+
+	if (res == GL_WAIT_FAILED)
+	{
+		Error("GpuRingBuffer: glClientWaitSync failed");
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void GpuRingBuffer::endFrame()
+{
+	if (m_bScheduled)
+	{
+		return;
+	}
+
+	GLsync& fence = m_Fences[m_Frame];
+	if (fence)
+	{
+		glDeleteSync(fence);
+	}
+	GL_CHECK(fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+uint8_t* GpuRingBuffer::alloc(uint32_t size, uint32_t& offset)
+{
+	assert(m_Base);
+
+	if (m_Head + size > m_FrameSize)
+	{
+		Warning("GpuRingBuffer: frame region full, %u of %u bytes used", m_Head, m_FrameSize);
+		return nullptr;
+	}
+
+	offset = uint32_t(m_Frame) * m_FrameSize + m_Head;
+	m_Head = (m_Head + size + m_Alignment - 1) / m_Alignment * m_Alignment;
+
+	return m_Base + offset;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cinttypes>
+#include <vector>
+
+#include "gpu_types.h"
+#include "gpu_buffer.h"
+
+/*
+One persistently mapped buffer split into numFrames regions. The CPU
+fills the region of frame N while the GPU still reads the older ones;
+endFrame() fences the region, beginFrame() waits on the fence of the
+region it is about to reuse, which only blocks when the CPU runs
+numFrames ahead.
+
+Created with numFrames = 0 the buffer has one region per
+g_frameScheduler slot and uses the slot as the region index; the
+scheduler's fence already guards the region, the ring keeps none.
+
+Allocations are aligned to the target's binding offset alignment
+(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for UNIFORM), offsets are from the
+start of the whole buffer and go straight into bindIndexed or
+GpuBuffer::bindVertexBuffer.
+*/
+class GpuRingBuffer
+{
+public:
+	GpuRingBuffer(eGpuBufferTarget target = eGpuBufferTarget::UNIFORM);
+	GpuRingBuffer(const GpuRingBuffer&) = delete;
+	GpuRingBuffer& operator=(const GpuRingBuffer&) = delete;
+	~GpuRingBuffer();
+
+	// numFrames 0 follows g_frameScheduler, fails when it is not initialized
+	bool create(uint32_t frameSize, int numFrames = 0);
+
+	void beginFrame();
+	void endFrame();
+
+	// nullptr when the frame region is full
+	uint8_t* alloc(uint32_t size, uint32_t& offset);
+
+	template<class T>
+	T* alloc(uint32_t& offset) { return reinterpret_cast<T*>(alloc(uint32_t(sizeof(T)), offset)); }
+
+	void bindIndexed(uint32_t index, uint32_t offset, uint32_t size) { m_Buffer.bindIndexed(index, offset, size); }
+
+	GpuBuffer& getBuffer() { return m_Buffer; }
+	uint32_t getAlignment() const { return m_Alignment; }
+	uint32_t getFrameSize() const { return m_FrameSize; }
+	uint32_t getFrameUsed() const { return m_Head; }
+	// number of beginFrame() calls that had to wait for the GPU
+	uint32_t getStalls() const { return m_Stalls; }
+private:
+	GpuBuffer m_Buffer;
+	uint8_t* m_Base;
+	uint32_t m_FrameSize;
+	uint32_t m_Alignment;
+	uint32_t m_Head;
+	uint32_t m_Stalls;
+	int m_Frame;
+	int m_NumFrames;
+	bool m_bScheduled;
+	std::vector<GLsync> m_Fences;
+};
@@ -1,7 +1,13 @@
+#include <cmath>
 #include <utility>
+#include <algorithm>
 #include <cassert>
 #include <SOIL2.h>
 #include "logger.h"
+#include "filesystem.h"
+#include "texture_file.h"
+#include "texture_compressor.h"
+#include "mip_builder.h"
 #include "gpu_utils.h"
 #include "gpu_texture.h"
 
@@ -121,12 +127,12 @@ void GpuTexture::updateParameters()
 {
     for (auto& p : mIntParams)
     {
-        GL_CHECK(glTexParameteri(getApiTarget(), p.first, p.second));
+        GL_CHECK(glTextureParameteri(mTexture, p.first, p.second));
     }
 
     for (auto& p : mFloatParams)
     {
-        GL_CHECK(glTexParameterf(getApiTarget(), p.first, p.second));
+        GL_CHECK(glTextureParameterf(mTexture, p.first, p.second));
     }
 
     mIntParams.clear();
@@ -140,7 +146,7 @@ void GpuTexture::selectUnit(int unit) const
 
 void GpuTexture::generateMipMaps() const
 {
-    GL_CHECK(glGenerateMipmap(getApiTarget()));
+    GL_CHECK(glGenerateTextureMipmap(mTexture));
 }
 
 void GpuTexture::getDimensions(unsigned int& w, unsigned int& h, unsigned int& d)
@@ -170,8 +176,13 @@ bool GpuTexture2D::create(int w, int h, int level, eTextureFormat internalFormat
     return true;
 }
 
-bool GpuTexture2D::createFromImage(const std::string& fromFile, bool srgb, bool autoMipmap, bool compress)
+bool GpuTexture2D::createFromImage(const std::string& fromFile, bool srgb, bool autoMipmap, bool compress, eTextureEncoder encoder)
 {
+    if (compress && encoder == eTextureEncoder::BC_SIMD)
+    {
+        return createCompressedFromImage(fromFile, srgb, autoMipmap);
+    }
+
     GLuint texID = mTexture != INVALID_TEXTURE ? mTexture : SOIL_CREATE_NEW_ID;
     unsigned int flags = 0;
     if (autoMipmap)
@@ -194,6 +205,232 @@ bool GpuTexture2D::createFromImage(const std::string& fromFile, bool srgb, bool
 
 }
 
+bool GpuTexture2D::createCompressedFromImage(const std::string& fromFile, bool srgb, bool autoMipmap)
+{
+    int w, h, channels;
+    unsigned char* pixels = SOIL_load_image(fromFile.c_str(), &w, &h, &channels, SOIL_LOAD_RGBA);
+    if (!pixels)
+    {
+        Error("%s: %s", fromFile.c_str(), SOIL_last_result());
+        return false;
+    }
+
+    const eBlockFormat format = BC_HasAlpha(pixels, w, h) ? BF_BC3 : BF_BC1;
+    const GLenum glFormat = format == BF_BC3
+        ? (srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        : (srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+
+    std::vector<mipLevel_t> levels;
+    if (autoMipmap)
+    {
+        mipSettings_t settings;
+        settings.srgb = srgb;
+        Mip_BuildChain(pixels, w, h, settings, levels);
+    }
+    else
+    {
+        levels.push_back({ w, h, std::vector<uint8_t>(pixels, pixels + size_t(w) * h * 4) });
+    }
+    SOIL_free_image_data(pixels);
+
+    if (mTexture == INVALID_TEXTURE) GL_CHECK(glGenTextures(1, &mTexture));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, mTexture));
+
+    std::vector<uint8_t> blocks;
+    const int numLevels = int(levels.size());
+
+    for (int i = 0; i < numLevels; ++i)
+    {
+        const mipLevel_t& level = levels[i];
+        blocks.resize(BC_CompressedSize(format, level.width, level.height));
+        BC_Compress(format, level.rgba.data(), level.width, level.height, blocks.data());
+        GL_CHECK(glCompressedTexImage2D(GL_TEXTURE_2D, i, glFormat, level.width, level.height, 0, GLsizei(blocks.size()), blocks.data()));
+    }
+
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+    GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+
+    m_width = unsigned(w);
+    m_height = unsigned(h);
+    m_depth = 1;
+
+    return true;
+}
+
+static GLenum GL_castDxgiFormat(uint32_t dxgiFormat)
+{
+    switch (dxgiFormat)
+    {
+    case DXGI_FORMAT_BC1_UNORM:         return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case DXGI_FORMAT_BC1_UNORM_SRGB:    return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+    case DXGI_FORMAT_BC3_UNORM:         return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case DXGI_FORMAT_BC3_UNORM_SRGB:    return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    case DXGI_FORMAT_BC4_UNORM:         return GL_COMPRESSED_RED_RGTC1;
+    case DXGI_FORMAT_BC5_UNORM:         return GL_COMPRESSED_RG_RGTC2;
+    }
+
+    return GL_NONE;
+}
+
+static uint32_t DDS_FourCCToDxgi(uint32_t fourCC)
+{
+    switch (fourCC)
+    {
+    case DDS_FOURCC_DXT1:   return DXGI_FORMAT_BC1_UNORM;
+    case DDS_FOURCC_DXT5:   return DXGI_FORMAT_BC3_UNORM;
+    case DDS_FOURCC_ATI1:   return DXGI_FORMAT_BC4_UNORM;
+    case DDS_FOURCC_ATI2:   return DXGI_FORMAT_BC5_UNORM;
+    }
+
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+bool DDS_Parse(const uint8_t* data, size_t size, const std::string& fileName, cookedTexture_t& info)
+{
+    const ddsHeader_t* header = reinterpret_cast<const ddsHeader_t*>(data);
+
+    if (size < sizeof(ddsHeader_t) || header->magic != DDS_MAGIC || header->size != sizeof(ddsHeader_t) - 4)
+    {
+        Error("%s: not a DDS file", fileName.c_str());
+        return false;
+    }
+
+    size_t offset = sizeof(ddsHeader_t);
+    uint32_t dxgiFormat = DXGI_FORMAT_UNKNOWN;
+    bool cube = false;
+
+    if ((header->pixelFormat.flags & DDPF_FOURCC) && header->pixelFormat.fourCC == DDS_FOURCC_DX10)
+    {
+        const ddsHeaderDX10_t* dx10 = reinterpret_cast<const ddsHeaderDX10_t*>(data + offset);
+        offset += sizeof(ddsHeaderDX10_t);
+
+        if (size < offset || dx10->resourceDimension != DDS_DIMENSION_TEXTURE2D || dx10->arraySize > 1)
+        {
+            Error("%s: only single 2D and cube DDS textures are supported", fileName.c_str());
+            return false;
+        }
+        dxgiFormat = dx10->dxgiFormat;
+        cube = (dx10->miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+    }
+    else if (header->pixelFormat.flags & DDPF_FOURCC)
+    {
+        dxgiFormat = DDS_FourCCToDxgi(header->pixelFormat.fourCC);
+        cube = (header->caps2 & DDSCAPS2_CUBEMAP) != 0;
+
+        if (cube && (header->caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES)
+        {
+            Error("%s: cube maps need all 6 faces", fileName.c_str());
+            return false;
+        }
+    }
+
+    info.format = GL_castDxgiFormat(dxgiFormat);
+    info.blockBytes = DDS_BlockBytes(dxgiFormat);
+
+    if (info.format == GL_NONE || info.blockBytes == 0)
+    {
+        Error("%s: unsupported DDS pixel format", fileName.c_str());
+        return false;
+    }
+
+    if (header->width == 0 || header->height == 0 || header->width > 16384 || header->height > 16384)
+    {
+        Error("%s: bad size %ux%u", fileName.c_str(), header->width, header->height);
+        return false;
+    }
+
+    info.width = header->width;
+    info.height = header->height;
+    info.numFaces = cube ? 6 : 1;
+    info.dataOffset = offset;
+
+    // a corrupt count would make GL calls for levels that cannot exist
+    const uint32_t maxLevels = 1 + uint32_t(std::floor(std::log2(float(std::max(info.width, info.height)))));
+    info.numLevels = (header->flags & DDSD_MIPMAPCOUNT) ? std::max(header->mipMapCount, 1u) : 1u;
+    if (info.numLevels > maxLevels)
+    {
+        Warning("%s: %u mip levels, %ux%u has %u", fileName.c_str(), info.numLevels, info.width, info.height, maxLevels);
+        info.numLevels = maxLevels;
+    }
+
+    info.faceSize = 0;
+    for (uint32_t level = 0; level < info.numLevels; ++level)
+    {
+        info.faceSize += DDS_LevelSize(std::max(info.width >> level, 1u), std::max(info.height >> level, 1u), info.blockBytes);
+    }
+
+    if (offset + info.faceSize * info.numFaces > size)
+    {
+        Error("%s: truncated, %u faces of %u levels do not fit", fileName.c_str(), info.numFaces, info.numLevels);
+        return false;
+    }
+
+    return true;
+}
+
+// to the texture bound on target, every face and level in file order
+static void DDS_Upload(GLenum target, const cookedTexture_t& info, const uint8_t* data)
+{
+    const uint8_t* src = data + info.dataOffset;
+
+    for (uint32_t face = 0; face < info.numFaces; ++face)
+    {
+        const GLenum faceTarget = target == GL_TEXTURE_CUBE_MAP ? GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face) : target;
+        uint32_t w = info.width;
+        uint32_t h = info.height;
+
+        for (uint32_t level = 0; level < info.numLevels; ++level)
+        {
+            const uint32_t levelSize = DDS_LevelSize(w, h, info.blockBytes);
+
+            GL_CHECK(glCompressedTexImage2D(faceTarget, GLint(level), info.format, GLsizei(w), GLsizei(h), 0, GLsizei(levelSize), src));
+
+            src += levelSize;
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+        }
+    }
+
+    GL_CHECK(glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0));
+    GL_CHECK(glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, GLint(info.numLevels - 1)));
+    GL_CHECK(glTexParameteri(target, GL_TEXTURE_MIN_FILTER, info.numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+    GL_CHECK(glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+}
+
+bool GpuTexture2D::createFromCooked(const std::string& fromFile)
+{
+    MappedFile::Ptr file = g_fileSystem.map_binary_file(fromFile);
+    if (!file)
+    {
+        return false;
+    }
+
+    cookedTexture_t info;
+    if (!DDS_Parse(file->data(), file->size(), fromFile, info))
+    {
+        return false;
+    }
+
+    if (info.numFaces != 1)
+    {
+        Error("%s: a cube map, not a 2D texture", fromFile.c_str());
+        return false;
+    }
+
+    if (mTexture == INVALID_TEXTURE) GL_CHECK(glGenTextures(1, &mTexture));
+    GL_CHECK(glBindTexture(GL_TEXTURE_2D, mTexture));
+
+    DDS_Upload(GL_TEXTURE_2D, info, file->data());
+
+    m_width = info.width;
+    m_height = info.height;
+    m_depth = 1;
+
+    return true;
+}
+
 bool GpuTexture2D::createRGB(int w, int h, int level)
 {
     return createRGB8(w, h, level);
@@ -340,6 +577,38 @@ bool GpuTextureCubeMap::createFromImage(const std::vector<std::string>& fromFile
     return texID != 0;
 }
 
+bool GpuTextureCubeMap::createFromCooked(const std::string& fromFile)
+{
+    MappedFile::Ptr file = g_fileSystem.map_binary_file(fromFile);
+    if (!file)
+    {
+        return false;
+    }
+
+    cookedTexture_t info;
+    if (!DDS_Parse(file->data(), file->size(), fromFile, info))
+    {
+        return false;
+    }
+
+    if (info.numFaces != 6 || info.width != info.height)
+    {
+        Error("%s: not a cube map", fromFile.c_str());
+        return false;
+    }
+
+    if (mTexture == INVALID_TEXTURE) GL_CHECK(glGenTextures(1, &mTexture));
+    GL_CHECK(glBindTexture(GL_TEXTURE_CUBE_MAP, mTexture));
+
+    DDS_Upload(GL_TEXTURE_CUBE_MAP, info, file->data());
+
+    m_width = info.width;
+    m_height = info.height;
+    m_depth = 1;
+
+    return true;
+}
+
 void GpuTextureCubeMap::bind() const
 {
     GL_CHECK(glBindTexture(GL_TEXTURE_CUBE_MAP, mTexture));
@@ -2,6 +2,7 @@
 
 #include <GL/glew.h>
 #include <cinttypes>
+#include <string>
 #include <utility>
 #include <vector>
 #include <functional>
@@ -19,6 +20,7 @@ class GpuTexture
 {
 	friend class GpuFrameBuffer;
 	friend class Pipeline;
+	friend class AssetManager;
 public:
 	GpuTexture() :
 		mTexture(INVALID_TEXTURE),
@@ -27,8 +29,6 @@ public:
 		m_depth() {}
 	STD_TEXTURE_METHODS(GpuTexture)
 
-	virtual void bind() const = 0;
-	virtual void bind(int unit) const = 0;
 	//	virtual void bindImage(int unit, int level, bool layered, int layer, eImageAccess access, eImageFormat format) = 0;
 	virtual eTextureTarget getTarget() const = 0;
 	GpuTexture& withMinFilter(eTexMinFilter p);
@@ -47,6 +47,9 @@ public:
 	unsigned int textureID() const { return mTexture; }
 	void getDimensions(unsigned int& w, unsigned int& h, unsigned int& d);
 protected:
+	// Pipeline::bindTexture() keeps the bind cache, nothing else binds
+	virtual void bind() const = 0;
+	virtual void bind(int unit) const = 0;
 	virtual GLenum getApiTarget() const = 0;
 
 	GLuint mTexture;
@@ -72,7 +75,9 @@ public:
 	STD_TEXTURE_METHODS(GpuTexture2D)
 
 	bool create(int w, int h, int level, eTextureFormat internalFormat, ePixelFormat format, eDataType type, const void* data);
-	bool createFromImage(const std::string& fromFile, bool srgb = false, bool autoMipmap = true, bool compress = true);
+	bool createFromImage(const std::string& fromFile, bool srgb = false, bool autoMipmap = true, bool compress = true, eTextureEncoder encoder = eTextureEncoder::BC_SIMD);
+	// block compressed DDS written by texture_cook (see texture_file.h), mips come from the file
+	bool createFromCooked(const std::string& fromFile);
 	bool createRGB(int w, int h, int level);
 	bool createRGB8(int w, int h, int level);
 	bool createRGB8S(int w, int h, int level);
@@ -87,15 +92,16 @@ public:
 	bool createR11G11B10(int w, int h, int level);
 	bool createDepthStencil(int w, int h);
 	eTextureTarget getTarget() const override { return eTextureTarget::TEX_2D; }
-	void bind() const override;
-	void bind(int unit) const override;
 	void bindImage(int unit, int level, eImageAccess access, eImageFormat format);
 
 	static GpuTexture2D::Ptr createShared();
 
 protected:
+	void bind() const override;
+	void bind(int unit) const override;
 	inline GLenum getApiTarget() const override { return GL_TEXTURE_2D; };
-
+	// BC1/BC3 through texture_compressor.h, mips from mip_builder.h
+	bool createCompressedFromImage(const std::string& fromFile, bool srgb, bool autoMipmap);
 };
 
 class GpuTextureCubeMap : public GpuTexture
@@ -110,12 +116,34 @@ public:
 	STD_TEXTURE_METHODS(GpuTextureCubeMap)
 
 	bool createFromImage(const std::vector<std::string>& fromFile, bool srgb = false, bool autoMipmap = false, bool compress = true);
+	// cube map DDS written by texture_cook -cube, mips come from the file
+	bool createFromCooked(const std::string& fromFile);
 
 	eTextureTarget getTarget() const override { return eTextureTarget::TEX_CUBE_MAP; }
-	void bind() const override;
-	void bind(int unit) const override;
 	void bindImage(int unit, int level, bool layered, int layer, eImageAccess access, eImageFormat format);
 protected:
+	void bind() const override;
+	void bind(int unit) const override;
 	inline GLenum getApiTarget() const override { return GL_TEXTURE_CUBE_MAP; };
 
-};
\ No newline at end of file
+};
+
+/*
+Layout of a cooked texture (see texture_file.h) checked by DDS_Parse:
+every level of every face lies inside the file, numLevels is clamped to
+the chain width x height can have.
+*/
+struct cookedTexture_t
+{
+	GLenum format;			// compressed GL internal format
+	uint32_t width;
+	uint32_t height;
+	uint32_t numLevels;
+	uint32_t numFaces;		// 1, or 6 for a cube map
+	uint32_t blockBytes;
+	size_t dataOffset;		// face 0 level 0
+	size_t faceSize;		// every level of one face
+};
+
+// false with an Error naming fileName when the file cannot be used
+bool DDS_Parse(const uint8_t* data, size_t size, const std::string& fileName, cookedTexture_t& info);
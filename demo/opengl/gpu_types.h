@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cinttypes>
+
 #define INVALID_BUFFER 0xFFFF
 #define INVALID_TEXTURE 0xFFFF
 
@@ -19,6 +21,8 @@ enum class eTexMagFilter { NEAREST, LINEAR };
 enum class eTexWrap { CLAMP_TO_BORDER, MIRRORED_REPEAT, REPEAT, MIRROR_CLAMP_TO_EDGE, CLAMP_TO_EDGE };
 enum class eImageAccess { READ_ONLY, WRITE_ONLY, READ_WRITE };
 enum class eImageFormat { RGBA32F, RGBA16F, RGBA8 };
+// block compressor behind createFromImage(..., compress = true)
+enum class eTextureEncoder { SOIL, BC_SIMD };
 /*
 GPU Shader related types
 */
@@ -28,7 +32,7 @@ enum class eShaderStage { VERTEX, FRAGMENT, GEOMETRY, TESS_CONTROL, TESS_EVALUAT
 GPU Buffer related types
 */
 
-enum class eGpuBufferTarget { VERTEX, INDEX, UNIFORM, ENUM_SIZE };
+enum class eGpuBufferTarget { VERTEX, INDEX, UNIFORM, INDIRECT, STORAGE, PIXEL_UNPACK, ENUM_SIZE };
 enum class eGpuBufferUsage { STATIC, DYNAMIC, DEFAULT };
 enum eGpuBufferAccess { BA_DYNAMIC = 1, BA_MAP_READ = 2, BA_MAP_WRITE = 4, BA_MAP_PERSISTENT = 8, BA_MAP_COHERENT = 16 };
 
@@ -36,4 +40,14 @@ enum eGpuBufferAccess { BA_DYNAMIC = 1, BA_MAP_READ = 2, BA_MAP_WRITE = 4, BA_MA
 Drawing related types
 */
 
-enum class eDrawMode { POINTS, LINE_STRIP, LINE_LOOP, LINES, TRIANGLE_STRIP, TRIANGLE_FAN, TRIANGLES };
\ No newline at end of file
+enum class eDrawMode { POINTS, LINE_STRIP, LINE_LOOP, LINES, TRIANGLE_STRIP, TRIANGLE_FAN, TRIANGLES };
+
+// layout fixed by glMultiDrawElementsIndirect
+struct drawElementsIndirectCommand_t
+{
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
\ No newline at end of file
@@ -55,21 +55,21 @@ GLint GL_castTextureFormat(eTextureFormat f)
     case eTextureFormat::DEPTH24_STENCIL_8:
         return GL_DEPTH24_STENCIL8;
     case eTextureFormat::R:
-        return GL_R;
+        return GL_R8;
     case eTextureFormat::R16:
         return GL_R16;
     case eTextureFormat::R16F:
         return GL_R16F;
     case eTextureFormat::RG:
-        return GL_RG;
+        return GL_RG8;
     case eTextureFormat::RG16:
         return GL_RG16;
     case eTextureFormat::RG16F:
         return GL_RG16F;
     case eTextureFormat::RGB:
-        return GL_RGB;
+        return GL_RGB8;
     case eTextureFormat::RGBA:
-        return GL_RGBA;
+        return GL_RGBA8;
     case eTextureFormat::RGBA16F:
         return GL_RGBA16F;
     case eTextureFormat::RGB10A2:
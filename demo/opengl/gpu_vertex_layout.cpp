@@ -42,19 +42,26 @@ VertexLayout& VertexLayout::with(unsigned int index, unsigned int size, eDataTyp
     return *this;
 }
 
-void VertexLayout::end() const
+VertexLayout& VertexLayout::withInstanced(unsigned int index, unsigned int size, eDataType type, unsigned int stride, unsigned int divisor, GpuBuffer* target)
 {
-    GL_CHECK(glBindVertexArray(0));
-    for (int i = 0; i < m_numAttribs; ++i)
+    glEnableVertexAttribArray(index);
+    if (m_lastBuffer != target)
     {
-        GL_CHECK(glDisableVertexAttribArray(i));
+        m_lastBuffer = target;
+        target->bind();
     }
+    glVertexAttribIPointer(index, size, GL_castDataType(type), stride, nullptr);
+    glVertexAttribDivisor(index, divisor);
+    ++m_numAttribs;
+
+    return *this;
 }
 
-void VertexLayout::bind() const
+void VertexLayout::end() const
 {
-    if (m_vao)
+    GL_CHECK(glBindVertexArray(0));
+    for (int i = 0; i < m_numAttribs; ++i)
     {
-        GL_CHECK(glBindVertexArray(m_vao));
+        GL_CHECK(glDisableVertexAttribArray(i));
     }
 }
@@ -48,8 +48,19 @@ struct VertexLayout
 		unsigned int stride,
 		GpuBuffer* target);
 
+	/*
+	Integer attribute advancing once per divisor instances, e.g. a draw id
+	picked up through the baseInstance of indirect draws.
+	*/
+	VertexLayout& withInstanced(
+		unsigned int index,
+		unsigned int size,
+		eDataType type,
+		unsigned int stride,
+		unsigned int divisor,
+		GpuBuffer* target);
+
 	void end() const;
-	void bind() const;
 
 	GLuint m_vao{0};	// vertex array object
 	int m_numAttribs;
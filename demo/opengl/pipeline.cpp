@@ -1,11 +1,26 @@
+#include <cassert>
+#include <cstring>
 #include <SDL.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
+#include "gpu_program.h"
+#include "gpu_texture.h"
+#include "gpu_framebuffer.h"
+#include "gpu_vertex_layout.h"
 #include "pipeline.h"
 
-Pipeline::Pipeline()
+// shadow value no GL object name can match, forces the next bind
+static const GLuint GL_UNKNOWN_BINDING = ~0u;
+
+Pipeline::Pipeline() :
+	m_constantBuffer(eGpuBufferTarget::UNIFORM),
+	m_constantOffsets(),
+	m_worldPosition(0.0f),
+	m_worldScale(1.0f),
+	m_worldRotation(1.0f, 0.0f, 0.0f, 0.0f),
+	m_worldEulerAngles(0.0f)
 {
 	g_misc.f_time = SDL_static_cast(float, SDL_GetTicks64());
 	g_misc.i_screen_x = 1920;
@@ -23,18 +38,14 @@ Pipeline::Pipeline()
 	g_cam.v_up = glm::vec4(0, 1, 0, 0);
 	g_cam.v_near_far_fov = glm::vec4(0.01, 100.0, 45.0f, 0.0f);
 
-	m_activeArrayBuffer = 0;
-	m_activeElementBuffer = 0;
-	m_activeVertexArray = 0;
-	m_activeFrameBuffer = 0;
+	m_glStateBits = 0;
 	_polyOfsBias = 0.0f;
 	_polyOfsScale = 0.0f;
 
-	for (int i = 0; i < MAX_TEXTURE_UNITS; ++i)
-	{
-		m_tmus[i].target = 0;
-		m_tmus[i].texId = 0;
-	}
+	m_callStats = {};
+	m_lastCallStats = {};
+
+	invalidateState();
 }
 
 
@@ -50,9 +61,12 @@ void Pipeline::setState(uint64_t stateBits, bool forceGlState)
 	}
 	else if (diff == 0)
 	{
+		++m_callStats.stateSkipped;
 		return;
 	}
 
+	++m_callStats.stateIssued;
+
 	//
 	// culling
 	//
@@ -427,17 +441,128 @@ void Pipeline::bindVertexBuffer(GpuBuffer& b, int index)
 		{
 			b.bind();
 			m_activeArrayBuffer = b.mBuffer;
+			++m_callStats.bufferIssued;
+		}
+		else
+		{
+			++m_callStats.bufferSkipped;
 		}
 	}
 }
 
-void Pipeline::bindIndexBuffer(GpuBuffer& b)
+void Pipeline::bindIndexBuffer(const GpuBuffer& b)
 {
 	if (m_activeElementBuffer != b.mBuffer)
 	{
 		b.bind();
 		m_activeElementBuffer = b.mBuffer;
+		++m_callStats.bufferIssued;
+	}
+	else
+	{
+		++m_callStats.bufferSkipped;
+	}
+}
+
+void Pipeline::bindProgram(const GpuProgram* prg)
+{
+	const GLuint id = prg ? prg->mProgId : 0;
+
+	if (id == m_activeProgram)
+	{
+		++m_callStats.programSkipped;
+		return;
 	}
+
+	GL_CHECK(glUseProgram(id));
+	m_activeProgram = id;
+	++m_callStats.programIssued;
+}
+
+void Pipeline::bindTexture(int unit, const GpuTexture* tex)
+{
+	assert(unit >= 0 && unit < MAX_TEXTURE_UNITS);
+
+	tmu_t& tmu = m_tmus[unit];
+	const GLuint id = tex ? tex->mTexture : 0;
+	const GLuint target = tex ? tex->getApiTarget() : tmu.target;
+
+	if (tmu.texId == id && tmu.target == target)
+	{
+		++m_callStats.textureSkipped;
+		return;
+	}
+
+	if (tex)
+	{
+		tex->bind(unit);
+	}
+	else
+	{
+		GL_CHECK(glBindTextureUnit(unit, 0));
+	}
+
+	tmu.texId = id;
+	tmu.target = target;
+	++m_callStats.textureIssued;
+}
+
+void Pipeline::bindVertexArray(const VertexLayout* layout)
+{
+	const GLuint id = layout ? layout->m_vao : 0;
+
+	if (id == m_activeVertexArray)
+	{
+		++m_callStats.vaoSkipped;
+		return;
+	}
+
+	GL_CHECK(glBindVertexArray(id));
+	m_activeVertexArray = id;
+	// the element array binding belongs to the VAO
+	m_activeElementBuffer = GL_UNKNOWN_BINDING;
+	++m_callStats.vaoIssued;
+}
+
+void Pipeline::bindFrameBuffer(const GpuFrameBuffer* fb)
+{
+	// null is the back buffer, an offscreen one when demo_bench renders
+	if (!fb) fb = GpuFrameBuffer::s_backBuffer;
+	const GLuint id = fb ? fb->m_fbo : 0;
+
+	if (id == m_activeFrameBuffer)
+	{
+		++m_callStats.frameBufferSkipped;
+		return;
+	}
+
+	GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, id));
+	m_activeFrameBuffer = id;
+	++m_callStats.frameBufferIssued;
+}
+
+void Pipeline::invalidateState()
+{
+	m_activeArrayBuffer = GL_UNKNOWN_BINDING;
+	m_activeElementBuffer = GL_UNKNOWN_BINDING;
+	m_activeVertexArray = GL_UNKNOWN_BINDING;
+	m_activeFrameBuffer = GL_UNKNOWN_BINDING;
+	m_activeProgram = GL_UNKNOWN_BINDING;
+
+	for (int i = 0; i < MAX_TEXTURE_UNITS; ++i)
+	{
+		m_tmus[i].target = 0;
+		m_tmus[i].texId = GL_UNKNOWN_BINDING;
+	}
+}
+
+void Pipeline::beginFrame()
+{
+	m_lastCallStats = m_callStats;
+	m_callStats = {};
+
+	// resource creation binds directly between frames
+	invalidateState();
 }
 
 void Pipeline::drawArrays(eDrawMode mode, int first, uint32_t count)
@@ -463,6 +588,68 @@ void Pipeline::drawElements(eDrawMode mode, uint32_t count, eDataType type, uint
 	GL_CHECK(glDrawElementsBaseVertex(mode_, count, type_, reinterpret_cast<void*>(offset), baseVertex));
 }
 
+void Pipeline::multiDrawElementsIndirect(eDrawMode mode, eDataType type, uint32_t offset, uint32_t drawCount)
+{
+	const GLenum mode_ = GL_castDrawMode(mode);
+	const GLenum type_ = GL_castDataType(type);
+
+	GL_CHECK(glMultiDrawElementsIndirect(mode_, type_, reinterpret_cast<void*>(uintptr_t(offset)), drawCount, 0));
+}
+
+void Pipeline::uploadConstantBlocks()
+{
+	struct block_t
+	{
+		const void* data;
+		uint32_t size;
+	};
+
+	const block_t blocks[CB_BINDING_COUNT] = {
+		{ &g_mtx, sizeof(g_mtx) },
+		{ &g_sun, sizeof(g_sun) },
+		{ &g_cam, sizeof(g_cam) },
+		{ &cb_lowFreq, sizeof(cb_lowFreq) },
+		{ &cb_highFreq, sizeof(cb_highFreq) }
+	};
+
+	bool all = false;
+
+	if (!m_constantBuffer.isCreated())
+	{
+		GLint align = 16;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+
+		uint32_t offset = 0;
+		for (int i = 0; i < CB_BINDING_COUNT; ++i)
+		{
+			m_constantOffsets[i] = offset;
+			offset = (offset + blocks[i].size + align - 1) / align * align;
+		}
+
+		m_constantBuffer.create(offset, eGpuBufferUsage::DYNAMIC, 0);
+		m_constantShadow.assign(offset, 0);
+		all = true;
+	}
+
+	for (int i = 0; i < CB_BINDING_COUNT; ++i)
+	{
+		uint8_t* shadow = m_constantShadow.data() + m_constantOffsets[i];
+
+		if (all || ::memcmp(shadow, blocks[i].data, blocks[i].size) != 0)
+		{
+			::memcpy(shadow, blocks[i].data, blocks[i].size);
+			m_constantBuffer.update(m_constantOffsets[i], blocks[i].size, blocks[i].data);
+			++m_callStats.bufferIssued;
+		}
+		else
+		{
+			++m_callStats.bufferSkipped;
+		}
+
+		m_constantBuffer.bindIndexed(CB_BINDING_MATRIX + i, m_constantOffsets[i], blocks[i].size);
+	}
+}
+
 void Pipeline::update(float time)
 {
 	g_misc.f_time = time;
@@ -496,4 +683,5 @@ void Pipeline::update(float time)
 	//Normal = mat3(transpose(inverse(model))) * aNormal;
 	g_mtx.m_Normal = glm::mat4(glm::mat3(glm::transpose(glm::inverse(g_mtx.m_W))));
 
+	uploadConstantBlocks();
 }
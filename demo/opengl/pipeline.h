@@ -1,6 +1,7 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -10,9 +11,29 @@
 #include "gpu_utils.h"
 #include "gpu_state.h"
 #include "gpu_buffer.h"
+#include "constant_blocks.h"
 
 #define MAX_TEXTURE_UNITS 15
 
+class GpuProgram;
+class GpuTexture;
+class GpuFrameBuffer;
+struct VertexLayout;
+
+/*
+GL calls made through Pipeline's bind/setState methods, issued ones
+reached the driver, skipped ones matched the shadow state.
+*/
+struct glCallStats_t
+{
+	uint32_t programIssued, programSkipped;
+	uint32_t textureIssued, textureSkipped;
+	uint32_t vaoIssued, vaoSkipped;
+	uint32_t frameBufferIssued, frameBufferSkipped;
+	uint32_t bufferIssued, bufferSkipped;
+	uint32_t stateIssued, stateSkipped;
+};
+
 class Pipeline
 {
 public:
@@ -27,11 +48,37 @@ public:
 	void setScreenRect(unsigned width, unsigned height);
 
 	void bindVertexBuffer(GpuBuffer& b, int index = -1);
-	void bindIndexBuffer(GpuBuffer& b);
+	void bindIndexBuffer(const GpuBuffer& b);
+
+	/*
+	Binds through a shadow copy of the GL state, calls that would not change
+	anything are skipped. Null unbinds, except for bindFrameBuffer() where it
+	is the back buffer (see GpuFrameBuffer::setBackBuffer). Resource creation
+	(VertexLayout::begin, GpuBuffer::create, texture uploads) binds directly,
+	so mid-frame loaders must call invalidateState(); beginFrame() does it
+	for the frame boundary.
+	*/
+	void bindProgram(const GpuProgram* prg);
+	void bindTexture(int unit, const GpuTexture* tex);
+	void bindVertexArray(const VertexLayout* layout);
+	void bindFrameBuffer(const GpuFrameBuffer* fb);
+	void invalidateState();
+
+	// starts a new set of call counters, getCallStats() returns the finished frame's
+	void beginFrame();
+	const glCallStats_t& getCallStats() const { return m_lastCallStats; }
 	void drawArrays(eDrawMode mode, int first, uint32_t count);
 	void drawElements(eDrawMode mode, uint32_t count, eDataType type, uint32_t offset);
 	void drawElements(eDrawMode mode, uint32_t count, eDataType type, uint32_t offset, uint32_t baseVertex);
-
+	// drawCount drawElementsIndirectCommand_t records at offset of the bound INDIRECT buffer
+	void multiDrawElementsIndirect(eDrawMode mode, eDataType type, uint32_t offset, uint32_t drawCount);
+
+	/*
+	Rebuilds g_mtx from g_cam, the screen rect and the world transform,
+	then uploads the constant blocks that changed and binds all of them at
+	their eConstantBlockBinding point. Call it once per frame, or again
+	when the world transform changes, with the GL context current.
+	*/
 	void update(float time);
 
 	struct {
@@ -40,44 +87,15 @@ public:
 		int i_screen_y;
 	} g_misc{};
 
-	struct {
-		glm::vec4 v_position;
-		glm::vec4 v_direction;
-		glm::vec4 v_color;
-		float f_intensity;
-	} g_sun{};
-
-	struct {
-		glm::vec4 v_position;
-		glm::vec4 v_target;
-		glm::vec4 v_direction;
-		glm::vec4 v_up;
-		glm::vec4 v_near_far_fov;
-	} g_cam{};
-
-	struct {
-		glm::mat4 m_W;
-		glm::mat4 m_V;
-		glm::mat4 m_P;
-		glm::mat4 m_Normal;
-
-		glm::mat4 m_WV;
-		glm::mat4 m_VP;
-		glm::mat4 m_WVP;
-
-		glm::mat4 m_iP;
-		glm::mat4 m_iVP;
-	} g_mtx{};
-
-	struct {
-		glm::vec4 v_highFreq[32];
-	} cb_highFreq;
-
-	struct {
-		glm::vec4 v_lowFreq[32];
-	} cb_lowFreq;
+	// std140 mirrors of constant_blocks.inc.glsl, update() uploads them
+	cbSunlight_t g_sun{};
+	cbCamera_t g_cam{};
+	cbMatrix_t g_mtx{};
+	cbHighFreq_t cb_highFreq{};
+	cbLowFreq_t cb_lowFreq{};
 
 private:
+	void uploadConstantBlocks();
 
 	GLfloat _polyOfsScale, _polyOfsBias;
 	GLuint64 m_glStateBits;
@@ -91,6 +109,15 @@ private:
 	GLuint m_activeElementBuffer;
 	GLuint m_activeVertexArray;
 	GLuint m_activeFrameBuffer;
+	GLuint m_activeProgram;
+
+	GpuBuffer m_constantBuffer;
+	uint32_t m_constantOffsets[CB_BINDING_COUNT];
+	// what the GPU copy holds, compared against to find the dirty blocks
+	std::vector<uint8_t> m_constantShadow;
+
+	glCallStats_t m_callStats;
+	glCallStats_t m_lastCallStats;
 
 	glm::vec3 m_worldPosition;
 	glm::vec3 m_worldScale;
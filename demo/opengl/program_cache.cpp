@@ -0,0 +1,162 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include "filesystem.h"
+#include "logger.h"
+#include "hash.h"
+#include "gpu_utils.h"
+#include "program_cache.h"
+
+ProgramCache g_programCache;
+
+#define PROGRAM_CACHE_MAGIC		0x4E494250		// 'PBIN'
+#define PROGRAM_CACHE_VERSION	1
+
+struct programCacheHeader_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t binaryFormat;
+	uint32_t binarySize;
+	uint64_t key;
+};
+
+bool ProgramCache::init(const std::string& directory)
+{
+	m_bEnabled = false;
+
+	GLint numFormats = 0;
+	GL_CHECK(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats));
+	if (numFormats <= 0)
+	{
+		Info("ProgramCache: driver exposes no program binary formats, cache disabled");
+		return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	if (ec)
+	{
+		Warning("ProgramCache: cannot create %s, cache disabled", directory.c_str());
+		return false;
+	}
+
+	uint64_t h = HASH_FNV1A_SEED;
+	const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (GLenum name : strings)
+	{
+		const char* str = reinterpret_cast<const char*>(glGetString(name));
+		h = Hash_Fnv1a(str ? str : "", h);
+	}
+
+	m_Directory = directory;
+	m_DriverHash = h;
+	m_bEnabled = true;
+
+	Info("ProgramCache: %s", directory.c_str());
+
+	return true;
+}
+
+uint64_t ProgramCache::addStage(uint64_t key, eShaderStage stage, const std::vector<const char*>& sources)
+{
+	const uint32_t tag = uint32_t(stage);
+	key = Hash_Fnv1a(&tag, sizeof(tag), key);
+
+	for (const char* src : sources)
+	{
+		// the terminator separates the strings, "ab" + "c" != "a" + "bc"
+		key = Hash_Fnv1a(src, strlen(src) + 1, key);
+	}
+
+	return key;
+}
+
+std::string ProgramCache::getPath(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+
+	return m_Directory + "/" + name;
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key) const
+{
+	if (!m_bEnabled)
+	{
+		return false;
+	}
+
+	const std::string path = getPath(key);
+	const std::vector<uint8_t> file = g_fileSystem.read_binary_file(path);
+
+	if (file.size() < sizeof(programCacheHeader_t))
+	{
+		return false;
+	}
+
+	programCacheHeader_t header;
+	memcpy(&header, file.data(), sizeof(header));
+
+	if (header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION
+		|| header.key != key || sizeof(header) + header.binarySize > file.size())
+	{
+		Warning("ProgramCache: %s is corrupt", path.c_str());
+		std::remove(path.c_str());
+		return false;
+	}
+
+	// an unknown format raises GL_INVALID_ENUM, the link status below tells the same
+	glProgramBinary(program, header.binaryFormat, file.data() + sizeof(header), GLsizei(header.binarySize));
+	GL_FLUSH_ERRORS
+
+	GLint linked = GL_FALSE;
+	GL_CHECK(glGetProgramiv(program, GL_LINK_STATUS, &linked));
+
+	if (linked == GL_FALSE)
+	{
+		// usually a driver update that kept the version string, rebuild
+		Info("ProgramCache: binary %016llx rejected", static_cast<unsigned long long>(key));
+		std::remove(path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void ProgramCache::store(GLuint program, uint64_t key) const
+{
+	if (!m_bEnabled)
+	{
+		return;
+	}
+
+	GLint length = 0;
+	GL_CHECK(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+	{
+		return;
+	}
+
+	std::vector<uint8_t> blob(sizeof(programCacheHeader_t) + length);
+
+	GLenum format = 0;
+	GLsizei written = 0;
+	GL_CHECK(glGetProgramBinary(program, length, &written, &format, blob.data() + sizeof(programCacheHeader_t)));
+
+	if (written <= 0)
+	{
+		return;
+	}
+
+	programCacheHeader_t header{};
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.binaryFormat = format;
+	header.binarySize = uint32_t(written);
+	header.key = key;
+	memcpy(blob.data(), &header, sizeof(header));
+
+	g_fileSystem.write_binary_file(getPath(key), blob.data(), sizeof(header) + written);
+}
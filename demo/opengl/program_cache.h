@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+#include "gpu_types.h"
+
+/*
+On disk cache of linked program binaries (glGetProgramBinary).
+
+A key is the hash of the driver's vendor, renderer and version strings
+plus every stage's source, so a driver update or an edited shader
+simply misses. A binary the driver rejects is deleted and the caller
+compiles from source again.
+*/
+class ProgramCache
+{
+public:
+	ProgramCache() : m_DriverHash(), m_bEnabled(false) {}
+
+	// needs a current GL context; the cache stays off when the driver has no binary formats
+	bool init(const std::string& directory);
+
+	bool isEnabled() const { return m_bEnabled; }
+
+	// start a key with getKey(), add every stage with addStage()
+	uint64_t getKey() const { return m_DriverHash; }
+	static uint64_t addStage(uint64_t key, eShaderStage stage, const std::vector<const char*>& sources);
+
+	// false on miss or when the driver rejects the binary
+	bool load(GLuint program, uint64_t key) const;
+	// call on a successfully linked program, created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+	void store(GLuint program, uint64_t key) const;
+private:
+	std::string getPath(uint64_t key) const;
+
+	std::string m_Directory;
+	uint64_t m_DriverHash;
+	bool m_bEnabled;
+};
+
+extern ProgramCache g_programCache;
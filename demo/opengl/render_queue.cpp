@@ -0,0 +1,217 @@
+#include <cstring>
+#include <algorithm>
+#include "gpu_state.h"
+#include "gpu_program.h"
+#include "gpu_texture.h"
+#include "gpu_buffer.h"
+#include "gpu_vertex_layout.h"
+#include "pipeline.h"
+#include "render_queue.h"
+
+static const int RQ_PROGRAM_BITS = 11;
+static const int RQ_STATE_BITS = 11;
+static const int RQ_TEXTURE_BITS = 12;
+static const int RQ_VAO_BITS = 12;
+static const int RQ_DEPTH_BITS = 17;
+
+static inline uint32_t denseId(uint32_t id, int bits)
+{
+	return std::min(id, (1u << bits) - 1);
+}
+
+template<class Map, class Key>
+static inline uint32_t lookupId(Map& map, const Key& key)
+{
+	return map.emplace(key, uint32_t(map.size())).first->second;
+}
+
+bool RenderQueue::textureSet_t::operator==(const textureSet_t& o) const
+{
+	return ::memcmp(t, o.t, sizeof(t)) == 0;
+}
+
+size_t RenderQueue::textureSetHash_t::operator()(const textureSet_t& s) const
+{
+	size_t h = 0;
+	for (int i = 0; i < RQ_MAX_TEXTURES; ++i)
+	{
+		h = h * 31 + std::hash<const void*>()(s.t[i]);
+	}
+	return h;
+}
+
+void RenderQueue::begin(float farPlane)
+{
+	m_Packets.clear();
+	m_Keys.clear();
+	m_ProgramIds.clear();
+	m_StateIds.clear();
+	m_TextureSetIds.clear();
+	m_LayoutIds.clear();
+
+	m_DepthScale = farPlane > 0.0f ? 1.0f / farPlane : 1.0f;
+}
+
+uint64_t RenderQueue::makeKey(const drawPacket_t& packet)
+{
+	textureSet_t ts;
+	::memcpy(ts.t, packet.textures, sizeof(ts.t));
+
+	const uint64_t program = denseId(lookupId(m_ProgramIds, static_cast<const void*>(packet.program)), RQ_PROGRAM_BITS);
+	const uint64_t state = denseId(lookupId(m_StateIds, packet.stateBits), RQ_STATE_BITS);
+	const uint64_t textures = denseId(lookupId(m_TextureSetIds, ts), RQ_TEXTURE_BITS);
+	const uint64_t vao = denseId(lookupId(m_LayoutIds, static_cast<const void*>(packet.layout)), RQ_VAO_BITS);
+
+	const float d = std::min(std::max(packet.depth * m_DepthScale, 0.0f), 1.0f);
+	const uint64_t depth = uint64_t(d * float((1u << RQ_DEPTH_BITS) - 1));
+
+	const bool blended = (packet.stateBits & (GLS_SRCBLEND_BITS | GLS_DSTBLEND_BITS)) != 0;
+
+	if (blended)
+	{
+		const uint64_t backToFront = ((1u << RQ_DEPTH_BITS) - 1) - depth;
+		return (uint64_t(1) << 63)
+			| (backToFront << (63 - RQ_DEPTH_BITS))
+			| (program << (63 - RQ_DEPTH_BITS - RQ_PROGRAM_BITS))
+			| (state << (RQ_TEXTURE_BITS + RQ_VAO_BITS))
+			| (textures << RQ_VAO_BITS)
+			| vao;
+	}
+
+	return (program << (63 - RQ_PROGRAM_BITS))
+		| (state << (63 - RQ_PROGRAM_BITS - RQ_STATE_BITS))
+		| (textures << (RQ_VAO_BITS + RQ_DEPTH_BITS))
+		| (vao << RQ_DEPTH_BITS)
+		| depth;
+}
+
+void RenderQueue::add(const drawPacket_t& packet)
+{
+	m_Keys.push_back(makeKey(packet));
+	m_Packets.push_back(packet);
+}
+
+void RenderQueue::sortKeys()
+{
+	const size_t n = m_Keys.size();
+
+	// m_Keys stays in packet order, so submit() can run again and add() may follow it
+	m_SortKeys.assign(m_Keys.begin(), m_Keys.end());
+	m_Order.resize(n);
+	for (size_t i = 0; i < n; ++i) m_Order[i] = uint32_t(i);
+
+	m_TmpKeys.resize(n);
+	m_TmpOrder.resize(n);
+
+	// LSD radix sort, 8 bits per pass; a byte every key shares is skipped
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		uint32_t histogram[256] = {};
+		for (size_t i = 0; i < n; ++i) ++histogram[(m_SortKeys[i] >> shift) & 0xFF];
+
+		if (histogram[(m_SortKeys[0] >> shift) & 0xFF] == n)
+		{
+			continue;
+		}
+
+		uint32_t sum = 0;
+		for (int b = 0; b < 256; ++b)
+		{
+			const uint32_t c = histogram[b];
+			histogram[b] = sum;
+			sum += c;
+		}
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			const uint32_t dst = histogram[(m_SortKeys[i] >> shift) & 0xFF]++;
+			m_TmpKeys[dst] = m_SortKeys[i];
+			m_TmpOrder[dst] = m_Order[i];
+		}
+
+		m_SortKeys.swap(m_TmpKeys);
+		m_Order.swap(m_TmpOrder);
+	}
+}
+
+void RenderQueue::submit(Pipeline& p)
+{
+	m_Stats = {};
+
+	if (m_Packets.empty())
+	{
+		m_LastStats = m_Stats;
+		return;
+	}
+
+	sortKeys();
+
+	const GpuProgram* program = nullptr;
+	const VertexLayout* layout = nullptr;
+	const GpuBuffer* indexBuffer = nullptr;
+	const GpuTexture* textures[RQ_MAX_TEXTURES] = {};
+	uint64_t stateBits = 0;
+	bool first = true;
+
+	for (uint32_t idx : m_Order)
+	{
+		const drawPacket_t& dp = m_Packets[idx];
+
+		if (first || dp.stateBits != stateBits)
+		{
+			p.setState(dp.stateBits, false);
+			stateBits = dp.stateBits;
+			++m_Stats.stateChanges;
+		}
+
+		if (dp.program != program)
+		{
+			p.bindProgram(dp.program);
+			program = dp.program;
+			++m_Stats.programChanges;
+		}
+
+		for (int i = 0; i < RQ_MAX_TEXTURES; ++i)
+		{
+			if (dp.textures[i] && dp.textures[i] != textures[i])
+			{
+				p.bindTexture(i, dp.textures[i]);
+				textures[i] = dp.textures[i];
+				++m_Stats.textureChanges;
+			}
+		}
+
+		if (dp.layout != layout)
+		{
+			p.bindVertexArray(dp.layout);
+			layout = dp.layout;
+			indexBuffer = nullptr;
+			++m_Stats.vaoChanges;
+		}
+
+		if (dp.indexBuffer && dp.indexBuffer != indexBuffer)
+		{
+			p.bindIndexBuffer(*dp.indexBuffer);
+			indexBuffer = dp.indexBuffer;
+		}
+
+		if (dp.setup)
+		{
+			dp.setup(p, dp);
+		}
+
+		if (dp.baseVertex)
+		{
+			p.drawElements(dp.mode, dp.count, dp.indexType, dp.offset, dp.baseVertex);
+		}
+		else
+		{
+			p.drawElements(dp.mode, dp.count, dp.indexType, dp.offset);
+		}
+		++m_Stats.draws;
+
+		first = false;
+	}
+
+	m_LastStats = m_Stats;
+}
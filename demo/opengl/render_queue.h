@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <cinttypes>
+#include <unordered_map>
+
+#include "gpu_types.h"
+
+class Pipeline;
+class GpuProgram;
+class GpuTexture;
+class GpuBuffer;
+struct VertexLayout;
+
+#define RQ_MAX_TEXTURES 4
+
+/*
+Everything needed to issue one indexed draw. textures[i] goes to unit i,
+unused slots are null. setup, when set, runs right before the draw with
+the program already bound (per object uniforms).
+*/
+struct drawPacket_t
+{
+	const GpuProgram* program;
+	uint64_t stateBits;
+	const GpuTexture* textures[RQ_MAX_TEXTURES];
+	const VertexLayout* layout;
+	const GpuBuffer* indexBuffer;		// null when the VAO already holds it
+
+	eDrawMode mode;
+	eDataType indexType;
+	uint32_t count;
+	uint32_t offset;					// in bytes
+	uint32_t baseVertex;
+
+	float depth;						// view space distance
+
+	void (*setup)(Pipeline& p, const drawPacket_t& packet);
+	const void* userData;
+};
+
+struct renderQueueStats_t
+{
+	uint32_t draws;
+	uint32_t programChanges;
+	uint32_t stateChanges;
+	uint32_t textureChanges;
+	uint32_t vaoChanges;
+};
+
+/*
+Per frame draw queue. Packets are packed into 64 bit keys
+
+	opaque:		0 | program:11 | state:11 | textures:12 | vao:12 | depth:17 (front to back)
+	blended:	1 | ~depth:17 (back to front) | program:11 | state:11 | textures:12 | vao:12
+
+radix sorted and submitted in key order, so neighbouring draws share as
+much GL state as possible. Programs, state bit sets, texture sets and VAOs
+are numbered in order of first use every frame; more distinct values than
+a field holds only weakens the grouping, submit() compares the real
+objects before binding anything.
+*/
+class RenderQueue
+{
+public:
+	RenderQueue() : m_Stats(), m_LastStats(), m_DepthScale(1.0f) {}
+
+	// farPlane: distance mapped to the largest depth key
+	void begin(float farPlane);
+	void add(const drawPacket_t& packet);
+	// sorts and draws every packet added since begin(), may run more than once per begin()
+	void submit(Pipeline& p);
+
+	size_t size() const { return m_Packets.size(); }
+	// counters of the last submit()
+	const renderQueueStats_t& getStats() const { return m_LastStats; }
+private:
+	struct textureSet_t
+	{
+		const GpuTexture* t[RQ_MAX_TEXTURES];
+		bool operator==(const textureSet_t& o) const;
+	};
+
+	struct textureSetHash_t
+	{
+		size_t operator()(const textureSet_t& s) const;
+	};
+
+	uint64_t makeKey(const drawPacket_t& packet);
+	void sortKeys();
+
+	std::vector<drawPacket_t> m_Packets;
+	std::vector<uint64_t> m_Keys;			// parallel to m_Packets
+	std::vector<uint64_t> m_SortKeys;
+	std::vector<uint32_t> m_Order;
+	std::vector<uint64_t> m_TmpKeys;
+	std::vector<uint32_t> m_TmpOrder;
+
+	std::unordered_map<const void*, uint32_t> m_ProgramIds;
+	std::unordered_map<uint64_t, uint32_t> m_StateIds;
+	std::unordered_map<textureSet_t, uint32_t, textureSetHash_t> m_TextureSetIds;
+	std::unordered_map<const void*, uint32_t> m_LayoutIds;
+
+	renderQueueStats_t m_Stats;
+	renderQueueStats_t m_LastStats;
+	float m_DepthScale;
+};
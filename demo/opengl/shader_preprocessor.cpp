@@ -0,0 +1,202 @@
+#include <cctype>
+#include <filesystem>
+#include <sstream>
+#include "filesystem.h"
+#include "logger.h"
+#include "hash.h"
+#include "shader_preprocessor.h"
+
+namespace fs = std::filesystem;
+
+static void EmitDefines(const std::vector<std::string>& defines, std::string& code)
+{
+	for (const std::string& define : defines)
+	{
+		const size_t eq = define.find('=');
+
+		code += "#define ";
+		if (eq == std::string::npos)
+		{
+			code += define;
+			code += " 1\n";
+		}
+		else
+		{
+			code += define.substr(0, eq);
+			code += ' ';
+			code += define.substr(eq + 1);
+			code += '\n';
+		}
+	}
+}
+
+static void EmitLine(int line, size_t fileIndex, std::string& code)
+{
+	code += "#line " + std::to_string(line) + " " + std::to_string(fileIndex) + "\n";
+}
+
+// "#  directive rest" -> directive, rest; false when the line is not a directive
+static bool ParseDirective(const std::string& line, std::string& directive, std::string& rest)
+{
+	size_t p = line.find_first_not_of(" \t");
+	if (p == std::string::npos || line[p] != '#')
+	{
+		return false;
+	}
+
+	p = line.find_first_not_of(" \t", p + 1);
+	if (p == std::string::npos)
+	{
+		return false;
+	}
+
+	size_t e = p;
+	while (e < line.size() && (isalnum(uint8_t(line[e])) || line[e] == '_')) ++e;
+
+	directive = line.substr(p, e - p);
+	rest = line.substr(e);
+
+	return true;
+}
+
+static bool ParseIncludeName(const std::string& rest, std::string& name)
+{
+	const size_t open = rest.find_first_of("\"<");
+	if (open == std::string::npos)
+	{
+		return false;
+	}
+
+	const size_t close = rest.find(rest[open] == '"' ? '"' : '>', open + 1);
+	if (close == std::string::npos)
+	{
+		return false;
+	}
+
+	name = rest.substr(open + 1, close - open - 1);
+
+	return !name.empty();
+}
+
+static bool PreprocessFile(const std::string& fileName, const std::vector<std::string>& defines, shaderSource_t& output)
+{
+	std::string text;
+	if (!g_fileSystem.read_text_file(fileName, text))
+	{
+		Error("Shader_Preprocess: cannot read %s", fileName.c_str());
+		return false;
+	}
+
+	const size_t fileIndex = output.files.size();
+	const bool isRoot = fileIndex == 0;
+	output.files.push_back(fileName);
+
+	const fs::path dir = fs::path(fileName).parent_path();
+
+	bool definesEmitted = !isRoot;
+	if (!isRoot)
+	{
+		EmitLine(1, fileIndex, output.code);
+	}
+	else if (text.find("#version") == std::string::npos)
+	{
+		EmitDefines(defines, output.code);
+		EmitLine(1, fileIndex, output.code);
+		definesEmitted = true;
+	}
+
+	std::istringstream lines(text);
+	std::string line, directive, rest;
+	int lineNo = 0;
+
+	while (std::getline(lines, line))
+	{
+		++lineNo;
+
+		if (!ParseDirective(line, directive, rest))
+		{
+			output.code += line;
+			output.code += '\n';
+			continue;
+		}
+
+		if (directive == "version")
+		{
+			if (isRoot && !definesEmitted)
+			{
+				output.code += line;
+				output.code += '\n';
+				EmitDefines(defines, output.code);
+				EmitLine(lineNo + 1, fileIndex, output.code);
+				definesEmitted = true;
+			}
+			else
+			{
+				output.code += '\n';
+			}
+		}
+		else if (directive == "include")
+		{
+			std::string name;
+			if (!ParseIncludeName(rest, name))
+			{
+				Error("Shader_Preprocess: %s(%d): malformed #include", fileName.c_str(), lineNo);
+				return false;
+			}
+
+			const std::string path = (dir / name).lexically_normal().generic_string();
+
+			bool seen = false;
+			for (const std::string& f : output.files)
+			{
+				if (f == path) { seen = true; break; }
+			}
+
+			// include guard: a file already pasted, or still open above us, is skipped
+			if (seen)
+			{
+				output.code += '\n';
+				continue;
+			}
+
+			if (!PreprocessFile(path, defines, output))
+			{
+				Error("Shader_Preprocess: included from %s(%d)", fileName.c_str(), lineNo);
+				return false;
+			}
+
+			EmitLine(lineNo + 1, fileIndex, output.code);
+		}
+		else if (directive == "pragma" && rest.find("once") != std::string::npos)
+		{
+			output.code += '\n';
+		}
+		else
+		{
+			output.code += line;
+			output.code += '\n';
+		}
+	}
+
+	return true;
+}
+
+bool Shader_Preprocess(const std::string& fileName, const std::vector<std::string>& defines, shaderSource_t& output)
+{
+	output.code.clear();
+	output.files.clear();
+
+	return PreprocessFile(fs::path(fileName).lexically_normal().generic_string(), defines, output);
+}
+
+uint64_t Shader_PermutationHash(const std::vector<std::string>& defines)
+{
+	// per define hashes are summed so the order does not matter
+	uint64_t key = 0;
+	for (const std::string& define : defines)
+	{
+		key += Hash_Fnv1a(define.data(), define.size());
+	}
+
+	return key;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+/*
+CPU side GLSL preprocessing, done before glShaderSource.
+
+#include "file" is resolved relative to the including file and every
+file is pasted once per output, so the .inc.glsl files need no guards
+of their own. A #version line in an included file is dropped, the one
+of the root file stays first and the permutation defines follow it:
+"NAME" becomes "#define NAME 1", "NAME=VALUE" "#define NAME VALUE".
+
+Line numbers are kept with #line, the source string number n of a
+compiler message is files[n].
+*/
+struct shaderSource_t
+{
+	std::string code;
+	std::vector<std::string> files;		// files[0] is the root
+};
+
+bool Shader_Preprocess(const std::string& fileName, const std::vector<std::string>& defines, shaderSource_t& output);
+
+// order independent, the same defines give the same key in any run
+uint64_t Shader_PermutationHash(const std::vector<std::string>& defines);
@@ -0,0 +1,179 @@
+#include <chrono>
+#include <cstdio>
+#include "logger.h"
+#include "filesystem.h"
+#include "profiler.h"
+
+Profiler g_profiler;
+
+// weight of the newest frame in the averages
+static const float PROFILER_AVERAGE_WEIGHT = 0.05f;
+
+static thread_local void* t_threadBuffer = nullptr;
+
+Profiler::Profiler() :
+	m_bCapturing(false),
+	m_RequestedFrames(0),
+	m_FramesLeft(0),
+	m_FrameIndex(0),
+	m_FrameStart(-1),
+	m_AverageFrameMs(0.0f)
+{
+	m_Gpu.tid = 0;
+	m_Gpu.name = "GPU";
+}
+
+int64_t Profiler::now()
+{
+	static const auto epoch = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - epoch).count();
+}
+
+Profiler::threadBuffer_t& Profiler::getThreadBuffer()
+{
+	if (!t_threadBuffer)
+	{
+		std::lock_guard<std::mutex> lk(m_Lock);
+
+		m_Threads.emplace_back(new threadBuffer_t);
+		threadBuffer_t* buf = m_Threads.back().get();
+		buf->tid = int(m_Threads.size());
+		buf->name = "Thread " + std::to_string(buf->tid);
+
+		t_threadBuffer = buf;
+	}
+
+	return *static_cast<threadBuffer_t*>(t_threadBuffer);
+}
+
+void Profiler::setThreadName(const char* name)
+{
+	threadBuffer_t& buf = getThreadBuffer();
+
+	std::lock_guard<std::mutex> lk(buf.lock);
+	buf.name = name;
+}
+
+void Profiler::startCapture(const std::string& fileName, int numFrames)
+{
+	std::lock_guard<std::mutex> lk(m_Lock);
+
+	m_RequestedFile = fileName;
+	m_RequestedFrames = numFrames > 0 ? numFrames : 1;
+}
+
+void Profiler::addCpuEvent(const char* name, int64_t start, int64_t end)
+{
+	threadBuffer_t& buf = getThreadBuffer();
+
+	std::lock_guard<std::mutex> lk(buf.lock);
+	buf.events.push_back({ name, start, end });
+}
+
+void Profiler::addGpuEvent(const char* name, int64_t start, int64_t end)
+{
+	std::lock_guard<std::mutex> lk(m_Gpu.lock);
+	m_Gpu.events.push_back({ name, start, end });
+}
+
+void Profiler::beginFrame()
+{
+	const int64_t t = now();
+
+	if (m_FrameStart >= 0)
+	{
+		const float ms = float(t - m_FrameStart) * 1e-6f;
+		m_AverageFrameMs += (ms - m_AverageFrameMs) * PROFILER_AVERAGE_WEIGHT;
+
+		if (isCapturing())
+		{
+			addCpuEvent("Frame", m_FrameStart, t);
+
+			if (--m_FramesLeft <= 0)
+			{
+				m_bCapturing.store(false, std::memory_order_relaxed);
+				writeCapture();
+			}
+		}
+	}
+
+	m_FrameStart = t;
+	++m_FrameIndex;
+
+	std::string requested;
+	int frames = 0;
+	{
+		std::lock_guard<std::mutex> lk(m_Lock);
+		if (m_RequestedFrames > 0 && !isCapturing())
+		{
+			requested.swap(m_RequestedFile);
+			frames = m_RequestedFrames;
+			m_RequestedFrames = 0;
+		}
+	}
+
+	if (frames > 0)
+	{
+		std::lock_guard<std::mutex> lk(m_Lock);
+		for (auto& buf : m_Threads)
+		{
+			std::lock_guard<std::mutex> blk(buf->lock);
+			buf->events.clear();
+		}
+		{
+			std::lock_guard<std::mutex> glk(m_Gpu.lock);
+			m_Gpu.events.clear();
+		}
+
+		m_CaptureFile = requested;
+		m_FramesLeft = frames;
+		m_bCapturing.store(true, std::memory_order_relaxed);
+
+		Info("Profiler: capturing %d frames", frames);
+	}
+}
+
+static void AppendEvents(std::string& json, int tid, const std::string& name, const std::vector<profEvent_t>& events, bool& first)
+{
+	char line[256];
+
+	snprintf(line, sizeof(line), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",", tid, name.c_str());
+	json += line;
+	first = false;
+
+	for (const profEvent_t& e : events)
+	{
+		// Chrome trace time stamps are in microseconds
+		snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			e.name, tid, double(e.start) * 1e-3, double(e.end - e.start) * 1e-3);
+		json += line;
+	}
+}
+
+void Profiler::writeCapture()
+{
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	size_t numEvents = 0;
+
+	{
+		std::lock_guard<std::mutex> lk(m_Gpu.lock);
+		AppendEvents(json, m_Gpu.tid, m_Gpu.name, m_Gpu.events, first);
+		numEvents += m_Gpu.events.size();
+	}
+
+	std::lock_guard<std::mutex> lk(m_Lock);
+	for (auto& buf : m_Threads)
+	{
+		std::lock_guard<std::mutex> blk(buf->lock);
+		AppendEvents(json, buf->tid, buf->name, buf->events, first);
+		numEvents += buf->events.size();
+	}
+
+	json += "\n]}\n";
+
+	if (g_fileSystem.write_binary_file(m_CaptureFile, json.data(), json.size()))
+	{
+		Info("Profiler: %d events written to %s", int(numEvents), m_CaptureFile.c_str());
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+Frame profiler.
+
+CPU scopes time themselves on the high resolution clock and record into
+a buffer owned by their thread while a capture runs; outside a capture a
+scope costs one relaxed load. GpuProfiler adds its timer query results
+to the same capture on a separate "GPU" track.
+
+A capture spans a number of whole frames and is written as Chrome trace
+JSON, open it in chrome://tracing or ui.perfetto.dev. Scope names must
+be string literals, only the pointer is stored.
+*/
+
+struct profEvent_t
+{
+	const char* name;
+	int64_t start;		// ns since the profiler epoch
+	int64_t end;
+};
+
+class Profiler
+{
+public:
+	Profiler();
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	// names the calling thread's track
+	void setThreadName(const char* name);
+
+	// the capture starts with the next frame and is written to fileName after numFrames
+	void startCapture(const std::string& fileName, int numFrames);
+	bool isCapturing() const { return m_bCapturing.load(std::memory_order_relaxed); }
+
+	// main thread, once per frame before anything else
+	void beginFrame();
+	uint64_t getFrameIndex() const { return m_FrameIndex; }
+	// CPU time between beginFrame() calls, averaged over a few frames
+	float getAverageFrameMs() const { return m_AverageFrameMs; }
+
+	static int64_t now();
+
+	void addCpuEvent(const char* name, int64_t start, int64_t end);
+	void addGpuEvent(const char* name, int64_t start, int64_t end);
+private:
+	struct threadBuffer_t
+	{
+		std::mutex lock;					// uncontended but for the writer
+		int tid;
+		std::string name;
+		std::vector<profEvent_t> events;
+	};
+
+	threadBuffer_t& getThreadBuffer();
+	void writeCapture();
+
+	std::mutex m_Lock;
+	std::vector<std::unique_ptr<threadBuffer_t>> m_Threads;
+	threadBuffer_t m_Gpu;
+
+	std::atomic<bool> m_bCapturing;
+	std::string m_CaptureFile;
+	std::string m_RequestedFile;
+	int m_RequestedFrames;
+	int m_FramesLeft;
+
+	uint64_t m_FrameIndex;
+	int64_t m_FrameStart;
+	float m_AverageFrameMs;
+};
+
+extern Profiler g_profiler;
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) : m_Name(name), m_Start(g_profiler.isCapturing() ? Profiler::now() : -1) {}
+	~ProfileScope()
+	{
+		if (m_Start >= 0) g_profiler.addCpuEvent(m_Name, m_Start, Profiler::now());
+	}
+private:
+	const char* m_Name;
+	int64_t m_Start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
@@ -0,0 +1,267 @@
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include "heap.h"
+#include "mesh.h"
+#include "vertex_packing.h"
+#include "gpu_buffer.h"
+#include "pipeline.h"
+
+RenderMesh3D::~RenderMesh3D()
+{
+    if (m_Arena)
+    {
+        m_Arena->remove(m_ArenaRange);
+    }
+}
+
+void RenderMesh3D::compile(const Mesh3D& mesh, bool packed)
+{
+    if (isCompiled())
+        return;
+
+    int index = 0;
+    m_Layout.begin();
+    packedVertex_t* stream = nullptr;
+    const int numPacked = packed ? Vertex_BuildPackedStream(mesh, &stream) : 0;
+    if (numPacked)
+    {
+        const unsigned int stride = sizeof(packedVertex_t);
+        m_PackedBuf.create(stride * numPacked, eGpuBufferUsage::STATIC, 0, stream);
+        Mem_Free16(stream);
+
+        m_Layout
+            .with(PACKED_VERTEX_LOC_POSITION, 3, eDataType::FLOAT, false, offsetof(packedVertex_t, position), stride, &m_PackedBuf)
+            .with(PACKED_VERTEX_LOC_QTANGENT, 4, eDataType::SHORT, true, offsetof(packedVertex_t, qtangent), stride, &m_PackedBuf)
+            .with(PACKED_VERTEX_LOC_ST, 2, eDataType::HALF_FLOAT, false, offsetof(packedVertex_t, st), stride, &m_PackedBuf)
+            .with(PACKED_VERTEX_LOC_COLOR, 4, eDataType::UNSIGNED_BYTE, true, offsetof(packedVertex_t, color), stride, &m_PackedBuf);
+    }
+    else
+    {
+        if (mesh.getPositionLayout().count)
+        {
+            const VertexAttribute& va = mesh.getPositionLayout();
+            m_PositionBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getPositions());
+            m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_PositionBuf);
+        }
+        if (mesh.getNormalLayout().count)
+        {
+            const VertexAttribute& va = mesh.getNormalLayout();
+            m_NormalBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getNormals());
+            m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_NormalBuf);
+        }
+        if (mesh.getTangentLayout().count)
+        {
+            const VertexAttribute& va = mesh.getTangentLayout();
+            m_TangentBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getTangents());
+            m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_TangentBuf);
+        }
+        if (mesh.getTexCoordLayout().count)
+        {
+            const VertexAttribute& va = mesh.getTexCoordLayout();
+            m_TexCoordBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getTexCoords());
+            m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_TexCoordBuf);
+        }
+        if (mesh.getColorLayout().count)
+        {
+            const VertexAttribute& va = mesh.getColorLayout();
+            m_ColorBuf.create(va.byteSize, eGpuBufferUsage::STATIC, 0, mesh.getColors());
+            m_Layout.with(index++, va.size, va.type, va.normalized, 0, 0, &m_ColorBuf);
+        }
+    }
+    m_Layout.end();
+
+    if (mesh.getNumIndex())
+    {
+        m_IndexBuf.create(mesh.getNumIndex() * (mesh.getIndexType() == eDataType::UNSIGNED_SHORT ? 2 : 4), eGpuBufferUsage::STATIC, 0, mesh.getIndices());
+        m_NumIndex = mesh.getNumIndex();
+        m_IndexType = mesh.getIndexType();
+    }
+    m_Mode = mesh.getDrawMode();
+
+    m_Lods = mesh.getLods();
+    if (m_Lods.empty())
+    {
+        m_Lods.push_back({ 0, m_NumIndex, 0.0f });
+    }
+    mesh.getBounds(m_Min, m_Max);
+    m_Meshlets = mesh.getMeshlets();
+
+    m_bCompiled = true;
+}
+
+bool RenderMesh3D::compile(const Mesh3D& mesh, GeometryArena& arena)
+{
+    if (isCompiled())
+        return false;
+
+    if (!arena.add(mesh, m_ArenaRange))
+        return false;
+
+    m_Arena = &arena;
+    m_NumIndex = m_ArenaRange.numIndex;
+    m_IndexType = eDataType::UNSIGNED_INT32;
+    m_Mode = mesh.getDrawMode();
+
+    m_Lods = mesh.getLods();
+    if (m_Lods.empty())
+    {
+        m_Lods.push_back({ 0, m_NumIndex, 0.0f });
+    }
+    mesh.getBounds(m_Min, m_Max);
+    m_Meshlets = mesh.getMeshlets();
+
+    m_bCompiled = true;
+
+    return true;
+}
+
+bool RenderMesh3D::record(IndirectDrawList& list, uint64_t stateBits, const glm::mat4& world, int lod) const
+{
+    if (!m_Arena)
+        return false;
+
+    const meshLod_t& l = m_Lods[std::min(std::max(lod, 0), int(m_Lods.size()) - 1)];
+
+    return list.add(stateBits, m_ArenaRange, l.firstIndex, l.numIndex, world);
+}
+
+bool RenderMesh3D::getDrawPacket(drawPacket_t& packet, int lod) const
+{
+    if (!isCompiled() || m_Lods.empty())
+        return false;
+
+    const meshLod_t& l = m_Lods[std::min(std::max(lod, 0), int(m_Lods.size()) - 1)];
+    const uint32_t indexSize = m_IndexType == eDataType::UNSIGNED_SHORT ? 2 : 4;
+
+    if (m_Arena)
+    {
+        packet.layout = &m_Arena->getLayout();
+        packet.indexBuffer = nullptr;
+        packet.offset = (m_ArenaRange.firstIndex + l.firstIndex) * indexSize;
+        packet.baseVertex = m_ArenaRange.baseVertex;
+    }
+    else
+    {
+        packet.layout = &m_Layout;
+        packet.indexBuffer = &m_IndexBuf;
+        packet.offset = l.firstIndex * indexSize;
+        packet.baseVertex = 0;
+    }
+
+    packet.mode = m_Mode;
+    packet.indexType = m_IndexType;
+    packet.count = l.numIndex;
+
+    return true;
+}
+
+void RenderMesh3D::render(Pipeline& p) const
+{
+    render(p, 0);
+}
+
+void RenderMesh3D::render(Pipeline& p, int lod) const
+{
+    if (m_Arena)
+    {
+        const meshLod_t& l = m_Lods[std::min(std::max(lod, 0), int(m_Lods.size()) - 1)];
+
+        p.bindVertexArray(&m_Arena->getLayout());
+        p.drawElements(m_Mode, l.numIndex, m_IndexType, (m_ArenaRange.firstIndex + l.firstIndex) * 4, m_ArenaRange.baseVertex);
+        return;
+    }
+
+    p.bindVertexArray(&m_Layout);
+
+    if (m_IndexBuf.isCreated())
+    {
+        const meshLod_t& l = m_Lods[std::min(std::max(lod, 0), int(m_Lods.size()) - 1)];
+        const uint32_t indexSize = m_IndexType == eDataType::UNSIGNED_SHORT ? 2 : 4;
+
+        p.bindIndexBuffer(m_IndexBuf);
+        p.drawElements(m_Mode, l.numIndex, m_IndexType, l.firstIndex * indexSize);
+    }
+}
+
+size_t RenderMesh3D::renderCulled(Pipeline& p) const
+{
+    if (m_Meshlets.size() == 0 || (!m_IndexBuf.isCreated() && !m_Arena))
+    {
+        render(p, 0);
+        return m_Meshlets.size();
+    }
+
+    // cull in object space: planes of W*VP, camera moved by the inverse world matrix
+    glm::vec4 planes[6];
+    Meshlet_ExtractFrustum(p.g_mtx.m_VP * p.g_mtx.m_W, planes);
+    const glm::vec3 cameraPos = glm::vec3(glm::inverse(p.g_mtx.m_W) * glm::vec4(glm::vec3(p.g_cam.v_position), 1.0f));
+
+    m_VisibleRanges.clear();
+    const size_t visible = Meshlet_Cull(m_Meshlets, planes, cameraPos, m_VisibleRanges);
+
+    if (m_VisibleRanges.empty())
+    {
+        return 0;
+    }
+
+    const uint32_t indexSize = m_IndexType == eDataType::UNSIGNED_SHORT ? 2 : 4;
+
+    if (m_Arena)
+    {
+        p.bindVertexArray(&m_Arena->getLayout());
+        for (const drawRange_t& r : m_VisibleRanges)
+        {
+            p.drawElements(m_Mode, r.numIndex, m_IndexType, (m_ArenaRange.firstIndex + r.firstIndex) * indexSize, m_ArenaRange.baseVertex);
+        }
+        return visible;
+    }
+
+    p.bindVertexArray(&m_Layout);
+    p.bindIndexBuffer(m_IndexBuf);
+    for (const drawRange_t& r : m_VisibleRanges)
+    {
+        p.drawElements(m_Mode, r.numIndex, m_IndexType, r.firstIndex * indexSize);
+    }
+
+    return visible;
+}
+
+int RenderMesh3D::selectLod(const Pipeline& p, float maxPixelError) const
+{
+    if (m_Lods.size() < 2)
+    {
+        return 0;
+    }
+
+    const glm::mat4& W = p.g_mtx.m_W;
+    const float scale = std::max(glm::length(glm::vec3(W[0])), std::max(glm::length(glm::vec3(W[1])), glm::length(glm::vec3(W[2]))));
+    const glm::vec3 center = glm::vec3(W * glm::vec4((m_Min + m_Max) * 0.5f, 1.0f));
+    const float radius = 0.5f * glm::length(m_Max - m_Min) * scale;
+
+    const float zNear = p.g_cam.v_near_far_fov.x;
+    const float fov = p.g_cam.v_near_far_fov.z;
+
+    // pixels per world unit at the closest point of the bounding sphere
+    float pixelsPerUnit;
+    if (fov == 0.0f)
+    {
+        // Pipeline::update builds the ortho projection in screen pixels
+        pixelsPerUnit = 1.0f;
+    }
+    else
+    {
+        const float dist = std::max(glm::length(glm::vec3(p.g_cam.v_position) - center) - radius, zNear);
+        pixelsPerUnit = float(p.g_misc.i_screen_y) / (2.0f * dist * std::tan(fov * 0.5f));
+    }
+
+    for (int i = int(m_Lods.size()) - 1; i > 0; --i)
+    {
+        if (m_Lods[i].error * scale * pixelsPerUnit <= maxPixelError)
+        {
+            return i;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,508 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include "job_system.h"
+#include "texture_compressor.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// block rows handed to one job
+static const uint32_t BC_ROWS_PER_JOB = 8;
+
+uint32_t BC_BlockBytes(eBlockFormat format)
+{
+	return format == BF_BC1 || format == BF_BC4 ? 8 : 16;
+}
+
+size_t BC_CompressedSize(eBlockFormat format, int width, int height)
+{
+	return size_t((width + 3) / 4) * size_t((height + 3) / 4) * BC_BlockBytes(format);
+}
+
+bool BC_HasAlpha(const uint8_t* rgba, int width, int height)
+{
+	const size_t count = size_t(width) * height;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (rgba[i * 4 + 3] != 255) return true;
+	}
+
+	return false;
+}
+
+static void LoadBlock(const uint8_t* rgba, int width, int height, int bx, int by, uint8_t block[64])
+{
+	const int x0 = bx * 4;
+	const int y0 = by * 4;
+
+	if (x0 + 4 <= width && y0 + 4 <= height)
+	{
+		for (int y = 0; y < 4; ++y)
+		{
+			memcpy(block + y * 16, rgba + (size_t(y0 + y) * width + x0) * 4, 16);
+		}
+		return;
+	}
+
+	for (int y = 0; y < 4; ++y)
+	{
+		const int sy = std::min(y0 + y, height - 1);
+		for (int x = 0; x < 4; ++x)
+		{
+			const int sx = std::min(x0 + x, width - 1);
+			memcpy(block + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+		}
+	}
+}
+
+// per channel min and max of the 16 pixels
+static void BlockMinMax(const uint8_t block[64], uint8_t mn[4], uint8_t mx[4])
+{
+#ifdef BC_USE_SSE2
+	const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+	const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16));
+	const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32));
+	const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48));
+
+	__m128i lo = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+	__m128i hi = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	const uint32_t l = uint32_t(_mm_cvtsi128_si32(lo));
+	const uint32_t h = uint32_t(_mm_cvtsi128_si32(hi));
+	memcpy(mn, &l, 4);
+	memcpy(mx, &h, 4);
+#else
+	for (int c = 0; c < 4; ++c)
+	{
+		mn[c] = mx[c] = block[c];
+	}
+	for (int i = 1; i < 16; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			mn[c] = std::min(mn[c], block[i * 4 + c]);
+			mx[c] = std::max(mx[c], block[i * 4 + c]);
+		}
+	}
+#endif
+}
+
+static inline uint16_t To565(const int c[3])
+{
+	const int r = (std::min(std::max(c[0], 0), 255) * 249 + 1024) >> 11;
+	const int g = (std::min(std::max(c[1], 0), 255) * 253 + 512) >> 10;
+	const int b = (std::min(std::max(c[2], 0), 255) * 249 + 1024) >> 11;
+
+	return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static inline void From565(uint16_t v, int c[3])
+{
+	const int r = (v >> 11) & 31;
+	const int g = (v >> 5) & 63;
+	const int b = v & 31;
+
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+// nearest palette entry per pixel, 2 bits each; returns the summed squared error
+static uint32_t ColorIndices(const uint8_t block[64], const int palette[4][3], uint32_t& indices)
+{
+	indices = 0;
+
+#ifdef BC_USE_SSE2
+	__m128i pal[4];
+	for (int k = 0; k < 4; ++k)
+	{
+		const int* p = palette[k];
+		pal[k] = _mm_setr_epi16(short(p[0]), short(p[1]), short(p[2]), 0, short(p[0]), short(p[1]), short(p[2]), 0);
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+	__m128i errSum = zero;
+
+	for (int row = 0; row < 4; ++row)
+	{
+		const __m128i px = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + row * 16)), rgbMask);
+		const __m128i p01 = _mm_unpacklo_epi8(px, zero);
+		const __m128i p23 = _mm_unpackhi_epi8(px, zero);
+
+		__m128i best = _mm_set1_epi32(0x7FFFFFFF);
+		__m128i bestIdx = zero;
+
+		for (int k = 0; k < 4; ++k)
+		{
+			const __m128i d01 = _mm_sub_epi16(p01, pal[k]);
+			const __m128i d23 = _mm_sub_epi16(p23, pal[k]);
+
+			// r*r + g*g and b*b per pixel, folded into one lane per pixel
+			__m128i e01 = _mm_madd_epi16(d01, d01);
+			__m128i e23 = _mm_madd_epi16(d23, d23);
+			e01 = _mm_add_epi32(e01, _mm_shuffle_epi32(e01, _MM_SHUFFLE(2, 3, 0, 1)));
+			e23 = _mm_add_epi32(e23, _mm_shuffle_epi32(e23, _MM_SHUFFLE(2, 3, 0, 1)));
+			const __m128i e = _mm_unpacklo_epi64(_mm_shuffle_epi32(e01, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(e23, _MM_SHUFFLE(3, 1, 2, 0)));
+
+			const __m128i less = _mm_cmplt_epi32(e, best);
+			best = _mm_or_si128(_mm_and_si128(less, e), _mm_andnot_si128(less, best));
+			bestIdx = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(k)), _mm_andnot_si128(less, bestIdx));
+		}
+
+		errSum = _mm_add_epi32(errSum, best);
+
+		alignas(16) uint32_t idx[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(idx), bestIdx);
+		for (int i = 0; i < 4; ++i)
+		{
+			indices |= idx[i] << (2 * (row * 4 + i));
+		}
+	}
+
+	errSum = _mm_add_epi32(errSum, _mm_shuffle_epi32(errSum, _MM_SHUFFLE(1, 0, 3, 2)));
+	errSum = _mm_add_epi32(errSum, _mm_shuffle_epi32(errSum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	return uint32_t(_mm_cvtsi128_si32(errSum));
+#else
+	uint32_t err = 0;
+
+	for (int i = 0; i < 16; ++i)
+	{
+		const uint8_t* p = block + i * 4;
+		uint32_t best = ~0u;
+		uint32_t bestIdx = 0;
+
+		for (uint32_t k = 0; k < 4; ++k)
+		{
+			const int dr = p[0] - palette[k][0];
+			const int dg = p[1] - palette[k][1];
+			const int db = p[2] - palette[k][2];
+			const uint32_t e = uint32_t(dr * dr + dg * dg + db * db);
+			if (e < best)
+			{
+				best = e;
+				bestIdx = k;
+			}
+		}
+
+		err += best;
+		indices |= bestIdx << (2 * i);
+	}
+
+	return err;
+#endif
+}
+
+// quantizes the endpoints and picks indices in four color mode (c0 > c1)
+static uint32_t FitColors(const uint8_t block[64], const int e0[3], const int e1[3], uint16_t& c0, uint16_t& c1, uint32_t& indices)
+{
+	c0 = To565(e0);
+	c1 = To565(e1);
+	if (c0 < c1)
+	{
+		std::swap(c0, c1);
+	}
+
+	int palette[4][3];
+	From565(c0, palette[0]);
+	From565(c1, palette[1]);
+	for (int c = 0; c < 3; ++c)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	return ColorIndices(block, palette, indices);
+}
+
+static void EncodeColorBlock(const uint8_t block[64], const uint8_t mn[4], const uint8_t mx[4], uint8_t* dst)
+{
+	int lo[3], hi[3], mean[3] = {};
+	int axis = 0;
+
+	for (int c = 0; c < 3; ++c)
+	{
+		lo[c] = mn[c];
+		hi[c] = mx[c];
+		if (hi[c] - lo[c] > hi[axis] - lo[axis]) axis = c;
+	}
+
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 3; ++c) mean[c] += block[i * 4 + c];
+	}
+
+	// the box diagonal closest to the principal axis: channels falling while the widest one rises are flipped
+	for (int c = 0; c < 3; ++c)
+	{
+		if (c == axis) continue;
+
+		int cov = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			cov += (block[i * 4 + axis] * 16 - mean[axis]) * (block[i * 4 + c] * 16 - mean[c]);
+		}
+		if (cov < 0) std::swap(lo[c], hi[c]);
+	}
+
+	// pull the endpoints in by 1/16 of the range against outliers
+	for (int c = 0; c < 3; ++c)
+	{
+		const int inset = (hi[c] - lo[c]) / 16;
+		hi[c] -= inset;
+		lo[c] += inset;
+	}
+
+	uint16_t c0, c1;
+	uint32_t indices;
+	uint32_t err = FitColors(block, hi, lo, c0, c1, indices);
+
+	// one least squares refit of the endpoints against the chosen indices
+	if (err > 0 && c0 != c1)
+	{
+		static const int w1[4] = { 0, 3, 1, 2 };
+		int a = 0, b = 0, ab = 0;
+		int x[3] = {}, y[3] = {};
+
+		for (int i = 0; i < 16; ++i)
+		{
+			const int t1 = w1[(indices >> (2 * i)) & 3];
+			const int t0 = 3 - t1;
+			a += t0 * t0;
+			b += t1 * t1;
+			ab += t0 * t1;
+			for (int c = 0; c < 3; ++c)
+			{
+				x[c] += t0 * block[i * 4 + c];
+				y[c] += t1 * block[i * 4 + c];
+			}
+		}
+
+		const int det = a * b - ab * ab;
+		if (det != 0)
+		{
+			int r0[3], r1[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				r0[c] = 3 * (b * x[c] - ab * y[c]) / det;
+				r1[c] = 3 * (a * y[c] - ab * x[c]) / det;
+			}
+
+			uint16_t rc0, rc1;
+			uint32_t rindices;
+			const uint32_t rerr = FitColors(block, r0, r1, rc0, rc1, rindices);
+			if (rerr < err)
+			{
+				c0 = rc0;
+				c1 = rc1;
+				indices = rindices;
+			}
+		}
+	}
+
+	dst[0] = uint8_t(c0);
+	dst[1] = uint8_t(c0 >> 8);
+	dst[2] = uint8_t(c1);
+	dst[3] = uint8_t(c1 >> 8);
+	for (int i = 0; i < 4; ++i)
+	{
+		dst[4 + i] = uint8_t(indices >> (8 * i));
+	}
+}
+
+// eight value mode, a0 = max, a1 = min
+static void EncodeChannelBlock(const uint8_t block[64], int channel, int mn, int mx, uint8_t* dst)
+{
+	dst[0] = uint8_t(mx);
+	dst[1] = uint8_t(mn);
+
+	uint64_t bits = 0;
+	const int range = mx - mn;
+
+	if (range > 0)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			// nearest of the 8 steps from max (0) to min (7), remapped to the palette order
+			const int pos = ((mx - block[i * 4 + channel]) * 14 + range) / (2 * range);
+			const int idx = pos == 0 ? 0 : pos == 7 ? 1 : pos + 1;
+			bits |= uint64_t(idx) << (3 * i);
+		}
+	}
+
+	for (int i = 0; i < 6; ++i)
+	{
+		dst[2 + i] = uint8_t(bits >> (8 * i));
+	}
+}
+
+static void EncodeBlock(eBlockFormat format, const uint8_t block[64], uint8_t* dst)
+{
+	uint8_t mn[4], mx[4];
+	BlockMinMax(block, mn, mx);
+
+	switch (format)
+	{
+	case BF_BC1:
+		EncodeColorBlock(block, mn, mx, dst);
+		break;
+	case BF_BC3:
+		EncodeChannelBlock(block, 3, mn[3], mx[3], dst);
+		EncodeColorBlock(block, mn, mx, dst + 8);
+		break;
+	case BF_BC4:
+		EncodeChannelBlock(block, 0, mn[0], mx[0], dst);
+		break;
+	case BF_BC5:
+		EncodeChannelBlock(block, 0, mn[0], mx[0], dst);
+		EncodeChannelBlock(block, 1, mn[1], mx[1], dst + 8);
+		break;
+	}
+}
+
+void BC_Compress(eBlockFormat format, const uint8_t* rgba, int width, int height, uint8_t* dst)
+{
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+	const uint32_t blockBytes = BC_BlockBytes(format);
+
+	g_jobSystem.parallelFor(uint32_t(blocksY), BC_ROWS_PER_JOB, [=](uint32_t begin, uint32_t end)
+	{
+		alignas(16) uint8_t block[64];
+
+		for (uint32_t by = begin; by < end; ++by)
+		{
+			uint8_t* out = dst + size_t(by) * blocksX * blockBytes;
+			for (int bx = 0; bx < blocksX; ++bx, out += blockBytes)
+			{
+				LoadBlock(rgba, width, height, bx, int(by), block);
+				EncodeBlock(format, block, out);
+			}
+		}
+	});
+}
+
+static void DecodeColorBlock(const uint8_t* src, bool threeColorMode, uint8_t block[64])
+{
+	const uint16_t c0 = uint16_t(src[0] | (src[1] << 8));
+	const uint16_t c1 = uint16_t(src[2] | (src[3] << 8));
+
+	int palette[4][4];
+	From565(c0, palette[0]);
+	From565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+	// BC3 color blocks are always four color
+	if (c0 > c1 || !threeColorMode)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+	}
+	else
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+		palette[3][3] = 0;
+	}
+
+	const uint32_t indices = uint32_t(src[4]) | (uint32_t(src[5]) << 8) | (uint32_t(src[6]) << 16) | (uint32_t(src[7]) << 24);
+	for (int i = 0; i < 16; ++i)
+	{
+		const int* p = palette[(indices >> (2 * i)) & 3];
+		for (int c = 0; c < 4; ++c)
+		{
+			block[i * 4 + c] = uint8_t(p[c]);
+		}
+	}
+}
+
+static void DecodeChannelBlock(const uint8_t* src, int channel, uint8_t block[64])
+{
+	const int a0 = src[0];
+	const int a1 = src[1];
+
+	int palette[8] = { a0, a1 };
+	if (a0 > a1)
+	{
+		for (int k = 1; k < 7; ++k) palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+	}
+	else
+	{
+		for (int k = 1; k < 5; ++k) palette[k + 1] = ((5 - k) * a0 + k * a1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; ++i)
+	{
+		bits |= uint64_t(src[2 + i]) << (8 * i);
+	}
+
+	for (int i = 0; i < 16; ++i)
+	{
+		block[i * 4 + channel] = uint8_t(palette[(bits >> (3 * i)) & 7]);
+	}
+}
+
+void BC_Decompress(eBlockFormat format, const uint8_t* src, int width, int height, uint8_t* rgba)
+{
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+	const uint32_t blockBytes = BC_BlockBytes(format);
+
+	uint8_t block[64];
+
+	for (int by = 0; by < blocksY; ++by)
+	{
+		for (int bx = 0; bx < blocksX; ++bx, src += blockBytes)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				block[i * 4 + 0] = block[i * 4 + 1] = block[i * 4 + 2] = 0;
+				block[i * 4 + 3] = 255;
+			}
+
+			switch (format)
+			{
+			case BF_BC1:
+				DecodeColorBlock(src, true, block);
+				break;
+			case BF_BC3:
+				DecodeColorBlock(src + 8, false, block);
+				DecodeChannelBlock(src, 3, block);
+				break;
+			case BF_BC4:
+				DecodeChannelBlock(src, 0, block);
+				break;
+			case BF_BC5:
+				DecodeChannelBlock(src, 0, block);
+				DecodeChannelBlock(src + 8, 1, block);
+				break;
+			}
+
+			// edge blocks only partly cover the image
+			for (int y = 0; y < 4 && by * 4 + y < height; ++y)
+			{
+				for (int x = 0; x < 4 && bx * 4 + x < width; ++x)
+				{
+					memcpy(rgba + (size_t(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+/*
+Block compression of RGBA8 images into the BCn formats the engine uploads.
+
+Color blocks (BC1, the color half of BC3) start from the bounding box
+diagonal that best follows the block's principal axis, inset against
+outliers, then get one least squares refit of the endpoints; the better
+of the two is kept. Palette distances run four pixels at a time on
+SSE2 where available. Single channel blocks (BC4, BC3 alpha, both
+halves of BC5) use the exact min/max in eight value mode.
+
+Block rows are spread over g_jobSystem, without workers it runs inline.
+*/
+
+enum eBlockFormat
+{
+	BF_BC1,		// RGB, alpha ignored
+	BF_BC3,		// RGBA
+	BF_BC4,		// R
+	BF_BC5		// RG, for normal maps
+};
+
+// bytes per 4x4 block
+uint32_t BC_BlockBytes(eBlockFormat format);
+size_t BC_CompressedSize(eBlockFormat format, int width, int height);
+
+// true when any pixel has alpha below 255
+bool BC_HasAlpha(const uint8_t* rgba, int width, int height);
+
+// dst must hold BC_CompressedSize bytes, partial edge blocks repeat the last row/column
+void BC_Compress(eBlockFormat format, const uint8_t* rgba, int width, int height, uint8_t* dst);
+
+/*
+Reference decoder for tests and tools, rgba holds width * height * 4
+bytes. BC1 decodes its three color mode too (index 3 is transparent
+black), BC4 and BC5 leave the channels they lack at 0 with alpha 255.
+*/
+void BC_Decompress(eBlockFormat format, const uint8_t* src, int width, int height, uint8_t* rgba);
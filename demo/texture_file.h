@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cinttypes>
+
+/*
+Cooked texture files are plain DDS with the DX10 extension header
+
+	ddsHeader_t
+	ddsHeaderDX10_t			(when pixelFormat.fourCC is DDS_FOURCC_DX10)
+	level 0 blocks, level 1 blocks, ... down to 1x1
+
+so the mip chain can be handed to glCompressedTexImage2D straight from
+the mapped file. A cube map (DDS_RESOURCE_MISC_TEXTURECUBE) stores six
+such chains one after the other, in +X, -X, +Y, -Y, +Z, -Z order.
+Legacy DXT1/DXT5/ATI1/ATI2 headers (what SOIL writes) are accepted by
+the loader as well, DDSCAPS2_CUBEMAP marks their cube maps.
+*/
+
+#define DDS_MAGIC				0x20534444		// 'DDS '
+#define DDS_FOURCC(a, b, c, d)	(uint32_t(a) | (uint32_t(b) << 8) | (uint32_t(c) << 16) | (uint32_t(d) << 24))
+#define DDS_FOURCC_DX10			DDS_FOURCC('D', 'X', '1', '0')
+#define DDS_FOURCC_DXT1			DDS_FOURCC('D', 'X', 'T', '1')
+#define DDS_FOURCC_DXT5			DDS_FOURCC('D', 'X', 'T', '5')
+#define DDS_FOURCC_ATI1			DDS_FOURCC('A', 'T', 'I', '1')
+#define DDS_FOURCC_ATI2			DDS_FOURCC('A', 'T', 'I', '2')
+
+enum eDdsFlags
+{
+	DDSD_CAPS = 0x1,
+	DDSD_HEIGHT = 0x2,
+	DDSD_WIDTH = 0x4,
+	DDSD_PIXELFORMAT = 0x1000,
+	DDSD_MIPMAPCOUNT = 0x20000,
+	DDSD_LINEARSIZE = 0x80000,
+
+	DDPF_FOURCC = 0x4,
+
+	DDSCAPS_COMPLEX = 0x8,
+	DDSCAPS_TEXTURE = 0x1000,
+	DDSCAPS_MIPMAP = 0x400000,
+
+	DDSCAPS2_CUBEMAP = 0x200,
+	DDSCAPS2_CUBEMAP_ALLFACES = 0xFC00
+};
+
+// the DXGI formats the cooker writes
+enum eDxgiFormat
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_BC1_UNORM = 71,
+	DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+	DXGI_FORMAT_BC3_UNORM = 77,
+	DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+	DXGI_FORMAT_BC4_UNORM = 80,
+	DXGI_FORMAT_BC5_UNORM = 83
+};
+
+#define DDS_DIMENSION_TEXTURE2D	3
+#define DDS_RESOURCE_MISC_TEXTURECUBE	0x4
+
+struct ddsPixelFormat_t
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t rMask;
+	uint32_t gMask;
+	uint32_t bMask;
+	uint32_t aMask;
+};
+
+struct ddsHeader_t
+{
+	uint32_t magic;
+	uint32_t size;				// 124, magic excluded
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	ddsPixelFormat_t pixelFormat;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+
+struct ddsHeaderDX10_t
+{
+	uint32_t dxgiFormat;		// eDxgiFormat
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+
+static_assert(sizeof(ddsHeader_t) == 128, "DDS header layout");
+static_assert(sizeof(ddsHeaderDX10_t) == 20, "DDS DX10 header layout");
+
+// bytes per 4x4 block, 0 for formats the engine does not handle
+inline uint32_t DDS_BlockBytes(uint32_t dxgiFormat)
+{
+	switch (dxgiFormat)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+		return 8;
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM:
+		return 16;
+	}
+
+	return 0;
+}
+
+inline uint32_t DDS_LevelSize(uint32_t width, uint32_t height, uint32_t blockBytes)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
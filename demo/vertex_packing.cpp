@@ -0,0 +1,173 @@
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "heap.h"
+#include "mesh.h"
+#include "vertex_packing.h"
+
+static inline int16_t packSnorm16(float f)
+{
+	return static_cast<int16_t>(glm::packSnorm1x16(f));
+}
+
+static inline float unpackSnorm16(int16_t s)
+{
+	return glm::unpackSnorm1x16(static_cast<uint16_t>(s));
+}
+
+static glm::vec3 anyPerpendicular(const glm::vec3& n)
+{
+	const glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+	return glm::normalize(glm::cross(axis, n));
+}
+
+void Vertex_EncodeQTangent(const glm::vec3& normal, const glm::vec4& tangent, int16_t out[4])
+{
+	const glm::vec3 n = glm::normalize(normal);
+
+	// Gram-Schmidt, fall back to an arbitrary frame when the tangent is missing or parallel
+	glm::vec3 t = glm::vec3(tangent) - n * glm::dot(n, glm::vec3(tangent));
+	const float tlen = glm::length(t);
+	t = tlen > 1e-6f ? t / tlen : anyPerpendicular(n);
+
+	const glm::vec3 b = glm::cross(n, t);
+	glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, b, n)));
+
+	if (q.w < 0.0f) q = -q;
+
+	// keep w away from zero so its sign survives snorm16 quantization
+	const float bias = 1.0f / 32767.0f;
+	if (q.w < bias)
+	{
+		const float scale = std::sqrt(1.0f - bias * bias);
+		q.x *= scale;
+		q.y *= scale;
+		q.z *= scale;
+		q.w = bias;
+	}
+
+	if (tangent.w < 0.0f) q = -q;
+
+	out[0] = packSnorm16(q.x);
+	out[1] = packSnorm16(q.y);
+	out[2] = packSnorm16(q.z);
+	out[3] = packSnorm16(q.w);
+}
+
+void Vertex_DecodeQTangent(const int16_t in[4], glm::vec3& normal, glm::vec4& tangent)
+{
+	const glm::quat q = glm::normalize(glm::quat(unpackSnorm16(in[3]), unpackSnorm16(in[0]), unpackSnorm16(in[1]), unpackSnorm16(in[2])));
+
+	normal = q * glm::vec3(0, 0, 1);
+	tangent = glm::vec4(q * glm::vec3(1, 0, 0), q.w < 0.0f ? -1.0f : 1.0f);
+}
+
+uint16_t Vertex_EncodeHalf(float f)
+{
+	return glm::packHalf1x16(f);
+}
+
+float Vertex_DecodeHalf(uint16_t h)
+{
+	return glm::unpackHalf1x16(h);
+}
+
+uint8_t Vertex_EncodeUnorm8(float f)
+{
+	return static_cast<uint8_t>(glm::clamp(f, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+float Vertex_DecodeUnorm8(uint8_t u)
+{
+	return u / 255.0f;
+}
+
+glm::vec4 Vertex_ReadAttribute(const void* data, const VertexAttribute& va, int i, const glm::vec4& def)
+{
+	glm::vec4 result = def;
+	const int n = va.size < 4 ? va.size : 4;
+
+	switch (va.type)
+	{
+	case eDataType::FLOAT:
+	{
+		const float* p = static_cast<const float*>(data) + size_t(i) * va.size;
+		for (int c = 0; c < n; ++c) result[c] = p[c];
+		break;
+	}
+	case eDataType::UNSIGNED_BYTE:
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(data) + size_t(i) * va.size;
+		for (int c = 0; c < n; ++c) result[c] = va.normalized ? p[c] / 255.0f : float(p[c]);
+		break;
+	}
+	case eDataType::UNSIGNED_SHORT:
+	{
+		const uint16_t* p = static_cast<const uint16_t*>(data) + size_t(i) * va.size;
+		for (int c = 0; c < n; ++c) result[c] = va.normalized ? p[c] / 65535.0f : float(p[c]);
+		break;
+	}
+	case eDataType::HALF_FLOAT:
+	{
+		const uint16_t* p = static_cast<const uint16_t*>(data) + size_t(i) * va.size;
+		for (int c = 0; c < n; ++c) result[c] = Vertex_DecodeHalf(p[c]);
+		break;
+	}
+	default:
+		break;
+	}
+
+	return result;
+}
+
+int Vertex_BuildPackedStream(const Mesh3D& mesh, packedVertex_t** stream)
+{
+	*stream = nullptr;
+
+	const VertexAttribute& posLayout = mesh.getPositionLayout();
+	if (!posLayout.count || !mesh.getPositions())
+	{
+		return 0;
+	}
+
+	const int numVerts = posLayout.count;
+	packedVertex_t* out = static_cast<packedVertex_t*>(Mem_Alloc16(sizeof(packedVertex_t) * numVerts));
+
+	const bool hasNormals = mesh.getNormalLayout().count == numVerts && mesh.getNormals();
+	const bool hasTangents = mesh.getTangentLayout().count == numVerts && mesh.getTangents();
+	const bool hasTexCoords = mesh.getTexCoordLayout().count == numVerts && mesh.getTexCoords();
+	const bool hasColors = mesh.getColorLayout().count == numVerts && mesh.getColors();
+
+	const glm::vec4 zero(0, 0, 0, 0);
+	const glm::vec4 up(0, 0, 1, 0);
+	const glm::vec4 white(1, 1, 1, 1);
+
+	for (int i = 0; i < numVerts; ++i)
+	{
+		packedVertex_t& v = out[i];
+
+		const glm::vec4 p = Vertex_ReadAttribute(mesh.getPositions(), posLayout, i, zero);
+		v.position[0] = p.x;
+		v.position[1] = p.y;
+		v.position[2] = p.z;
+
+		const glm::vec4 n = hasNormals ? Vertex_ReadAttribute(mesh.getNormals(), mesh.getNormalLayout(), i, up) : up;
+		const glm::vec4 t = hasTangents ? Vertex_ReadAttribute(mesh.getTangents(), mesh.getTangentLayout(), i, glm::vec4(1, 0, 0, 1)) : glm::vec4(0, 0, 0, 1);
+		Vertex_EncodeQTangent(glm::vec3(n), t, v.qtangent);
+
+		const glm::vec4 st = hasTexCoords ? Vertex_ReadAttribute(mesh.getTexCoords(), mesh.getTexCoordLayout(), i, zero) : zero;
+		v.st[0] = Vertex_EncodeHalf(st.x);
+		v.st[1] = Vertex_EncodeHalf(st.y);
+
+		const glm::vec4 c = hasColors ? Vertex_ReadAttribute(mesh.getColors(), mesh.getColorLayout(), i, white) : white;
+		v.color[0] = Vertex_EncodeUnorm8(c.r);
+		v.color[1] = Vertex_EncodeUnorm8(c.g);
+		v.color[2] = Vertex_EncodeUnorm8(c.b);
+		v.color[3] = Vertex_EncodeUnorm8(c.a);
+	}
+
+	*stream = out;
+
+	return numVerts;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cinttypes>
+#include <glm/glm.hpp>
+#include "gpu_vertex_layout.h"
+
+class Mesh3D;
+
+/*
+Interleaved, quantized vertex used by RenderMesh3D's packed layout.
+Attribute locations match assets/shaders/drawvert_layout.inc.glsl:
+
+	0: va_position	float3
+	1: va_qtangent	snorm16x4, tangent frame quaternion, sign(w) = bitangent sign
+	2: va_st		half2
+	3: va_color		unorm8x4
+
+28 bytes per vertex against 64 bytes for the separate float streams.
+*/
+struct packedVertex_t
+{
+	float position[3];
+	int16_t qtangent[4];
+	uint16_t st[2];
+	uint8_t color[4];
+};
+
+static_assert(sizeof(packedVertex_t) == 28, "packedVertex_t must stay tightly packed");
+
+#define PACKED_VERTEX_LOC_POSITION	0
+#define PACKED_VERTEX_LOC_QTANGENT	1
+#define PACKED_VERTEX_LOC_ST		2
+#define PACKED_VERTEX_LOC_COLOR		3
+
+// quantization helpers, exposed so the encode/decode error can be checked on the CPU
+void Vertex_EncodeQTangent(const glm::vec3& normal, const glm::vec4& tangent, int16_t out[4]);
+void Vertex_DecodeQTangent(const int16_t in[4], glm::vec3& normal, glm::vec4& tangent);
+uint16_t Vertex_EncodeHalf(float f);
+float Vertex_DecodeHalf(uint16_t h);
+// clamped to [0, 1]
+uint8_t Vertex_EncodeUnorm8(float f);
+float Vertex_DecodeUnorm8(uint8_t u);
+
+// reads element i of a tightly packed attribute array, missing components come from def
+glm::vec4 Vertex_ReadAttribute(const void* data, const VertexAttribute& va, int i, const glm::vec4& def);
+
+/*
+Builds the interleaved stream of mesh into a Mem_Alloc16 block.
+Returns the number of vertices, 0 if the mesh has no positions.
+The caller frees *stream with Mem_Free16.
+*/
+int Vertex_BuildPackedStream(const Mesh3D& mesh, packedVertex_t** stream);
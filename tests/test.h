@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+
+/*
+Minimal checks for the CPU-side tests run by ctest. A failed check prints
+its location and the test keeps going, TEST_RESULT() is main's return
+value: 0 when every check passed.
+*/
+static int g_testFailures = 0;
+
+#define TEST_CHECK(cond, ...) \
+	do { \
+		if (!(cond)) \
+		{ \
+			++g_testFailures; \
+			printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} while (0)
+
+#define TEST_RESULT() (printf("%s\n", g_testFailures ? "FAILED" : "passed"), g_testFailures ? 1 : 0)
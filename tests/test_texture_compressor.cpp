@@ -0,0 +1,268 @@
+/*
+Encodes fixed synthetic images with BC_Compress and decodes them with
+BC_Decompress, the PSNR of every format must stay above its threshold:
+- color: smooth gradients, an 8 pixel checker and an antialiased disc,
+  with an alpha ramp for BC3
+- normal: a bumpy height field, x and y in red and green for BC5
+The size is not a multiple of 4, so the edge blocks are covered too.
+
+usage: test_texture_compressor [texture directory]
+
+With a directory (ctest passes assets/textures) every png and jpg under
+it is encoded to BC1 and BC3 and also with SOIL's DXT1 / DXT5 encoder,
+the one the demo used before the cooker: ours must not be more than
+SOIL_EPSILON worse.
+*/
+#include <cmath>
+#include <cstdlib>
+#include <cinttypes>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <filesystem>
+#include <SOIL2.h>
+extern "C" {
+#include <image_DXT.h>
+}
+#include "texture_compressor.h"
+#include "test.h"
+
+static const int IMAGE_W = 250;
+static const int IMAGE_H = 250;
+
+// dB, the encoder reaches 42.6 (BC1, BC3 rgb), 53.3 (BC3 alpha, BC4) and 52.8 (BC5)
+static const double BC1_MIN_PSNR = 40.0;
+static const double BC3_MIN_PSNR_RGB = 40.0;
+static const double BC3_MIN_PSNR_ALPHA = 50.0;
+static const double BC4_MIN_PSNR = 50.0;
+static const double BC5_MIN_PSNR = 50.0;
+
+// dB, against SOIL on the same image
+static const double SOIL_EPSILON = 0.1;
+
+static uint8_t toByte(float f)
+{
+	return uint8_t(std::min(std::max(f, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+static std::vector<uint8_t> makeColorImage()
+{
+	std::vector<uint8_t> rgba(size_t(IMAGE_W) * IMAGE_H * 4);
+
+	for (int y = 0; y < IMAGE_H; ++y)
+	{
+		for (int x = 0; x < IMAGE_W; ++x)
+		{
+			const float u = float(x) / IMAGE_W;
+			const float v = float(y) / IMAGE_H;
+			float r, g, b;
+
+			if (u < 0.5f && v < 0.5f)
+			{
+				r = u * 2.0f;
+				g = v * 2.0f;
+				b = 1.0f - u - v;
+			}
+			else if (u >= 0.5f && v < 0.5f)
+			{
+				const float c = ((x / 8 + y / 8) & 1) ? 0.9f : 0.15f;
+				r = c;
+				g = c * 0.8f;
+				b = c * 0.6f;
+			}
+			else
+			{
+				// antialiased disc over a diagonal ramp
+				const float dx = u - 0.5f, dy = v - 0.75f;
+				const float cover = std::min(std::max((0.2f - std::sqrt(dx * dx + dy * dy)) * IMAGE_W, 0.0f), 1.0f);
+				const float ramp = (u + v) * 0.5f;
+				r = ramp * (1.0f - cover) + 0.95f * cover;
+				g = 0.3f * (1.0f - cover) + 0.2f * cover;
+				b = (1.0f - ramp) * (1.0f - cover) + 0.1f * cover;
+			}
+
+			uint8_t* p = &rgba[(size_t(y) * IMAGE_W + x) * 4];
+			p[0] = toByte(r);
+			p[1] = toByte(g);
+			p[2] = toByte(b);
+			p[3] = toByte(0.25f + 0.75f * u);
+		}
+	}
+
+	return rgba;
+}
+
+static std::vector<uint8_t> makeNormalImage()
+{
+	std::vector<uint8_t> rgba(size_t(IMAGE_W) * IMAGE_H * 4);
+
+	for (int y = 0; y < IMAGE_H; ++y)
+	{
+		for (int x = 0; x < IMAGE_W; ++x)
+		{
+			// gradient of h = 3 sin(x / 9) cos(y / 13)
+			const float dhdx = 3.0f / 9.0f * std::cos(x / 9.0f) * std::cos(y / 13.0f);
+			const float dhdy = -3.0f / 13.0f * std::sin(x / 9.0f) * std::sin(y / 13.0f);
+			const float len = std::sqrt(dhdx * dhdx + dhdy * dhdy + 1.0f);
+
+			uint8_t* p = &rgba[(size_t(y) * IMAGE_W + x) * 4];
+			p[0] = toByte(-dhdx / len * 0.5f + 0.5f);
+			p[1] = toByte(-dhdy / len * 0.5f + 0.5f);
+			p[2] = toByte(1.0f / len * 0.5f + 0.5f);
+			p[3] = 255;
+		}
+	}
+
+	return rgba;
+}
+
+// over the channels [first, first + count)
+static double psnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int first, int count)
+{
+	double sum = 0.0;
+	const size_t pixels = a.size() / 4;
+
+	for (size_t i = 0; i < pixels; ++i)
+	{
+		for (int c = first; c < first + count; ++c)
+		{
+			const double d = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+			sum += d * d;
+		}
+	}
+
+	const double mse = sum / double(pixels * count);
+	return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static std::vector<uint8_t> roundTrip(eBlockFormat format, const std::vector<uint8_t>& rgba, int w = IMAGE_W, int h = IMAGE_H)
+{
+	std::vector<uint8_t> blocks(BC_CompressedSize(format, w, h));
+	std::vector<uint8_t> decoded(rgba.size());
+
+	BC_Compress(format, rgba.data(), w, h, blocks.data());
+	BC_Decompress(format, blocks.data(), w, h, decoded.data());
+
+	return decoded;
+}
+
+// SOIL writes the same block layout, BC_Decompress reads it back
+static std::vector<uint8_t> soilRoundTrip(eBlockFormat format, const std::vector<uint8_t>& rgba, int w, int h)
+{
+	std::vector<uint8_t> decoded(rgba.size());
+
+	int size = 0;
+	unsigned char* blocks = format == BF_BC1
+		? convert_image_to_DXT1(rgba.data(), w, h, 4, &size)
+		: convert_image_to_DXT5(rgba.data(), w, h, 4, &size);
+
+	if (!blocks || size_t(size) != BC_CompressedSize(format, w, h))
+	{
+		TEST_CHECK(false, "SOIL DXT encode failed for %dx%d", w, h);
+		free(blocks);
+		return decoded;
+	}
+
+	BC_Decompress(format, blocks, w, h, decoded.data());
+	free(blocks);
+
+	return decoded;
+}
+
+static void testAssets(const char* dir)
+{
+	namespace fs = std::filesystem;
+
+	std::error_code ec;
+	std::vector<fs::path> files;
+	for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+	{
+		const std::string ext = it->path().extension().string();
+		if (ext == ".png" || ext == ".jpg")
+		{
+			files.push_back(it->path());
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	TEST_CHECK(!ec && !files.empty(), "no textures under %s", dir);
+
+	for (const fs::path& file : files)
+	{
+		int w, h, channels;
+		unsigned char* pixels = SOIL_load_image(file.string().c_str(), &w, &h, &channels, SOIL_LOAD_RGBA);
+		if (!pixels)
+		{
+			TEST_CHECK(false, "cannot load %s", file.string().c_str());
+			continue;
+		}
+
+		const std::vector<uint8_t> rgba(pixels, pixels + size_t(w) * h * 4);
+		SOIL_free_image_data(pixels);
+
+		const double bc1 = psnr(rgba, roundTrip(BF_BC1, rgba, w, h), 0, 3);
+		const double soil1 = psnr(rgba, soilRoundTrip(BF_BC1, rgba, w, h), 0, 3);
+
+		const std::vector<uint8_t> bc3 = roundTrip(BF_BC3, rgba, w, h);
+		const std::vector<uint8_t> soil3 = soilRoundTrip(BF_BC3, rgba, w, h);
+		const double bc3Rgb = psnr(rgba, bc3, 0, 3), soil3Rgb = psnr(rgba, soil3, 0, 3);
+		const double bc3Alpha = psnr(rgba, bc3, 3, 1), soil3Alpha = psnr(rgba, soil3, 3, 1);
+
+		const std::string name = file.filename().string();
+		TEST_CHECK(bc1 >= soil1 - SOIL_EPSILON, "%s: BC1 PSNR %.2f dB, SOIL %.2f", name.c_str(), bc1, soil1);
+		TEST_CHECK(bc3Rgb >= soil3Rgb - SOIL_EPSILON, "%s: BC3 rgb PSNR %.2f dB, SOIL %.2f", name.c_str(), bc3Rgb, soil3Rgb);
+		TEST_CHECK(bc3Alpha >= soil3Alpha - SOIL_EPSILON, "%s: BC3 alpha PSNR %.2f dB, SOIL %.2f", name.c_str(), bc3Alpha, soil3Alpha);
+
+		printf("%s %dx%d: BC1 %.2f (SOIL %.2f) dB, BC3 rgb %.2f (%.2f) alpha %.2f (%.2f) dB\n",
+			name.c_str(), w, h, bc1, soil1, bc3Rgb, soil3Rgb, bc3Alpha, soil3Alpha);
+	}
+}
+
+// colors on the 565 grid and any single channel value come back unchanged
+static void testFlat()
+{
+	std::vector<uint8_t> rgba(size_t(IMAGE_W) * IMAGE_H * 4);
+	for (size_t i = 0; i < rgba.size(); i += 4)
+	{
+		rgba[i + 0] = 255;
+		rgba[i + 1] = 130;
+		rgba[i + 2] = 0;
+		rgba[i + 3] = 77;
+	}
+
+	const std::vector<uint8_t> bc1 = roundTrip(BF_BC1, rgba);
+	const std::vector<uint8_t> bc3 = roundTrip(BF_BC3, rgba);
+
+	TEST_CHECK(psnr(rgba, bc1, 0, 3) == 99.0, "flat BC1 block is not exact");
+	TEST_CHECK(psnr(rgba, bc3, 0, 4) == 99.0, "flat BC3 block is not exact");
+}
+
+int main(int argc, char** argv)
+{
+	testFlat();
+
+	const std::vector<uint8_t> color = makeColorImage();
+	const std::vector<uint8_t> normal = makeNormalImage();
+
+	const double bc1 = psnr(color, roundTrip(BF_BC1, color), 0, 3);
+	const std::vector<uint8_t> bc3 = roundTrip(BF_BC3, color);
+	const double bc3Rgb = psnr(color, bc3, 0, 3);
+	const double bc3Alpha = psnr(color, bc3, 3, 1);
+	const double bc4 = psnr(color, roundTrip(BF_BC4, color), 0, 1);
+	const double bc5 = psnr(normal, roundTrip(BF_BC5, normal), 0, 2);
+
+	TEST_CHECK(bc1 >= BC1_MIN_PSNR, "BC1 PSNR %.2f dB, expected at least %.2f", bc1, BC1_MIN_PSNR);
+	TEST_CHECK(bc3Rgb >= BC3_MIN_PSNR_RGB, "BC3 rgb PSNR %.2f dB, expected at least %.2f", bc3Rgb, BC3_MIN_PSNR_RGB);
+	TEST_CHECK(bc3Alpha >= BC3_MIN_PSNR_ALPHA, "BC3 alpha PSNR %.2f dB, expected at least %.2f", bc3Alpha, BC3_MIN_PSNR_ALPHA);
+	TEST_CHECK(bc4 >= BC4_MIN_PSNR, "BC4 PSNR %.2f dB, expected at least %.2f", bc4, BC4_MIN_PSNR);
+	TEST_CHECK(bc5 >= BC5_MIN_PSNR, "BC5 PSNR %.2f dB, expected at least %.2f", bc5, BC5_MIN_PSNR);
+
+	printf("PSNR: BC1 %.2f dB, BC3 rgb %.2f dB alpha %.2f dB, BC4 %.2f dB, BC5 %.2f dB\n", bc1, bc3Rgb, bc3Alpha, bc4, bc5);
+
+	if (argc > 1)
+	{
+		testAssets(argv[1]);
+	}
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,154 @@
+/*
+Encode -> decode round trips of the packed vertex quantizers against
+their error bounds:
+- qtangent: normal and tangent direction within QTANGENT_MAX_ANGLE, the
+  bitangent sign exact
+- half: within half an ulp of the value, 2^-11 relative
+- unorm8: within half a step, 0.5 / 255
+*/
+#include <cmath>
+#include <cinttypes>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "vertex_packing.h"
+#include "test.h"
+
+// radians, snorm16 components leave about 3e-5 per axis
+static const float QTANGENT_MAX_ANGLE = 2e-4f;
+
+static float angleBetween(const glm::vec3& a, const glm::vec3& b)
+{
+	return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+}
+
+// fixed sequence so the test sees the same vectors every run
+static float nextRandom(uint32_t& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return float(state >> 8) / float(1 << 24);
+}
+
+static glm::vec3 randomDirection(uint32_t& state)
+{
+	for (;;)
+	{
+		const glm::vec3 v(nextRandom(state) * 2.0f - 1.0f, nextRandom(state) * 2.0f - 1.0f, nextRandom(state) * 2.0f - 1.0f);
+		const float len = glm::length(v);
+		if (len > 0.1f && len <= 1.0f)
+		{
+			return v / len;
+		}
+	}
+}
+
+static void checkQTangent(const glm::vec3& n, const glm::vec4& t, float& maxNormalError, float& maxTangentError)
+{
+	int16_t q[4];
+	glm::vec3 dn;
+	glm::vec4 dt;
+
+	Vertex_EncodeQTangent(n, t, q);
+	Vertex_DecodeQTangent(q, dn, dt);
+
+	// the encoder orthogonalizes the tangent against the normal first
+	const glm::vec3 tOrtho = glm::normalize(glm::vec3(t) - n * glm::dot(n, glm::vec3(t)));
+
+	const float normalError = angleBetween(n, dn);
+	const float tangentError = angleBetween(tOrtho, glm::vec3(dt));
+
+	maxNormalError = std::max(maxNormalError, normalError);
+	maxTangentError = std::max(maxTangentError, tangentError);
+
+	TEST_CHECK(normalError <= QTANGENT_MAX_ANGLE, "normal (%f %f %f) off by %g rad", n.x, n.y, n.z, normalError);
+	TEST_CHECK(tangentError <= QTANGENT_MAX_ANGLE, "tangent (%f %f %f) off by %g rad", t.x, t.y, t.z, tangentError);
+	TEST_CHECK(dt.w == t.w, "bitangent sign %f decoded as %f", t.w, dt.w);
+}
+
+static void testQTangent()
+{
+	float maxNormalError = 0.0f;
+	float maxTangentError = 0.0f;
+
+	// axis aligned frames, including the w ~ 0 quaternions the encoder biases
+	const glm::vec3 axes[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	for (const glm::vec3& n : axes)
+	{
+		for (const glm::vec3& t : axes)
+		{
+			if (std::fabs(glm::dot(n, t)) > 0.5f) continue;
+
+			checkQTangent(n, glm::vec4(t, 1.0f), maxNormalError, maxTangentError);
+			checkQTangent(n, glm::vec4(t, -1.0f), maxNormalError, maxTangentError);
+		}
+	}
+
+	uint32_t state = 12345;
+	for (int i = 0; i < 100000; ++i)
+	{
+		const glm::vec3 n = randomDirection(state);
+		glm::vec3 t = randomDirection(state);
+		if (glm::length(glm::cross(n, t)) < 0.05f) continue;
+
+		checkQTangent(n, glm::vec4(t, (i & 1) ? 1.0f : -1.0f), maxNormalError, maxTangentError);
+	}
+
+	printf("qtangent: max normal error %g rad, max tangent error %g rad\n", maxNormalError, maxTangentError);
+}
+
+static void testHalf()
+{
+	float maxRelError = 0.0f;
+
+	// texture coordinates, tiled ones included
+	for (int i = 0; i <= 65536; ++i)
+	{
+		const float f = -8.0f + 16.0f * float(i) / 65536.0f;
+		const float d = Vertex_DecodeHalf(Vertex_EncodeHalf(f));
+
+		// below 2^-14 halves are denormal, the step is a constant 2^-24
+		const float bound = std::max(std::fabs(f) * std::ldexp(1.0f, -11), std::ldexp(1.0f, -25));
+		TEST_CHECK(std::fabs(d - f) <= bound, "%g decoded as %g", f, d);
+
+		if (f != 0.0f) maxRelError = std::max(maxRelError, std::fabs(d - f) / std::fabs(f));
+	}
+
+	const float exact[] = { 0.0f, 1.0f, -1.0f, 0.5f, 0.25f, 2048.0f, 65504.0f };
+	for (float f : exact)
+	{
+		TEST_CHECK(Vertex_DecodeHalf(Vertex_EncodeHalf(f)) == f, "%g is not exact", f);
+	}
+
+	printf("half: max relative error %g\n", maxRelError);
+}
+
+static void testUnorm8()
+{
+	float maxError = 0.0f;
+
+	for (int i = 0; i <= 10000; ++i)
+	{
+		const float f = float(i) / 10000.0f;
+		const float d = Vertex_DecodeUnorm8(Vertex_EncodeUnorm8(f));
+
+		TEST_CHECK(std::fabs(d - f) <= 0.5f / 255.0f + 1e-6f, "%g decoded as %g", f, d);
+		maxError = std::max(maxError, std::fabs(d - f));
+	}
+
+	for (int u = 0; u < 256; ++u)
+	{
+		TEST_CHECK(Vertex_EncodeUnorm8(Vertex_DecodeUnorm8(uint8_t(u))) == u, "%d does not survive a round trip", u);
+	}
+
+	TEST_CHECK(Vertex_EncodeUnorm8(-0.5f) == 0 && Vertex_EncodeUnorm8(1.5f) == 255, "out of range values are not clamped");
+
+	printf("unorm8: max error %g\n", maxError);
+}
+
+int main()
+{
+	testQTangent();
+	testHalf();
+	testUnorm8();
+
+	return TEST_RESULT();
+}
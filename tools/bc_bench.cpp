@@ -0,0 +1,122 @@
+/*
+Block compression benchmark: encodes an image into every BC format the
+cooker writes and prints the median encode time, the throughput and the
+PSNR of the decoded result.
+
+usage: bc_bench <input image> [-threads N] [-reps N]
+
+PSNR covers the channels a format keeps: rgb for BC1, rgb and alpha
+apart for BC3, red for BC4, red and green for BC5. -threads is the
+g_jobSystem size (default: hardware concurrency), -reps (default 9)
+encodes are timed after one warm-up encode.
+*/
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <SOIL2.h>
+#include "logger.h"
+#include "job_system.h"
+#include "texture_compressor.h"
+
+static double Bench_Psnr(const uint8_t* a, const uint8_t* b, size_t pixels, int first, int count)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < pixels; ++i)
+	{
+		for (int c = first; c < first + count; ++c)
+		{
+			const double d = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+			sum += d * d;
+		}
+	}
+
+	const double mse = sum / double(pixels * count);
+	return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <input image> [-threads N] [-reps N]\n", argv[0]);
+		return 1;
+	}
+
+	int threads = 0;
+	int reps = 9;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-threads") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-reps") && i + 1 < argc) reps = std::max(1, atoi(argv[++i]));
+		else
+		{
+			Error("Unknown option %s", argv[i]);
+			return 1;
+		}
+	}
+
+	int w, h, channels;
+	unsigned char* pixels = SOIL_load_image(argv[1], &w, &h, &channels, SOIL_LOAD_RGBA);
+	if (!pixels)
+	{
+		Error("Cannot load %s: %s", argv[1], SOIL_last_result());
+		return 1;
+	}
+
+	g_jobSystem.init(threads);
+
+	struct format_t
+	{
+		const char* name;
+		eBlockFormat format;
+	};
+
+	const format_t formats[] = { { "BC1", BF_BC1 }, { "BC3", BF_BC3 }, { "BC4", BF_BC4 }, { "BC5", BF_BC5 } };
+
+	const size_t numPixels = size_t(w) * h;
+	std::vector<uint8_t> decoded(numPixels * 4);
+
+	printf("%s, %dx%d, %d threads, median of %d encodes\n", argv[1], w, h, g_jobSystem.getNumThreads(), reps);
+	printf("%-6s %10s %10s %10s %10s\n", "format", "ms", "MPix/s", "PSNR", "alpha");
+
+	for (const format_t& f : formats)
+	{
+		std::vector<uint8_t> blocks(BC_CompressedSize(f.format, w, h));
+		std::vector<float> ms;
+
+		BC_Compress(f.format, pixels, w, h, blocks.data());
+
+		for (int r = 0; r < reps; ++r)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			BC_Compress(f.format, pixels, w, h, blocks.data());
+			ms.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		std::sort(ms.begin(), ms.end());
+		const float median = ms[ms.size() / 2];
+
+		BC_Decompress(f.format, blocks.data(), w, h, decoded.data());
+
+		const int numChannels = f.format == BF_BC4 ? 1 : f.format == BF_BC5 ? 2 : 3;
+		const double psnr = Bench_Psnr(pixels, decoded.data(), numPixels, 0, numChannels);
+
+		char alpha[16] = "-";
+		if (f.format == BF_BC3)
+		{
+			snprintf(alpha, sizeof(alpha), "%.2f", Bench_Psnr(pixels, decoded.data(), numPixels, 3, 1));
+		}
+
+		printf("%-6s %10.3f %10.2f %10.2f %10s\n", f.name, median, median > 0.0f ? float(numPixels) / (median * 1000.0f) : 0.0f, psnr, alpha);
+	}
+
+	SOIL_free_image_data(pixels);
+	g_jobSystem.shutdown();
+
+	return 0;
+}
@@ -0,0 +1,467 @@
+/*
+Headless effect benchmark: renders one effect into an offscreen
+framebuffer through an EGL context without a window (surfaceless where
+the driver has it, Mesa llvmpipe does), so it runs on build machines
+with no GPU and no display.
+
+usage: demo_bench <effect> [-frames N] [-warmup N] [-size WxH] [-step ms]
+                  [-inflight N] [-root dir] [-dump dir] [-dumpevery N]
+                  [-csv file] [-trace file]
+
+Every frame runs exactly one simulation step of -step ms (default 1000/60),
+so the rendered images and the work per frame are the same on every
+run. The summary gives mean, median and 95th percentile of CPU time,
+GPU time and latency per frame and the mean GPU time of every profiled
+pass; the warm-up frames (shader compiles, first uploads) are left out.
+
+-csv writes one line per measured frame, -trace a Chrome trace of the
+measured frames with CPU and GPU scopes. -dump writes every -dumpevery'th
+measured frame (default 60) as PNG for image diffing; reading the pixels
+back stalls the GPU, so timings of a dumping run are not comparable.
+*/
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <SDL.h>
+#include <SOIL2.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "demo.h"
+#include "logger.h"
+#include "filesystem.h"
+#include "job_system.h"
+#include "asset_manager.h"
+#include "effect_registry.h"
+#include "fixed_timestep.h"
+#include "profiler.h"
+#include "gpu_profiler.h"
+#include "frame_scheduler.h"
+#include "gpu_framebuffer.h"
+#include "gpu_program.h"
+#include "program_cache.h"
+#include "gpu_utils.h"
+#include "pipeline.h"
+
+// effects read the render size from here, demo.cpp is not linked
+VideoConfig videoConf;
+
+struct eglContext_t
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+};
+
+static bool Bench_CreateContext(eglContext_t& egl)
+{
+	const char* clientExt = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	// surfaceless needs no X server or DRM device, fall back to the default display
+	if (clientExt && strstr(clientExt, "EGL_MESA_platform_surfaceless"))
+	{
+		auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay)
+		{
+			egl.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+	}
+	if (egl.display == EGL_NO_DISPLAY)
+	{
+		egl.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	EGLint major = 0, minor = 0;
+	if (egl.display == EGL_NO_DISPLAY || !eglInitialize(egl.display, &major, &minor))
+	{
+		Error("Cannot initialize EGL (0x%x)", eglGetError());
+		return false;
+	}
+
+	const char* ext = eglQueryString(egl.display, EGL_EXTENSIONS);
+	if (!ext || !strstr(ext, "EGL_KHR_surfaceless_context") || !strstr(ext, "EGL_KHR_create_context"))
+	{
+		Error("EGL %d.%d lacks EGL_KHR_surfaceless_context or EGL_KHR_create_context", major, minor);
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		Error("EGL cannot bind the desktop OpenGL API");
+		return false;
+	}
+
+	// the image goes to a framebuffer object, any config will do, or none
+	EGLConfig config = nullptr;
+	const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLint numConfigs = 0;
+	eglChooseConfig(egl.display, configAttribs, &config, 1, &numConfigs);
+	if (numConfigs == 0 && !strstr(ext, "EGL_KHR_no_config_context") && !strstr(ext, "EGL_MESA_configless_context"))
+	{
+		Error("EGL has no OpenGL config");
+		return false;
+	}
+
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	egl.context = eglCreateContext(egl.display, numConfigs ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttribs);
+	if (egl.context == EGL_NO_CONTEXT || !eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl.context))
+	{
+		Error("Cannot create an OpenGL 4.5 core context (0x%x)", eglGetError());
+		return false;
+	}
+
+	glewExperimental = true;
+	if (glewInit() != GLEW_OK)
+	{
+		Error("Cannot initialize GLEW");
+		return false;
+	}
+
+	Info("EGL %d.%d, GL Renderer: %s, GL Version: %s", major, minor, glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+	videoConf.glVersion = 450;
+	videoConf.explicitUnifromLocationEXT = GLEW_ARB_explicit_uniform_location != GL_FALSE;
+
+	GpuProgramBatch::init();
+
+	return true;
+}
+
+static void Bench_DestroyContext(eglContext_t& egl)
+{
+	if (egl.display == EGL_NO_DISPLAY)
+	{
+		return;
+	}
+
+	eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (egl.context != EGL_NO_CONTEXT)
+	{
+		eglDestroyContext(egl.display, egl.context);
+	}
+	eglTerminate(egl.display);
+}
+
+static bool Bench_DumpFrame(Pipeline& pipeline, GpuFrameBuffer& fb, const std::string& fileName, int w, int h)
+{
+	std::vector<uint8_t> pixels(size_t(w) * h * 4);
+
+	pipeline.bindFrameBuffer(&fb);
+	GL_CHECK(glReadBuffer(GL_COLOR_ATTACHMENT0));
+	GL_CHECK(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	GL_CHECK(glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data()));
+
+	// GL rows go bottom up, PNG rows top down
+	const size_t pitch = size_t(w) * 4;
+	std::vector<uint8_t> row(pitch);
+	for (int y = 0; y < h / 2; ++y)
+	{
+		uint8_t* a = pixels.data() + pitch * y;
+		uint8_t* b = pixels.data() + pitch * (h - 1 - y);
+		memcpy(row.data(), a, pitch);
+		memcpy(a, b, pitch);
+		memcpy(b, row.data(), pitch);
+	}
+
+	if (!SOIL_save_image(fileName.c_str(), SOIL_SAVE_TYPE_PNG, w, h, 4, pixels.data()))
+	{
+		Error("Cannot write %s", fileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+struct stats_t
+{
+	float mean, median, p95, min, max;
+};
+
+static stats_t Bench_Stats(std::vector<float> samples)
+{
+	stats_t s = {};
+	if (samples.empty())
+	{
+		return s;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (float v : samples) sum += v;
+
+	s.mean = float(sum / samples.size());
+	s.median = samples[samples.size() / 2];
+	s.p95 = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+	s.min = samples.front();
+	s.max = samples.back();
+
+	return s;
+}
+
+static void Bench_PrintStats(const char* name, const std::vector<float>& samples)
+{
+	const stats_t s = Bench_Stats(samples);
+	printf("%-12s %9.3f %9.3f %9.3f %9.3f %9.3f %7d\n", name, s.mean, s.median, s.p95, s.min, s.max, int(samples.size()));
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <effect> [-frames N] [-warmup N] [-size WxH] [-step ms] [-inflight N] [-root dir] [-dump dir] [-dumpevery N] [-csv file] [-trace file]\n", argv[0]);
+		fprintf(stderr, "effects:\n");
+		for (const effectInfo_t& info : Effect_List())
+		{
+			fprintf(stderr, "  %-12s %s\n", info.name, info.description);
+		}
+		return 1;
+	}
+
+	const std::string effectName = argv[1];
+	int numFrames = 300;
+	int warmup = 30;
+	int width = 1280, height = 720;
+	double stepMs = 1000.0 / 60.0;
+	int inFlight = 2;
+	int dumpEvery = 60;
+	std::string root = ".";
+	std::string dumpDir, csvFile, traceFile;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-frames") && i + 1 < argc) numFrames = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-warmup") && i + 1 < argc) warmup = std::max(0, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-size") && i + 1 < argc)
+		{
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+			{
+				Error("Bad size %s, expected WxH", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "-step") && i + 1 < argc) stepMs = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-inflight") && i + 1 < argc) inFlight = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-root") && i + 1 < argc) root = argv[++i];
+		else if (!strcmp(argv[i], "-dump") && i + 1 < argc) dumpDir = argv[++i];
+		else if (!strcmp(argv[i], "-dumpevery") && i + 1 < argc) dumpEvery = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-csv") && i + 1 < argc) csvFile = argv[++i];
+		else if (!strcmp(argv[i], "-trace") && i + 1 < argc) traceFile = argv[++i];
+		else
+		{
+			Error("Unknown option %s", argv[i]);
+			return 1;
+		}
+	}
+
+	g_fileSystem.set_working_dir(root);
+	g_profiler.setThreadName("Main");
+	g_jobSystem.init();
+
+	eglContext_t egl;
+	if (!Bench_CreateContext(egl))
+	{
+		Bench_DestroyContext(egl);
+		g_jobSystem.shutdown();
+		return 1;
+	}
+
+	videoConf.width = width;
+	videoConf.height = height;
+
+	g_frameScheduler.init(inFlight);
+	g_assetManager.init();
+	g_programCache.init(g_fileSystem.resolve("cache/programs"));
+	g_gpuProfiler.init();
+
+	int result = 1;
+	{
+		GpuFrameBuffer target;
+		const bool targetOk = target.create()
+			.addColorAttachment(0, width, height, eTextureFormat::SRGB_A)
+			.setDepthStencilAttachment(width, height)
+			.checkCompletness();
+		GpuFrameBuffer::setBackBuffer(&target);
+
+		Pipeline pipeline;
+		pipeline.bindFrameBuffer(nullptr);
+		GL_CHECK(glViewport(0, 0, width, height));
+		GL_CHECK(glScissor(0, 0, width, height));
+		GL_CHECK(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
+
+		if (!dumpDir.empty())
+		{
+			std::error_code ec;
+			std::filesystem::create_directories(dumpDir, ec);
+		}
+
+		std::unique_ptr<Effect> effect = targetOk ? Effect_Create(effectName) : nullptr;
+
+		if (effect && effect->Init())
+		{
+			// streamed assets must be in place or the first frames differ between runs
+			g_assetManager.flush();
+
+			FixedTimestep sim(stepMs, 1);
+			std::vector<float> cpuMs, gpuMs(size_t(numFrames), -1.0f), latencyMs(size_t(numFrames), -1.0f);
+			cpuMs.reserve(size_t(numFrames));
+
+			if (!traceFile.empty() && warmup == 0)
+			{
+				g_profiler.startCapture(traceFile, numFrames);
+			}
+
+			const int totalFrames = warmup + numFrames + g_frameScheduler.getFramesInFlight();
+			auto wallStart = std::chrono::steady_clock::now();
+			auto wallEnd = wallStart;
+
+			for (int frame = 0; frame < totalFrames; ++frame)
+			{
+				if (frame == warmup)
+				{
+					wallStart = std::chrono::steady_clock::now();
+				}
+
+				g_profiler.beginFrame();
+				g_frameScheduler.beginFrame();
+				g_gpuProfiler.beginFrame();
+
+				const int64_t retired = g_frameScheduler.getRetiredIndex() - warmup;
+				if (retired >= 0 && retired < numFrames)
+				{
+					gpuMs[size_t(retired)] = g_frameScheduler.getRetiredGpuMs();
+					latencyMs[size_t(retired)] = g_frameScheduler.getRetiredLatencyMs();
+				}
+
+				// frames past the measured ones are empty, they only retire the last measured frames
+				const int measured = frame - warmup;
+				if (measured >= numFrames)
+				{
+					g_frameScheduler.endFrame();
+					continue;
+				}
+
+				const int64_t cpuStart = Profiler::now();
+
+				{
+					PROFILE_SCOPE("Update");
+
+					const int steps = sim.advanceBy(stepMs);
+					for (int i = 0; i < steps; ++i)
+					{
+						effect->Update(sim.getStepMs());
+					}
+				}
+
+				{
+					PROFILE_SCOPE("Render");
+					GPU_PROFILE_SCOPE("Frame");
+
+					g_assetManager.update();
+
+					pipeline.beginFrame();
+					pipeline.bindFrameBuffer(nullptr);
+					GL_CHECK(glViewport(0, 0, width, height));
+					effect->Render(pipeline, sim.getAlpha());
+				}
+
+				g_frameScheduler.endFrame();
+
+				if (measured >= 0)
+				{
+					cpuMs.push_back(float(Profiler::now() - cpuStart) * 1e-6f);
+
+					if (!dumpDir.empty() && measured % dumpEvery == 0)
+					{
+						char name[64];
+						snprintf(name, sizeof(name), "/%s_%05d.png", effectName.c_str(), measured);
+						Bench_DumpFrame(pipeline, target, dumpDir + name, width, height);
+					}
+
+					if (measured == numFrames - 1)
+					{
+						GL_CHECK(glFinish());
+						wallEnd = std::chrono::steady_clock::now();
+					}
+				}
+
+				if (frame + 1 == warmup)
+				{
+					g_gpuProfiler.resetStats();
+					if (!traceFile.empty())
+					{
+						g_profiler.startCapture(traceFile, numFrames);
+					}
+				}
+			}
+
+			const float wallMs = std::chrono::duration<float, std::milli>(wallEnd - wallStart).count();
+
+			if (!csvFile.empty())
+			{
+				std::string csv = "frame,cpu_ms,gpu_ms,latency_ms\n";
+				char line[128];
+				for (size_t i = 0; i < cpuMs.size(); ++i)
+				{
+					snprintf(line, sizeof(line), "%d,%.4f,%.4f,%.4f\n", int(i), cpuMs[i], gpuMs[i], latencyMs[i]);
+					csv += line;
+				}
+				g_fileSystem.write_binary_file(csvFile, csv.data(), csv.size());
+			}
+
+			// -1 marks a frame that never retired, it is not a sample
+			gpuMs.erase(std::remove(gpuMs.begin(), gpuMs.end(), -1.0f), gpuMs.end());
+			latencyMs.erase(std::remove(latencyMs.begin(), latencyMs.end(), -1.0f), latencyMs.end());
+
+			printf("effect %s, %dx%d, %d frames after %d warm-up, step %.3f ms, %d in flight\n",
+				effectName.c_str(), width, height, numFrames, warmup, stepMs, g_frameScheduler.getFramesInFlight());
+			printf("%-12s %9s %9s %9s %9s %9s %7s\n", "ms", "mean", "median", "p95", "min", "max", "frames");
+			Bench_PrintStats("cpu", cpuMs);
+			Bench_PrintStats("gpu", gpuMs);
+			Bench_PrintStats("latency", latencyMs);
+			printf("wall %.1f ms, %.2f frames/s\n", wallMs, wallMs > 0.0f ? float(numFrames) * 1000.0f / wallMs : 0.0f);
+
+			// beginFrame() publishes the counters, these are the next to last measured frame's
+			const glCallStats_t& calls = pipeline.getCallStats();
+			printf("binds %-12s %9s %9s\n", "", "issued", "skipped");
+			printf("binds %-12s %9u %9u\n", "program", calls.programIssued, calls.programSkipped);
+			printf("binds %-12s %9u %9u\n", "texture", calls.textureIssued, calls.textureSkipped);
+			printf("binds %-12s %9u %9u\n", "vao", calls.vaoIssued, calls.vaoSkipped);
+			printf("binds %-12s %9u %9u\n", "framebuffer", calls.frameBufferIssued, calls.frameBufferSkipped);
+			printf("binds %-12s %9u %9u\n", "buffer", calls.bufferIssued, calls.bufferSkipped);
+			printf("binds %-12s %9u %9u\n", "state", calls.stateIssued, calls.stateSkipped);
+
+			for (const auto& it : g_gpuProfiler.getStats())
+			{
+				if (it.second.count > 0)
+				{
+					printf("pass %-16s %9.3f ms %7d\n", it.first.c_str(), float(it.second.totalMs / it.second.count), int(it.second.count));
+				}
+			}
+
+			result = 0;
+		}
+
+		g_frameScheduler.shutdown();
+		effect.reset();
+		GpuFrameBuffer::setBackBuffer(nullptr);
+	}
+
+	g_gpuProfiler.shutdown();
+	g_assetManager.shutdown();
+	Bench_DestroyContext(egl);
+	g_jobSystem.shutdown();
+
+	return result;
+}
@@ -0,0 +1,143 @@
+/*
+Job system scaling benchmark: runs the same work with 1 to N threads and
+prints the median time of each run next to the speedup over one thread.
+
+usage: job_bench [-threads N] [-reps N] [-items N] [-jobs N]
+
+parallelFor	-items elements of integer hashing in chunks of 16384, the
+			shape of PointCubeEffect's point cloud fill
+jobs		-jobs tiny jobs queued on one counter and waited on, the cost
+			of run() and wait() per job
+
+-threads defaults to the hardware concurrency, -reps (default 7) runs of
+every measurement are taken after one warm-up run.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "logger.h"
+#include "job_system.h"
+
+static const uint32_t BENCH_GRAIN = 16384;
+
+static float Bench_Median(std::vector<float> v)
+{
+	std::sort(v.begin(), v.end());
+	return v[v.size() / 2];
+}
+
+static float Bench_ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static float Bench_ParallelFor(JobSystem& jobs, std::vector<uint32_t>& data)
+{
+	uint32_t* out = data.data();
+	const auto start = std::chrono::steady_clock::now();
+
+	jobs.parallelFor(uint32_t(data.size()), BENCH_GRAIN, [out](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			uint32_t h = i;
+			for (int k = 0; k < 32; ++k)
+			{
+				h = (h * 1664525u + 1013904223u) ^ (h >> 13);
+			}
+			out[i] = h;
+		}
+	});
+
+	return Bench_ElapsedMs(start);
+}
+
+static float Bench_Jobs(JobSystem& jobs, int numJobs)
+{
+	std::atomic<uint32_t> sum{ 0 };
+	JobCounter counter;
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numJobs; ++i)
+	{
+		jobs.run([&sum, i]() { sum.fetch_add(uint32_t(i), std::memory_order_relaxed); }, &counter);
+	}
+	jobs.wait(counter);
+
+	return Bench_ElapsedMs(start);
+}
+
+int main(int argc, char** argv)
+{
+	int maxThreads = std::max(1, int(std::thread::hardware_concurrency()));
+	int reps = 7;
+	int numItems = 1 << 22;
+	int numJobs = 100000;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-threads") && i + 1 < argc) maxThreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-reps") && i + 1 < argc) reps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-items") && i + 1 < argc) numItems = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-jobs") && i + 1 < argc) numJobs = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-threads N] [-reps N] [-items N] [-jobs N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (maxThreads < 1 || reps < 1 || numItems < 1 || numJobs < 1)
+	{
+		fprintf(stderr, "-threads, -reps, -items and -jobs must be positive\n");
+		return 1;
+	}
+
+	// the pool logs every init, keep the table readable
+	Log_SetLevel(LOG_LEVEL_WARNING);
+
+	std::vector<uint32_t> data(static_cast<size_t>(numItems));
+	float baseFor = 0.0f, baseJobs = 0.0f;
+
+	printf("%d items in chunks of %u, %d jobs, median of %d runs, %u hardware threads\n",
+		numItems, BENCH_GRAIN, numJobs, reps, std::thread::hardware_concurrency());
+	printf("%7s %14s %8s %12s %8s %12s\n", "threads", "parallelFor ms", "speedup", "jobs ms", "speedup", "jobs/s");
+
+	for (int threads = 1; threads <= maxThreads; ++threads)
+	{
+		JobSystem jobs;
+		jobs.init(threads);
+
+		std::vector<float> forMs, jobsMs;
+		Bench_ParallelFor(jobs, data);
+		Bench_Jobs(jobs, numJobs);
+
+		for (int r = 0; r < reps; ++r)
+		{
+			forMs.push_back(Bench_ParallelFor(jobs, data));
+			jobsMs.push_back(Bench_Jobs(jobs, numJobs));
+		}
+
+		jobs.shutdown();
+
+		const float f = Bench_Median(forMs);
+		const float j = Bench_Median(jobsMs);
+		if (threads == 1)
+		{
+			baseFor = f;
+			baseJobs = j;
+		}
+
+		printf("%7d %14.3f %7.2fx %12.3f %7.2fx %12.0f\n",
+			threads, f, baseFor / f, j, baseJobs / j, j > 0.0f ? float(numJobs) * 1000.0f / j : 0.0f);
+	}
+
+	Log_Flush();
+
+	return 0;
+}
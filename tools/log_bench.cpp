@@ -0,0 +1,151 @@
+/*
+Logger benchmark, the cost on the calling thread:
+
+usage: log_bench [-calls N] [-threads N] [-frames N] [-burst N]
+
+single		-calls Info calls in a row, ns per call and the time Log_Flush()
+			needs afterwards to write what is still queued
+threads		the same calls split over -threads producers
+burst		-burst calls at the start of each of -frames 16 ms frames, the
+			way a frame logs, with the per call latency distribution
+long		-calls / 10 messages past the inline slot size, heap carried
+
+The records go to demo.log and stderr like the demo's, run it as
+log_bench 2>/dev/null to keep the terminal to the results.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "logger.h"
+
+typedef std::chrono::steady_clock benchClock_t;
+
+static double Bench_Ns(benchClock_t::time_point start, benchClock_t::time_point end)
+{
+	return double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+static void Bench_Report(const char* name, int calls, double producerNs, double flushNs)
+{
+	printf("%-8s %9d calls %10.1f ns/call %12.0f calls/s, flush %8.3f ms\n",
+		name, calls, producerNs / calls, producerNs > 0.0 ? calls * 1e9 / producerNs : 0.0, flushNs * 1e-6);
+}
+
+static void Bench_Producer(int first, int count)
+{
+	for (int i = first; i < first + count; ++i)
+	{
+		Info("log_bench record %d, value %f", i, i * 0.5f);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int calls = 200000;
+	int threads = 4;
+	int frames = 100;
+	int burst = 200;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-calls") && i + 1 < argc) calls = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-frames") && i + 1 < argc) frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-burst") && i + 1 < argc) burst = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-calls N] [-threads N] [-frames N] [-burst N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (calls < 10 || threads < 1 || frames < 1 || burst < 1)
+	{
+		fprintf(stderr, "-calls must be at least 10, -threads, -frames and -burst positive\n");
+		return 1;
+	}
+
+	// starts the logger thread outside the measurements
+	Info("log_bench: %d calls, %d threads, %d frames of %d", calls, threads, frames, burst);
+	Log_Flush();
+
+	{
+		const auto start = benchClock_t::now();
+		Bench_Producer(0, calls);
+		const auto produced = benchClock_t::now();
+		Log_Flush();
+		Bench_Report("single", calls, Bench_Ns(start, produced), Bench_Ns(produced, benchClock_t::now()));
+	}
+
+	{
+		std::vector<std::thread> producers;
+		const int perThread = calls / threads;
+
+		const auto start = benchClock_t::now();
+		for (int t = 0; t < threads; ++t)
+		{
+			producers.emplace_back(Bench_Producer, t * perThread, perThread);
+		}
+		for (std::thread& t : producers)
+		{
+			t.join();
+		}
+		const auto produced = benchClock_t::now();
+		Log_Flush();
+
+		char name[32];
+		snprintf(name, sizeof(name), "threads%d", threads);
+		Bench_Report(name, perThread * threads, Bench_Ns(start, produced), Bench_Ns(produced, benchClock_t::now()));
+	}
+
+	{
+		std::vector<double> latency;
+		latency.reserve(size_t(frames) * burst);
+		double total = 0.0;
+
+		for (int f = 0; f < frames; ++f)
+		{
+			const auto frameStart = benchClock_t::now();
+
+			for (int i = 0; i < burst; ++i)
+			{
+				const auto start = benchClock_t::now();
+				Info("log_bench frame %d record %d", f, i);
+				const double ns = Bench_Ns(start, benchClock_t::now());
+				latency.push_back(ns);
+				total += ns;
+			}
+
+			std::this_thread::sleep_until(frameStart + std::chrono::milliseconds(16));
+		}
+
+		const auto flushStart = benchClock_t::now();
+		Log_Flush();
+		Bench_Report("burst", frames * burst, total, Bench_Ns(flushStart, benchClock_t::now()));
+
+		std::sort(latency.begin(), latency.end());
+		const auto pct = [&latency](double p) { return latency[std::min(latency.size() - 1, size_t(p * latency.size()))]; };
+		printf("burst latency ns: p50 %.0f, p99 %.0f, p99.9 %.0f, max %.0f\n", pct(0.5), pct(0.99), pct(0.999), latency.back());
+	}
+
+	{
+		const std::string text(400, 'x');
+		const int longCalls = calls / 10;
+
+		const auto start = benchClock_t::now();
+		for (int i = 0; i < longCalls; ++i)
+		{
+			Info("log_bench long %d %s", i, text.c_str());
+		}
+		const auto produced = benchClock_t::now();
+		Log_Flush();
+		Bench_Report("long", longCalls, Bench_Ns(start, produced), Bench_Ns(produced, benchClock_t::now()));
+	}
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+Offline mesh cooker: converts one glTF/GLB primitive into the binary
+format read by Mesh3D::loadFromCooked.
+
+usage: mesh_cook <input.gltf|.glb> <output.mesh> [meshIndex] [primitiveIndex] [numLods]
+
+numLods defaults to 4, 1 disables LOD generation. AssetManager::loadMesh
+picks the output up when it sits next to the source as model.mesh (mesh 0,
+primitive 0) or model.<mesh>.<primitive>.mesh.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include "logger.h"
+#include "mesh.h"
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <input.gltf|.glb> <output.mesh> [meshIndex] [primitiveIndex] [numLods]\n", argv[0]);
+		return 1;
+	}
+
+	const int meshIdx = argc > 3 ? atoi(argv[3]) : 0;
+	const int primitiveIdx = argc > 4 ? atoi(argv[4]) : 0;
+	const int numLods = argc > 5 ? atoi(argv[5]) : 4;
+
+	Mesh3D mesh;
+
+	if (!mesh.loadFromGLTF(argv[1], meshIdx, primitiveIdx))
+	{
+		Error("Cannot load %s", argv[1]);
+		return 1;
+	}
+
+	if (numLods > 1)
+	{
+		mesh.generateLods(numLods);
+	}
+
+	if (!mesh.saveCooked(argv[2]))
+	{
+		Error("Cannot write %s", argv[2]);
+		return 1;
+	}
+
+	Info("Cooked %s [%d/%d] -> %s, %u indices, %d LODs, %d meshlets", argv[1], meshIdx, primitiveIdx, argv[2], mesh.getNumIndex(), int(mesh.getLods().size()), int(mesh.getMeshlets().size()));
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+Offline texture cooker: converts an image into a block compressed DDS
+with a full mip chain, read by GpuTexture2D::createFromCooked.
+
+usage: texture_cook <input image> <output.dds> [-srgb] [-bc1|-bc3|-bc4|-bc5]
+                    [-normal] [-roughness <channel>] [-filter box|kaiser|lanczos]
+       texture_cook -cube <+X> <-X> <+Y> <-Y> <+Z> <-Z> <output.dds> [options]
+
+-cube writes the six square faces as one cube map for
+GpuTextureCubeMap::createFromCooked, every face with its own chain.
+AssetManager picks up <image>.dds next to a 2D source and <dir>.dds next
+to the directory of the cube faces (skybox/ -> skybox.dds).
+
+The format defaults to BC3 when the image has any alpha below 255,
+BC1 otherwise. -bc4 keeps the red channel (roughness, masks), -bc5 red
+and green (tangent space normals). -srgb marks BC1/BC3 color data as
+sRGB encoded, its mips are filtered in linear space.
+
+-normal renormalizes rgb on every mip level, -roughness filters the
+given channel (0-3, glTF metallic-roughness keeps it in 1) as
+roughness^2. Mips use the Kaiser filter unless -filter says otherwise.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <SOIL2.h>
+#include "logger.h"
+#include "filesystem.h"
+#include "job_system.h"
+#include "texture_file.h"
+#include "texture_compressor.h"
+#include "mip_builder.h"
+
+int main(int argc, char** argv)
+{
+	const bool cube = argc > 1 && !strcmp(argv[1], "-cube");
+	const int numFaces = cube ? 6 : 1;
+	const int firstOption = numFaces + 2 + (cube ? 1 : 0);
+
+	if (argc < firstOption)
+	{
+		fprintf(stderr, "usage: %s <input image> <output.dds> [-srgb] [-bc1|-bc3|-bc4|-bc5] [-normal] [-roughness <channel>] [-filter box|kaiser|lanczos]\n"
+			"       %s -cube <+X> <-X> <+Y> <-Y> <+Z> <-Z> <output.dds> [options]\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	const char* const* inputs = argv + (cube ? 2 : 1);
+	const char* output = argv[firstOption - 1];
+
+	bool srgb = false;
+	int bc = 0;
+	mipSettings_t mips;
+
+	for (int i = firstOption; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-srgb")) srgb = true;
+		else if (!strcmp(argv[i], "-bc1")) bc = 1;
+		else if (!strcmp(argv[i], "-bc3")) bc = 3;
+		else if (!strcmp(argv[i], "-bc4")) bc = 4;
+		else if (!strcmp(argv[i], "-bc5")) bc = 5;
+		else if (!strcmp(argv[i], "-normal")) mips.normalMap = true;
+		else if (!strcmp(argv[i], "-roughness") && i + 1 < argc) mips.roughnessChannel = atoi(argv[++i]) & 3;
+		else if (!strcmp(argv[i], "-filter") && i + 1 < argc)
+		{
+			++i;
+			if (!strcmp(argv[i], "box")) mips.filter = MF_BOX;
+			else if (!strcmp(argv[i], "kaiser")) mips.filter = MF_KAISER;
+			else if (!strcmp(argv[i], "lanczos")) mips.filter = MF_LANCZOS;
+			else
+			{
+				Error("Unknown filter %s", argv[i]);
+				return 1;
+			}
+		}
+		else
+		{
+			Error("Unknown option %s", argv[i]);
+			return 1;
+		}
+	}
+
+	int w = 0, h = 0;
+	bool hasAlpha = false;
+	std::vector<unsigned char*> faces;
+
+	for (int face = 0; face < numFaces; ++face)
+	{
+		int fw, fh, channels;
+		unsigned char* pixels = SOIL_load_image(inputs[face], &fw, &fh, &channels, SOIL_LOAD_RGBA);
+		if (!pixels)
+		{
+			Error("Cannot load %s: %s", inputs[face], SOIL_last_result());
+			return 1;
+		}
+		faces.push_back(pixels);
+
+		if (face == 0)
+		{
+			w = fw;
+			h = fh;
+		}
+
+		if (fw != w || fh != h || (cube && fw != fh))
+		{
+			Error("%s: cube faces must be square and of the same size", inputs[face]);
+			return 1;
+		}
+
+		hasAlpha = hasAlpha || BC_HasAlpha(pixels, fw, fh);
+	}
+
+	if (bc == 0)
+	{
+		bc = hasAlpha ? 3 : 1;
+	}
+
+	eBlockFormat format;
+	uint32_t dxgiFormat;
+
+	switch (bc)
+	{
+	case 1:
+		format = BF_BC1;
+		dxgiFormat = srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+		break;
+	case 3:
+		format = BF_BC3;
+		dxgiFormat = srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+		break;
+	case 4:
+		format = BF_BC4;
+		dxgiFormat = DXGI_FORMAT_BC4_UNORM;
+		break;
+	default:
+		format = BF_BC5;
+		dxgiFormat = DXGI_FORMAT_BC5_UNORM;
+		break;
+	}
+
+	g_jobSystem.init();
+
+	std::vector<uint8_t> blob(sizeof(ddsHeader_t) + sizeof(ddsHeaderDX10_t));
+
+	mips.srgb = srgb && bc < 4;
+
+	std::vector<mipLevel_t> levels;
+
+	for (unsigned char* pixels : faces)
+	{
+		Mip_BuildChain(pixels, w, h, mips, levels);
+		SOIL_free_image_data(pixels);
+
+		for (const mipLevel_t& level : levels)
+		{
+			const size_t offset = blob.size();
+			blob.resize(offset + BC_CompressedSize(format, level.width, level.height));
+			BC_Compress(format, level.rgba.data(), level.width, level.height, blob.data() + offset);
+		}
+	}
+
+	const uint32_t numLevels = uint32_t(levels.size());
+
+	ddsHeader_t header{};
+	header.magic = DDS_MAGIC;
+	header.size = sizeof(ddsHeader_t) - 4;
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.width = uint32_t(w);
+	header.height = uint32_t(h);
+	header.pitchOrLinearSize = DDS_LevelSize(w, h, DDS_BlockBytes(dxgiFormat));
+	header.mipMapCount = numLevels;
+	header.pixelFormat.size = sizeof(ddsPixelFormat_t);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = DDS_FOURCC_DX10;
+	header.caps = DDSCAPS_TEXTURE | (numLevels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0) | (cube ? DDSCAPS_COMPLEX : 0);
+	header.caps2 = cube ? DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES : 0;
+
+	ddsHeaderDX10_t dx10{};
+	dx10.dxgiFormat = dxgiFormat;
+	dx10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+	dx10.arraySize = 1;
+	dx10.miscFlag = cube ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+
+	memcpy(blob.data(), &header, sizeof(header));
+	memcpy(blob.data() + sizeof(header), &dx10, sizeof(dx10));
+
+	g_jobSystem.shutdown();
+
+	if (!g_fileSystem.write_binary_file(output, blob.data(), blob.size()))
+	{
+		Error("Cannot write %s", output);
+		return 1;
+	}
+
+	Info("Cooked %s -> %s, %s%dx%d BC%d%s, %u levels, %u bytes", inputs[0], output, cube ? "cube " : "", w, h, bc, srgb && bc < 4 ? " sRGB" : "", numLevels, uint32_t(blob.size()));
+
+	return 0;
+}